@@ -0,0 +1,34 @@
+# Turns a SPIR-V binary into a header that holds its words as a constexpr array:
+#   cmake -DINPUT=shader.vert.spv -DOUTPUT=shader.vert.spv.hpp -DNAME=SHADER_VERT
+#         -P embed_spirv.cmake
+
+file(READ "${INPUT}" HEX HEX)
+string(LENGTH "${HEX}" HEX_LENGTH)
+math(EXPR REMAINDER "${HEX_LENGTH} % 8")
+if(HEX_LENGTH EQUAL 0 OR NOT REMAINDER EQUAL 0)
+    message(FATAL_ERROR "${INPUT} is not a SPIR-V binary")
+endif()
+
+# glslc writes the words in the byte order of the host, which is little endian on every platform
+# this is built for.
+string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1u, " WORDS "${HEX}")
+# Eight words per line. CMake regular expressions have no {n} repetitions.
+set(LINE_PATTERN "0x........u,")
+foreach(I RANGE 1 7)
+    set(LINE_PATTERN "${LINE_PATTERN} 0x........u,")
+endforeach()
+string(REGEX REPLACE "(${LINE_PATTERN}) " "\\1\n        " WORDS "${WORDS}")
+string(REGEX REPLACE ",[ \n]*$" "" WORDS "${WORDS}")
+
+get_filename_component(INPUT_NAME "${INPUT}" NAME)
+file(WRITE "${OUTPUT}"
+"// Generated from ${INPUT_NAME} by embed_spirv.cmake. Do not edit.
+#pragma once
+
+#include <cstdint>
+
+namespace lve::shaders {
+    inline constexpr uint32_t ${NAME}[] = {
+        ${WORDS}};
+}  // namespace lve::shaders
+")
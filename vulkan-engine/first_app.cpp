@@ -2,6 +2,7 @@
 
 #include "keyboard_movement_controller.hpp"
 #include "lve_camera.hpp"
+#include "occlusion_culling_render_system.hpp"
 #include "simple_render_system.hpp"
 
 // Signal GLM to expect angles to be specified in radians
@@ -11,29 +12,137 @@
 #include <array>
 #include <cassert>
 #include <chrono>
+#include <cmath>
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
+#include <iostream>
 #include <stdexcept>
+#include <string>
 
 namespace lve {
 
-    FirstApp::FirstApp() { loadGameObjects(); }
+    FirstApp::FirstApp() : FirstApp(Settings{}) {}
+
+    FirstApp::FirstApp(const Settings &settings) : settings{settings} {
+        lveRenderer.setLowLatencyMode(settings.lowLatency);
+        loadScene();
+    }
 
     FirstApp::~FirstApp() {}
 
+    SwapChainOptions FirstApp::swapChainOptions() const {
+        SwapChainOptions options{};
+        options.dynamicRendering = DYNAMIC_RENDERING;
+        options.presentModes = settings.presentModes;
+        options.framesInFlight = settings.framesInFlight;
+        options.imageCount = settings.imageCount;
+        options.compactDepth = settings.compactDepth;
+        // GPU occlusion culling builds its Hi-Z pyramid from the depth and continues the render
+        // pass, and so does the depth pre-pass without the render graph, which may be turned on
+        // at any time. The render graph imports the depth and derives its own load and store
+        // ops, so its pre-pass keeps transient depth, which then commits memory for those frames.
+        const bool readsDepth = usesGpuOcclusionCulling() || !RENDER_GRAPH;
+        options.transientDepth = !readsDepth;
+        return options;
+    }
+
+    bool FirstApp::usesGpuOcclusionCulling() const {
+        const bool dynamicResolution = RENDER_GRAPH && settings.gpuTimeBudgetMs > 0.0;
+        const bool depthPrepass = settings.depthPrepass || settings.alternateDepthPrepass;
+        return GPU_OCCLUSION_CULLING && !dynamicResolution && !depthPrepass &&
+               OcclusionCullingRenderSystem::isSupported(lveDevice);
+    }
+
     void FirstApp::run() {
-        SimpleRenderSystem simpleRenderSystem{lveDevice, lveRenderer.getSwapChainRenderPass()};
+        const PipelineRenderTarget swapChainTarget = lveRenderer.getSwapChainRenderTarget();
+        const PipelineRenderTarget depthPrepassTarget = lveRenderer.getDepthPrepassRenderTarget();
+        const auto pipelineStart = std::chrono::steady_clock::now();
+        // The CPU path always gets the pre-pass pipelines, so that it can be turned on later.
+        const bool cpuPath = !usesGpuOcclusionCulling();
+        SimpleRenderSystem simpleRenderSystem{lveDevice,
+                                              pipelineManager,
+                                              swapChainTarget,
+                                              cpuPath ? &depthPrepassTarget : nullptr};
+        simpleRenderSystem.setDepthPrepassEnabled(settings.depthPrepass ||
+                                                  settings.alternateDepthPrepass);
+        std::unique_ptr<OcclusionCullingRenderSystem> occlusionCullingRenderSystem;
+        if (!cpuPath) {
+            occlusionCullingRenderSystem = std::make_unique<OcclusionCullingRenderSystem>(
+                lveDevice, pipelineManager, swapChainTarget);
+        }
+        const bool cpuOcclusionCulling =
+            OCCLUSION_CULLING && occlusionCullingRenderSystem == nullptr;
+        // Compare a run without pipeline_cache.bin to the runs after it. The creation time is
+        // summed over the threads, so it exceeds the elapsed time when pipelines are created in
+        // parallel.
+        const auto pipelineStats = lveDevice.getPipelineStats();
+        const std::chrono::duration<double, std::milli> pipelineElapsed =
+            std::chrono::steady_clock::now() - pipelineStart;
+        std::cout << "Created " << pipelineStats.pipelineCount << " pipelines in "
+                  << pipelineElapsed.count() << " ms (" << pipelineStats.creationTimeMs
+                  << " ms creation time), pipeline cache "
+                  << (pipelineStats.loadedCacheSize > 0
+                          ? std::to_string(pipelineStats.loadedCacheSize) + " bytes"
+                          : std::string{"empty"})
+                  << std::endl;
+        const auto managerStats = pipelineManager.getStats();
+        std::cout << "Pipeline manager: " << managerStats.misses << " compiled, "
+                  << managerStats.hits << " shared, " << managerStats.shaderModules
+                  << " shader modules, " << managerStats.libraries << " libraries" << std::endl;
+        for (const auto &pipeline : managerStats.pipelines) {
+            std::cout << "  " << pipeline.name << ": ";
+            if (pipeline.linkTimeMs > 0.0) {
+                std::cout << "linked in " << pipeline.linkTimeMs << " ms, ";
+            }
+            if (pipeline.optimized) {
+                std::cout << "compiled in " << pipeline.compileTimeMs << " ms, ";
+            } else if (!pipeline.optimizeError.empty()) {
+                std::cout << "optimization failed (" << pipeline.optimizeError << "), ";
+            } else {
+                std::cout << "still compiling, ";
+            }
+            std::cout << pipeline.hits << " hits" << std::endl;
+        }
+        // All pipelines exist now.
+        pipelineManager.releaseShaderModules();
+        const bool dynamicResolution =
+            RENDER_GRAPH && resolutionScaler.isEnabled() && lveRenderer.supportsBlitUpscale();
+        if (resolutionScaler.isEnabled() && !dynamicResolution) {
+            std::cout << "Dynamic resolution is not supported, rendering at full resolution"
+                      << std::endl;
+        }
+        LVEPassProfiler &passProfiler = lveRenderer.getPassProfiler();
+        if (!passProfiler.supportsPipelineStatistics()) {
+            std::cout << "Pipeline statistics are not supported, fragment shader invocations are "
+                         "not counted"
+                      << std::endl;
+        }
         LVECamera camera{};
         camera.setViewTarget(glm::vec3{-1.f, -2.f, 2.f}, glm::vec3{0.f, 0.f, 2.5f});
 
         // This is only used to store camera's state
-        auto viewerObject = LVEGameObject::createGameObject();
+        TransformComponent viewerTransform{};
         KeyboardMovementController cameraController{};
 
         auto currentTime = std::chrono::high_resolution_clock::now();
+        auto lastLatencyReport = currentTime;
+        bool depthPrepassKeyDown = false;
 
         while (!lveWindow.shouldClose()) {
+            framePacer.waitForNextFrame();
+            // Nothing may read the pools while destroyed entities leave them, including culling
+            // that was started in a frame that could not be rendered.
+            occlusionCuller.waitForResults();
+            scene.flushDestroyed();
+            // In low latency mode, the frame begins before the input is sampled, because
+            // beginFrame waits for the GPU. Otherwise the simulation overlaps with that wait.
+            VkCommandBuffer commandBuffer = nullptr;
+            if (settings.lowLatency) {
+                commandBuffer = lveRenderer.beginFrame();
+            }
+
             glfwPollEvents();  // Poll window events
+            lveRenderer.markInputSampled();
             // Should be after glfwPollEvents()
             auto newTime = std::chrono::high_resolution_clock::now();
 
@@ -45,37 +154,271 @@ namespace lve {
             // Prevent large jumps if needed.
             // frameTime = glm::min(frameTime, MAX_FRAME_TIME);
 
-            cameraController.moveInPlaneXZ(lveWindow.getGLFWWindow(), frameTime, viewerObject);
-            camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
+            cameraController.moveInPlaneXZ(lveWindow.getGLFWWindow(), frameTime, viewerTransform);
+            const bool depthPrepassKey =
+                glfwGetKey(lveWindow.getGLFWWindow(), GLFW_KEY_P) == GLFW_PRESS;
+            if (cpuPath && depthPrepassKey && !depthPrepassKeyDown) {
+                simpleRenderSystem.setDepthPrepassEnabled(
+                    !simpleRenderSystem.isDepthPrepassEnabled());
+                std::cout << "Depth pre-pass "
+                          << (simpleRenderSystem.isDepthPrepassEnabled() ? "on" : "off")
+                          << std::endl;
+            }
+            depthPrepassKeyDown = depthPrepassKey;
+            camera.setViewYXZ(viewerTransform.getTranslation(), viewerTransform.getRotation());
 
             float aspect = lveRenderer.getAspectRatio();
             camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 10.f);
+            // Everything that moved gets its matrices at once, before culling reads them.
+            transformBatch.updateMatrices(scene.pool<TransformComponent>().span());
+            // Started before beginFrame, so culling runs while we wait for the previous frame.
+            if (cpuOcclusionCulling) {
+                occlusionCuller.beginCulling(scene, camera);
+            }
+            if (!settings.lowLatency) {
+                commandBuffer = lveRenderer.beginFrame();
+            }
             // beginFrame returns nullptr if the swap chain needs to be recreated
-            if (auto commandBuffer = lveRenderer.beginFrame()) {
-                lveRenderer.beginSwapChainRenderPass(commandBuffer);
-                simpleRenderSystem.renderGameObjects(commandBuffer, gameObjects, camera);
-                lveRenderer.endSwapChainRenderPass(commandBuffer);
+            if (commandBuffer != nullptr) {
+                if (dynamicResolution) {
+                    resolutionScaler.update(lveRenderer.getLastGpuTimeMs());
+                }
+                if (occlusionCullingRenderSystem != nullptr) {
+                    auto &system = *occlusionCullingRenderSystem;
+                    system.prepareFrame(lveRenderer.getFrameIndex(),
+                                        scene,
+                                        camera,
+                                        lveRenderer.getSwapChainExtent());
+                    // Phase 1: Draw what was visible last frame.
+                    passProfiler.beginPass(commandBuffer, "phase 1");
+                    system.cullVisibleLastFrame(commandBuffer);
+                    lveRenderer.beginSwapChainRenderPass(commandBuffer);
+                    system.renderVisibleLastFrame(commandBuffer);
+                    lveRenderer.endSwapChainRenderPass(commandBuffer);
+                    passProfiler.endPass(commandBuffer);
+                    // Phase 2: Test everything against the depth of phase 1 and draw the rest.
+                    passProfiler.beginPass(commandBuffer, "phase 2");
+                    system.cullRemaining(commandBuffer,
+                                         lveRenderer.getCurrentDepthImage(),
+                                         lveRenderer.getCurrentDepthImageView(),
+                                         lveRenderer.getSwapChainDepthFormat());
+                    lveRenderer.continueSwapChainRenderPass(commandBuffer);
+                    system.renderNewlyVisible(commandBuffer);
+                    lveRenderer.endSwapChainRenderPass(commandBuffer);
+                    passProfiler.endPass(commandBuffer);
+                } else if (RENDER_GRAPH) {
+                    simpleRenderSystem.prepareDrawList(
+                        scene,
+                        camera,
+                        cpuOcclusionCulling ? &occlusionCuller.waitForResults() : nullptr);
+                    const size_t drawCount = simpleRenderSystem.getDrawCount();
+                    const bool parallel = PARALLEL_RECORDING &&
+                                          drawCount >= 2 * LVERenderer::MIN_DRAWS_PER_SECONDARY;
+
+                    const VkExtent2D fullExtent = lveRenderer.getSwapChainExtent();
+                    const VkExtent2D renderExtent =
+                        dynamicResolution ? resolutionScaler.getRenderExtent(fullExtent)
+                                          : fullExtent;
+                    const bool upscale = renderExtent.width != fullExtent.width ||
+                                         renderExtent.height != fullExtent.height;
+
+                    renderGraph.beginFrame(lveRenderer.getFrameIndex());
+                    const auto swapChainImage = lveRenderer.importSwapChainImage(renderGraph);
+                    // Below full resolution, the scene is drawn into an image of its own and then
+                    // blitted onto the swap chain image.
+                    const auto sceneColor =
+                        upscale ? renderGraph.createImage(
+                                      "scene color",
+                                      {lveRenderer.getSwapChainImageFormat(), renderExtent})
+                                : swapChainImage;
+                    // The swap chain already has a depth image per frame in flight, so the graph
+                    // uses that instead of allocating another one.
+                    const auto depth = lveRenderer.importDepthImage(renderGraph, renderExtent);
+                    const VkClearColorValue clearColor{{0.01f, 0.01f, 0.01f, 0.1f}};
+                    const VkClearDepthStencilValue clearDepth{1.0f, 0};
+
+                    if (simpleRenderSystem.hasDepthPrepass()) {
+                        renderGraph.addPass("depth prepass")
+                            .writeDepth(depth, &clearDepth)
+                            .record([&](const RenderGraphPassContext &context) {
+                                simpleRenderSystem.renderDepthPrepass(
+                                    context.commandBuffer, scene, camera, 0, drawCount);
+                            });
+                    }
+                    auto mainPass = renderGraph.addPass("main");
+                    mainPass.writeColor(sceneColor, &clearColor);
+                    if (simpleRenderSystem.hasDepthPrepass()) {
+                        mainPass.readDepth(depth);
+                    } else {
+                        mainPass.writeDepth(depth, &clearDepth);
+                    }
+                    if (parallel) {
+                        mainPass.useSecondaryCommandBuffers();
+                    }
+                    mainPass.record([&](const RenderGraphPassContext &context) {
+                        if (parallel) {
+                            lveRenderer.recordSecondaryCommandBuffers(
+                                context.commandBuffer,
+                                context.renderPass,
+                                context.framebuffer,
+                                context.extent,
+                                threadPool,
+                                drawCount,
+                                [&](VkCommandBuffer secondary, size_t begin, size_t end) {
+                                    simpleRenderSystem.renderEntities(
+                                        secondary, scene, camera, begin, end);
+                                });
+                        } else {
+                            simpleRenderSystem.renderEntities(
+                                context.commandBuffer, scene, camera, 0, drawCount);
+                        }
+                    });
+                    if (upscale) {
+                        renderGraph.addBlitPass("upscale", sceneColor, swapChainImage);
+                    }
+                    renderGraph.execute(commandBuffer, &passProfiler);
+                } else {
+                    // Sorted once, then recorded by one or many threads.
+                    simpleRenderSystem.prepareDrawList(
+                        scene,
+                        camera,
+                        cpuOcclusionCulling ? &occlusionCuller.waitForResults() : nullptr);
+                    const size_t drawCount = simpleRenderSystem.getDrawCount();
+                    if (simpleRenderSystem.hasDepthPrepass()) {
+                        passProfiler.beginPass(commandBuffer, "depth prepass");
+                        lveRenderer.beginDepthPrepass(commandBuffer);
+                        simpleRenderSystem.renderDepthPrepass(
+                            commandBuffer, scene, camera, 0, drawCount);
+                        lveRenderer.endDepthPrepass(commandBuffer);
+                        passProfiler.endPass(commandBuffer);
+                    }
+                    passProfiler.beginPass(commandBuffer, "main");
+                    if (PARALLEL_RECORDING &&
+                        drawCount >= 2 * LVERenderer::MIN_DRAWS_PER_SECONDARY) {
+                        lveRenderer.beginSwapChainRenderPass(
+                            commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+                        lveRenderer.recordSecondaryCommandBuffers(
+                            commandBuffer,
+                            threadPool,
+                            drawCount,
+                            [&](VkCommandBuffer secondary, size_t begin, size_t end) {
+                                simpleRenderSystem.renderEntities(
+                                    secondary, scene, camera, begin, end);
+                            });
+                    } else {
+                        lveRenderer.beginSwapChainRenderPass(commandBuffer);
+                        simpleRenderSystem.renderEntities(
+                            commandBuffer, scene, camera, 0, drawCount);
+                    }
+                    lveRenderer.endSwapChainRenderPass(commandBuffer);
+                    passProfiler.endPass(commandBuffer);
+                }
                 lveRenderer.endFrame();
             }
+
+            if (newTime - lastLatencyReport >= std::chrono::seconds(2)) {
+                const auto stats = lveRenderer.getLatencyStats();
+                if (stats.frameCount > 0) {
+                    std::cout << LVESwapChain::presentModeName(lveRenderer.getPresentMode())
+                              << ": latency " << stats.averageLatencyMs << " ms (max "
+                              << stats.maxLatencyMs << " ms"
+                              << (stats.calibrated ? "" : ", estimated") << "), GPU "
+                              << stats.averageGpuTimeMs << " ms";
+                    if (dynamicResolution) {
+                        std::cout << ", resolution scale " << resolutionScaler.getScale();
+                    }
+                    if (cpuPath) {
+                        std::cout << ", depth pre-pass "
+                                  << (simpleRenderSystem.hasDepthPrepass() ? "on" : "off");
+                    }
+                    std::cout << std::endl;
+                    // Results lag behind by the frames in flight, so the first report after a
+                    // toggle includes a few frames from before it.
+                    for (const auto &pass : passProfiler.getStats()) {
+                        std::cout << "  " << pass.name << ": GPU " << pass.averageGpuTimeMs
+                                  << " ms";
+                        if (passProfiler.supportsPipelineStatistics()) {
+                            std::cout << ", " << pass.averageFragmentInvocations
+                                      << " fragment shader invocations";
+                        }
+                        std::cout << std::endl;
+                    }
+                }
+                lveRenderer.resetLatencyStats();
+                passProfiler.resetStats();
+                lastLatencyReport = newTime;
+                if (cpuPath && settings.alternateDepthPrepass) {
+                    simpleRenderSystem.setDepthPrepassEnabled(
+                        !simpleRenderSystem.isDepthPrepassEnabled());
+                }
+            }
         }
         // CPU will block until all GPU operations have completed
         vkDeviceWaitIdle(lveDevice.device());
     }
 
-    void FirstApp::loadGameObjects() {
-        std::shared_ptr<LVEModel> lveModel =
-            LVEModel::createModelFromFile(lveDevice, "../../../../models/flat_vase.obj");
-        auto flatVase = LVEGameObject::createGameObject();
-        flatVase.model = lveModel;
-        flatVase.transform.translation = {-.5f, .5f, 2.5f};
-        flatVase.transform.scale = {3.f, 1.5f, 3.f};
-        gameObjects.push_back(std::move(flatVase));
+    void FirstApp::loadScene() {
+        if (settings.depthComplexity > 0) {
+            loadDepthComplexityScene();
+            return;
+        }
+        // The flat vase is big and close to the camera, so it hides objects behind it. Occluders
+        // keep a CPU copy of their geometry for the occlusion culler.
+        std::shared_ptr<LVEModel> lveModel = LVEModel::createModelFromFile(
+            lveDevice, "../../../../models/flat_vase.obj", OCCLUSION_CULLING);
+        const Entity flatVase = scene.create();
+        // Ignored by the GPU culling, which uses everything drawn in phase 1 as occluders.
+        scene.add<RenderComponent>(flatVase, lveModel, glm::vec3{}, OCCLUSION_CULLING);
+        auto &flatVaseTransform = scene.add<TransformComponent>(flatVase);
+        flatVaseTransform.setTranslation({-.5f, .5f, 2.5f});
+        flatVaseTransform.setScale({3.f, 1.5f, 3.f});
 
         lveModel = LVEModel::createModelFromFile(lveDevice, "../../../../models/smooth_vase.obj");
-        auto smoothVase = LVEGameObject::createGameObject();
-        smoothVase.model = lveModel;
-        smoothVase.transform.translation = {.5f, .5f, 2.5f};
-        smoothVase.transform.scale = {3.f, 1.5f, 3.f};
-        gameObjects.push_back(std::move(smoothVase));
+        const Entity smoothVase = scene.create();
+        scene.add<RenderComponent>(smoothVase, lveModel);
+        auto &smoothVaseTransform = scene.add<TransformComponent>(smoothVase);
+        smoothVaseTransform.setTranslation({.5f, .5f, 2.5f});
+        smoothVaseTransform.setScale({3.f, 1.5f, 3.f});
+
+        // Lay the stress test objects out on a square grid in the XZ plane in front of the camera.
+        const size_t gridSize =
+            static_cast<size_t>(std::ceil(std::sqrt(static_cast<float>(STRESS_TEST_OBJECT_COUNT))));
+        const float gridOffset = -.125f * static_cast<float>(gridSize);
+        for (size_t i = 0; i < STRESS_TEST_OBJECT_COUNT; i++) {
+            const Entity vase = scene.create();
+            scene.add<RenderComponent>(vase, lveModel);
+            auto &transform = scene.add<TransformComponent>(vase);
+            transform.setTranslation({gridOffset + .25f * static_cast<float>(i % gridSize),
+                                      .5f,
+                                      3.f + .25f * static_cast<float>(i / gridSize)});
+            transform.setScale({.5f, .25f, .5f});
+        }
+        // The systems walk the render pool and look up transforms by the same position.
+        scene.sortLike<TransformComponent, RenderComponent>();
+    }
+
+    void FirstApp::loadDepthComplexityScene() {
+        // The camera starts at the origin, looking down +Z. Every layer is a grid of big vases
+        // that covers most of the view, and the layers are spread from 2 to 4 units away, so most
+        // pixels are covered by all of them. The two models alternate between layers. The draw
+        // list sorts by model before depth, which leaves overdraw that sorting cannot remove.
+        const std::array<std::shared_ptr<LVEModel>, 2> models{
+            LVEModel::createModelFromFile(lveDevice, "../../../../models/flat_vase.obj"),
+            LVEModel::createModelFromFile(lveDevice, "../../../../models/smooth_vase.obj")};
+        const uint32_t layerCount = settings.depthComplexity;
+        for (uint32_t layer = 0; layer < layerCount; layer++) {
+            const float z = 2.f + 2.f * static_cast<float>(layer) / static_cast<float>(layerCount);
+            for (int column = -2; column <= 2; column++) {
+                for (int row = 0; row < 2; row++) {
+                    const Entity vase = scene.create();
+                    scene.add<RenderComponent>(vase, models[layer % 2]);
+                    auto &transform = scene.add<TransformComponent>(vase);
+                    transform.setTranslation(
+                        {static_cast<float>(column), static_cast<float>(row) - .5f, z});
+                    transform.setScale({3.f, 1.5f, 3.f});
+                }
+            }
+        }
+        scene.sortLike<TransformComponent, RenderComponent>();
     }
 }  // namespace lve
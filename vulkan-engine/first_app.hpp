@@ -3,9 +3,17 @@
 #include <memory>
 #include <vector>
 
+#include "lve_components.hpp"
 #include "lve_device.hpp"
-#include "lve_game_object.hpp"
+#include "lve_frame_pacer.hpp"
+#include "lve_occlusion_culler.hpp"
+#include "lve_pipeline_manager.hpp"
+#include "lve_render_graph.hpp"
 #include "lve_renderer.hpp"
+#include "lve_resolution_scaler.hpp"
+#include "lve_scene.hpp"
+#include "lve_thread_pool.hpp"
+#include "lve_transform_batch.hpp"
 #include "lve_window.hpp"
 
 namespace lve {
@@ -13,8 +21,53 @@ namespace lve {
        public:
         static constexpr int WIDTH = 1280;
         static constexpr int HEIGHT = 720;
+        // Record large scenes into secondary command buffers on the thread pool.
+        static constexpr bool PARALLEL_RECORDING = true;
+        // Number of extra vases to scatter on a grid to stress the CPU side of the renderer.
+        static constexpr size_t STRESS_TEST_OBJECT_COUNT = 0;
+        // Skip objects hidden behind occluders, tested on the CPU while the GPU is still busy.
+        static constexpr bool OCCLUSION_CULLING = true;
+        // Declare the passes of the CPU path in a render graph, which derives barriers, load and
+        // store ops and transient attachments, instead of using the swap chain render passes.
+        static constexpr bool RENDER_GRAPH = true;
+        // Cull and draw on the GPU in two phases against a depth pyramid, if the device supports
+        // it. Replaces the CPU path above, including its occlusion culling.
+        static constexpr bool GPU_OCCLUSION_CULLING = true;
+        // Render with vkCmdBeginRendering instead of render passes and framebuffers, if the
+        // device supports Vulkan 1.3.
+        static constexpr bool DYNAMIC_RENDERING = true;
+
+        // Chosen on the command line.
+        struct Settings {
+            // In order of preference. Falls back to FIFO, which is always supported.
+            std::vector<VkPresentModeKHR> presentModes{VK_PRESENT_MODE_FIFO_KHR};
+            // Frames per second, 0 for no limit.
+            double frameRateLimit = 0.0;
+            // Sample input only after the GPU has caught up, see LVERenderer::setLowLatencyMode.
+            bool lowLatency = false;
+            // See SwapChainOptions.
+            int framesInFlight = 2;
+            uint32_t imageCount = 0;
+            bool compactDepth = false;
+            // GPU time per frame to hold by lowering the render resolution, 0 always renders at
+            // full resolution. Only the render graph path scales, so it takes the place of GPU
+            // occlusion culling.
+            double gpuTimeBudgetMs = 0.0;
+            // Render the depth of the scene first, so the main pass shades every pixel only once.
+            // Pays off with expensive fragment shaders and a lot of overdraw. Only the CPU path
+            // has a pre-pass, so it takes the place of GPU occlusion culling. On the CPU path, P
+            // turns it on and off while running.
+            bool depthPrepass = false;
+            // Turn the depth pre-pass on and off with every report, to compare the per-pass GPU
+            // times and fragment shader invocations of both in one run.
+            bool alternateDepthPrepass = false;
+            // Replaces the scene with this many layers of vases right in front of the camera, to
+            // have a lot of overdraw. 0 for the normal scene.
+            uint32_t depthComplexity = 0;
+        };
 
         FirstApp();
+        explicit FirstApp(const Settings &settings);
         ~FirstApp();
 
         FirstApp(const FirstApp &) = delete;
@@ -23,13 +76,26 @@ namespace lve {
         void run();
 
        private:
-        void loadGameObjects();
+        void loadScene();
+        void loadDepthComplexityScene();
+        // From the settings.
+        SwapChainOptions swapChainOptions() const;
+        bool usesGpuOcclusionCulling() const;
 
         // Initialized from top to bottom
+        Settings settings;
         LVEWindow lveWindow{WIDTH, HEIGHT, "Vulkan Engine"};
         LVEDevice lveDevice{lveWindow};
-        LVERenderer lveRenderer{lveWindow, lveDevice};
+        LVERenderer lveRenderer{lveWindow, lveDevice, swapChainOptions()};
+        LVEFramePacer framePacer{settings.frameRateLimit};
+        LVEResolutionScaler resolutionScaler{{settings.gpuTimeBudgetMs}};
+        LVERenderGraph renderGraph{lveDevice, lveRenderer.usesDynamicRendering()};
+        LVEThreadPool threadPool{};
+        // Compiles on the thread pool, so it has to be destroyed first.
+        LVEPipelineManager pipelineManager{lveDevice, &threadPool};
+        LVEOcclusionCuller occlusionCuller{threadPool};
 
-        std::vector<LVEGameObject> gameObjects;
+        LVEScene scene;
+        LVETransformBatch transformBatch{};
     };
 }  // namespace lve
@@ -0,0 +1,97 @@
+#include "headless_app.hpp"
+
+#include "lve_camera.hpp"
+#include "simple_render_system.hpp"
+
+// Signal GLM to expect angles to be specified in radians
+#define GLM_FORCE_RADIANS
+// Signal GLM to expect the depth buffer values to range from 0 to 1. OpenGL is -1 to 1.
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <stdexcept>
+
+namespace lve {
+
+    HeadlessApp::HeadlessApp() { loadScene(); }
+
+    HeadlessApp::~HeadlessApp() {}
+
+    void HeadlessApp::run(uint32_t frameCount, const std::string &outputPath) {
+        SimpleRenderSystem simpleRenderSystem{
+            lveDevice, pipelineManager, lveRenderer.getSwapChainRenderTarget()};
+        LVECamera camera{};
+        camera.setViewTarget(glm::vec3{-1.f, -2.f, 2.f}, glm::vec3{0.f, 0.f, 2.5f});
+        const float aspect = lveRenderer.getAspectRatio();
+        camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 10.f);
+
+        // Only the last frame is kept. Copying every frame would measure the copies.
+        std::vector<uint8_t> lastFrame;
+        uint64_t readbackCount = 0;
+        lveRenderer.setReadbackCallback([&](const LVEHeadlessRenderer::Readback &readback) {
+            readbackCount++;
+            if (!outputPath.empty() && readback.frameNumber + 1 == frameCount) {
+                lastFrame.assign(readback.pixels,
+                                 readback.pixels + readback.rowPitch * readback.extent.height);
+            }
+        });
+
+        const auto startTime = std::chrono::high_resolution_clock::now();
+        for (uint32_t frame = 0; frame < frameCount; frame++) {
+            // Something to render that changes every frame.
+            for (auto &transform : scene.pool<TransformComponent>()) {
+                transform.rotate({0.f, 0.01f, 0.f});
+            }
+            transformBatch.updateMatrices(scene.pool<TransformComponent>().span());
+
+            auto commandBuffer = lveRenderer.beginFrame();
+            simpleRenderSystem.prepareDrawList(scene, camera);
+            lveRenderer.beginSwapChainRenderPass(commandBuffer);
+            simpleRenderSystem.renderEntities(
+                commandBuffer, scene, camera, 0, simpleRenderSystem.getDrawCount());
+            lveRenderer.endSwapChainRenderPass(commandBuffer);
+            lveRenderer.endFrame();
+            // Hand out what is done already, instead of all of it when a frame index is reused.
+            lveRenderer.pollReadbacks();
+        }
+        lveRenderer.flushReadbacks();
+        const auto endTime = std::chrono::high_resolution_clock::now();
+
+        const double seconds = std::chrono::duration<double>(endTime - startTime).count();
+        std::cout << "headless: " << frameCount << " frames (" << readbackCount
+                  << " read back) in " << seconds << " s, "
+                  << 1000.0 * seconds / std::max(frameCount, 1u) << " ms per frame" << std::endl;
+
+        if (!lastFrame.empty()) {
+            std::ofstream file{outputPath, std::ios::binary};
+            if (!file) {
+                throw std::runtime_error("Failed to open file: " + outputPath);
+            }
+            file << "P6\n" << WIDTH << " " << HEIGHT << "\n255\n";
+            // RGBA to RGB.
+            for (size_t i = 0; i < lastFrame.size(); i += 4) {
+                file.write(reinterpret_cast<const char *>(&lastFrame[i]), 3);
+            }
+        }
+    }
+
+    void HeadlessApp::loadScene() {
+        std::shared_ptr<LVEModel> lveModel =
+            LVEModel::createModelFromFile(lveDevice, "../../../../models/flat_vase.obj");
+        const Entity flatVase = scene.create();
+        scene.add<RenderComponent>(flatVase, lveModel);
+        auto &flatVaseTransform = scene.add<TransformComponent>(flatVase);
+        flatVaseTransform.setTranslation({-.5f, .5f, 2.5f});
+        flatVaseTransform.setScale({3.f, 1.5f, 3.f});
+
+        lveModel = LVEModel::createModelFromFile(lveDevice, "../../../../models/smooth_vase.obj");
+        const Entity smoothVase = scene.create();
+        scene.add<RenderComponent>(smoothVase, lveModel);
+        auto &smoothVaseTransform = scene.add<TransformComponent>(smoothVase);
+        smoothVaseTransform.setTranslation({.5f, .5f, 2.5f});
+        smoothVaseTransform.setScale({3.f, 1.5f, 3.f});
+    }
+}  // namespace lve
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "lve_components.hpp"
+#include "lve_device.hpp"
+#include "lve_headless_renderer.hpp"
+#include "lve_pipeline_manager.hpp"
+#include "lve_scene.hpp"
+#include "lve_transform_batch.hpp"
+
+namespace lve {
+    /**
+     * @brief Renders the scene of FirstApp without a window, e.g. on servers without a GPU or
+     * display (lavapipe). Used for batch rendering and benchmarking.
+     */
+    class HeadlessApp {
+       public:
+        static constexpr uint32_t WIDTH = 1280;
+        static constexpr uint32_t HEIGHT = 720;
+        static constexpr int FRAMES_IN_FLIGHT = 3;
+
+        HeadlessApp();
+        ~HeadlessApp();
+
+        HeadlessApp(const HeadlessApp &) = delete;
+        HeadlessApp &operator=(const HeadlessApp &) = delete;
+
+        // Renders frameCount frames and prints the frame times. If outputPath is not empty, the
+        // last frame is written to it as a binary PPM image.
+        void run(uint32_t frameCount, const std::string &outputPath);
+
+       private:
+        void loadScene();
+
+        LVEDevice lveDevice{};
+        LVEHeadlessRenderer lveRenderer{lveDevice, {WIDTH, HEIGHT}, FRAMES_IN_FLIGHT};
+        LVEPipelineManager pipelineManager{lveDevice};
+
+        LVEScene scene;
+        LVETransformBatch transformBatch{};
+    };
+}  // namespace lve
@@ -5,7 +5,7 @@
 namespace lve {
     void KeyboardMovementController::moveInPlaneXZ(GLFWwindow* window,
                                                    float dt,
-                                                   LVEGameObject& gameObject) {
+                                                   TransformComponent& transform) {
         glm::vec3 rotate{0};
         if (glfwGetKey(window, keys.lookRight) == GLFW_PRESS) {
             rotate.y += 1.f;
@@ -22,20 +22,21 @@ namespace lve {
         }
 
         if (glm::dot(rotate, rotate) > std::numeric_limits<float>::epsilon()) {
-            // Scale the rotation by lookSpeed and dt so that the game object will update in a
+            // Scale the rotation by lookSpeed and dt so that the transform will update in a
             // steady manner independent of the current frame rate. Normalize the rotation so that
-            // the game object doesn't rotate faster diagonally.
-            gameObject.transform.rotation += lookSpeed * dt * glm::normalize(rotate);
+            // the transform doesn't rotate faster diagonally.
+            transform.rotate(lookSpeed * dt * glm::normalize(rotate));
         }
 
+        glm::vec3 rotation = transform.getRotation();
         // Limit pitch values between about +/- 1.5 radians to prevent objects from going upside
         // down
-        gameObject.transform.rotation.x = glm::clamp(gameObject.transform.rotation.x, -1.5f, 1.5f);
+        rotation.x = glm::clamp(rotation.x, -1.5f, 1.5f);
         // Stop overflow because of repeated spinning in one direction
-        gameObject.transform.rotation.y =
-            glm::mod(gameObject.transform.rotation.y, glm::two_pi<float>());
+        rotation.y = glm::mod(rotation.y, glm::two_pi<float>());
+        transform.setRotation(rotation);
 
-        float yaw = gameObject.transform.rotation.y;
+        float yaw = rotation.y;
         const glm::vec3 forwardDir{sin(yaw), 0.f, cos(yaw)};
         const glm::vec3 rightDir{forwardDir.z, 0.f, -forwardDir.x};
         const glm::vec3 upDir{0.f, -1.f, 0.f};
@@ -63,7 +64,7 @@ namespace lve {
         }
 
         if (glm::dot(moveDir, moveDir) > std::numeric_limits<float>::epsilon()) {
-            gameObject.transform.translation += moveSpeed * dt * glm::normalize(moveDir);
+            transform.translate(moveSpeed * dt * glm::normalize(moveDir));
         }
     }
 }  // namespace lve
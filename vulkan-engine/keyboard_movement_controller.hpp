@@ -1,6 +1,6 @@
 #pragma once
 
-#include "lve_game_object.hpp"
+#include "lve_components.hpp"
 #include "lve_window.hpp"
 
 namespace lve {
@@ -22,7 +22,7 @@ namespace lve {
             int lookDown = GLFW_KEY_DOWN;
         };
 
-        void moveInPlaneXZ(GLFWwindow* window, float dt, LVEGameObject& gameObject);
+        void moveInPlaneXZ(GLFWwindow* window, float dt, TransformComponent& transform);
 
         KeyMappings keys{};
         float moveSpeed{3.f};
@@ -0,0 +1,60 @@
+#include "lve_buffer.hpp"
+
+#include <cassert>
+#include <cstring>
+
+namespace lve {
+
+    LVEBuffer::LVEBuffer(LVEDevice &device,
+                         VkDeviceSize instanceSize,
+                         uint32_t instanceCount,
+                         VkBufferUsageFlags usageFlags,
+                         VkMemoryPropertyFlags memoryPropertyFlags)
+        : lveDevice{device}, instanceCount{instanceCount}, instanceSize{instanceSize} {
+        bufferSize = instanceSize * instanceCount;
+        device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+    }
+
+    LVEBuffer::~LVEBuffer() {
+        unmap();
+        // Frames in flight, including the one being recorded, may still use the buffer.
+        lveDevice.destroyBufferDeferred(buffer, memory);
+    }
+
+    VkResult LVEBuffer::map(VkDeviceSize size, VkDeviceSize offset) {
+        assert(buffer && memory && "Called map on buffer before create");
+        return vkMapMemory(lveDevice.device(), memory, offset, size, 0, &mapped);
+    }
+
+    void LVEBuffer::unmap() {
+        if (mapped) {
+            vkUnmapMemory(lveDevice.device(), memory);
+            mapped = nullptr;
+        }
+    }
+
+    void LVEBuffer::writeToBuffer(const void *data, VkDeviceSize size, VkDeviceSize offset) {
+        assert(mapped && "Cannot copy to unmapped buffer");
+
+        if (size == VK_WHOLE_SIZE) {
+            memcpy(mapped, data, bufferSize);
+        } else {
+            char *memOffset = static_cast<char *>(mapped);
+            memOffset += offset;
+            memcpy(memOffset, data, size);
+        }
+    }
+
+    VkResult LVEBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
+        VkMappedMemoryRange mappedRange = {};
+        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        mappedRange.memory = memory;
+        mappedRange.offset = offset;
+        mappedRange.size = size;
+        return vkFlushMappedMemoryRanges(lveDevice.device(), 1, &mappedRange);
+    }
+
+    VkDescriptorBufferInfo LVEBuffer::descriptorInfo(VkDeviceSize size, VkDeviceSize offset) const {
+        return VkDescriptorBufferInfo{buffer, offset, size};
+    }
+}  // namespace lve
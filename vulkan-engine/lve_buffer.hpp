@@ -0,0 +1,53 @@
+#pragma once
+
+#include "lve_device.hpp"
+
+namespace lve {
+    /**
+     * @brief Owns a VkBuffer and its memory. The buffer holds instanceCount instances of
+     * instanceSize bytes each. Host visible buffers can be mapped and written to directly.
+     * Destroying it is deferred until the frames that may use it are done, see
+     * LVEDevice::deferDestruction, so it can be replaced in the middle of a frame.
+     */
+    class LVEBuffer {
+       public:
+        LVEBuffer(LVEDevice &device,
+                  VkDeviceSize instanceSize,
+                  uint32_t instanceCount,
+                  VkBufferUsageFlags usageFlags,
+                  VkMemoryPropertyFlags memoryPropertyFlags);
+        ~LVEBuffer();
+
+        LVEBuffer(const LVEBuffer &) = delete;
+        LVEBuffer &operator=(const LVEBuffer &) = delete;
+
+        // Maps a range of the buffer's memory. The memory must be host visible.
+        VkResult map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+        void unmap();
+
+        // Copies size bytes of data into the mapped buffer at offset.
+        void writeToBuffer(const void *data,
+                           VkDeviceSize size = VK_WHOLE_SIZE,
+                           VkDeviceSize offset = 0);
+        // Makes host writes visible to the device. Only needed for non-coherent memory.
+        VkResult flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+        VkDescriptorBufferInfo descriptorInfo(VkDeviceSize size = VK_WHOLE_SIZE,
+                                              VkDeviceSize offset = 0) const;
+
+        VkBuffer getBuffer() const { return buffer; }
+        void *getMappedMemory() const { return mapped; }
+        uint32_t getInstanceCount() const { return instanceCount; }
+        VkDeviceSize getInstanceSize() const { return instanceSize; }
+        VkDeviceSize getBufferSize() const { return bufferSize; }
+
+       private:
+        LVEDevice &lveDevice;
+        void *mapped = nullptr;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+
+        VkDeviceSize bufferSize;
+        uint32_t instanceCount;
+        VkDeviceSize instanceSize;
+    };
+}  // namespace lve
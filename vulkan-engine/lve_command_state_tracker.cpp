@@ -0,0 +1,39 @@
+#include "lve_command_state_tracker.hpp"
+
+#include <stdexcept>
+
+namespace lve {
+
+    void LVECommandStateTracker::bindPipeline(LVEPipeline &pipeline) {
+        if (boundPipeline == &pipeline) {
+            stats.pipelineBindsElided++;
+            return;
+        }
+        pipeline.bind(commandBuffer);
+        boundPipeline = &pipeline;
+        // Pipelines with a static part of the draw state invalidate what was set for it.
+        hasDrawState = false;
+        stats.pipelineBindsIssued++;
+    }
+
+    void LVECommandStateTracker::bindModel(LVEModel &model) {
+        // A model owns its vertex and index buffers, so the same model means the same bindings.
+        if (boundModel == &model) {
+            stats.modelBindsElided++;
+            return;
+        }
+        model.bind(commandBuffer);
+        boundModel = &model;
+        stats.modelBindsIssued++;
+    }
+
+    void LVECommandStateTracker::setDrawState(const DrawState &drawState) {
+        if (boundPipeline == nullptr) {
+            throw std::runtime_error("Draw state set without a bound pipeline");
+        }
+        boundPipeline->setDrawState(
+            commandBuffer, drawState, hasDrawState ? &lastDrawState : nullptr);
+        lastDrawState = drawState;
+        hasDrawState = true;
+    }
+}  // namespace lve
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+
+#include "lve_device.hpp"
+#include "lve_model.hpp"
+#include "lve_pipeline.hpp"
+
+namespace lve {
+    struct BindStats {
+        uint64_t pipelineBindsIssued = 0;
+        uint64_t pipelineBindsElided = 0;
+        uint64_t modelBindsIssued = 0;
+        uint64_t modelBindsElided = 0;
+
+        uint64_t bindsIssued() const { return pipelineBindsIssued + modelBindsIssued; }
+        uint64_t bindsElided() const { return pipelineBindsElided + modelBindsElided; }
+
+        BindStats &operator+=(const BindStats &other) {
+            pipelineBindsIssued += other.pipelineBindsIssued;
+            pipelineBindsElided += other.pipelineBindsElided;
+            modelBindsIssued += other.modelBindsIssued;
+            modelBindsElided += other.modelBindsElided;
+            return *this;
+        }
+    };
+
+    /**
+     * @brief Remembers what is currently bound on one command buffer and skips binds that would
+     * not change anything. Works best on a sorted draw list, where draws sharing state are
+     * adjacent. Create one tracker per command buffer, since bound state is per command buffer.
+     */
+    class LVECommandStateTracker {
+       public:
+        explicit LVECommandStateTracker(VkCommandBuffer commandBuffer)
+            : commandBuffer{commandBuffer} {}
+
+        void bindPipeline(LVEPipeline &pipeline);
+        void bindModel(LVEModel &model);
+        // Sets the dynamic parts of the draw state on the bound pipeline, only those that differ
+        // from what was set since the last pipeline bind.
+        void setDrawState(const DrawState &drawState);
+
+        // Forget the bound state, e.g. after commands were recorded without the tracker.
+        void reset() {
+            boundPipeline = nullptr;
+            boundModel = nullptr;
+            hasDrawState = false;
+        }
+
+        const BindStats &getStats() const { return stats; }
+
+       private:
+        VkCommandBuffer commandBuffer;
+        LVEPipeline *boundPipeline = nullptr;
+        const LVEModel *boundModel = nullptr;
+        DrawState lastDrawState{};
+        bool hasDrawState = false;
+        BindStats stats{};
+    };
+}  // namespace lve
@@ -0,0 +1,91 @@
+#include "lve_components.hpp"
+
+namespace lve {
+    void TransformComponent::setTranslation(const glm::vec3 &newTranslation) {
+        if (newTranslation != translation) {
+            translation = newTranslation;
+            translationDirty = true;
+        }
+    }
+
+    void TransformComponent::setScale(const glm::vec3 &newScale) {
+        if (newScale != scale) {
+            scale = newScale;
+            basisDirty = true;
+        }
+    }
+
+    void TransformComponent::setRotation(const glm::vec3 &newRotation) {
+        if (quaternionRotation || newRotation != rotation) {
+            rotation = newRotation;
+            quaternionRotation = false;
+            basisDirty = true;
+        }
+    }
+
+    glm::quat TransformComponent::getOrientation() const {
+        if (quaternionRotation) {
+            return orientation;
+        }
+        // Same order as the matrix: Ry * Rx * Rz.
+        return glm::angleAxis(rotation.y, glm::vec3{0.0f, 1.0f, 0.0f}) *
+               glm::angleAxis(rotation.x, glm::vec3{1.0f, 0.0f, 0.0f}) *
+               glm::angleAxis(rotation.z, glm::vec3{0.0f, 0.0f, 1.0f});
+    }
+
+    void TransformComponent::setOrientation(const glm::quat &newOrientation) {
+        const glm::quat normalized = glm::normalize(newOrientation);
+        if (!quaternionRotation || normalized != orientation) {
+            orientation = normalized;
+            quaternionRotation = true;
+            basisDirty = true;
+        }
+    }
+
+    const glm::mat4 &TransformComponent::modelToWorldMatrix() const {
+        updateMatrices();
+        return modelMatrix;
+    }
+
+    const glm::mat3 &TransformComponent::normalToWorldMatrix() const {
+        updateMatrices();
+        return normalMatrix;
+    }
+
+    void TransformComponent::updateMatrices() const {
+        if (basisDirty) {
+            glm::mat3 rotationMatrix;
+            if (quaternionRotation) {
+                rotationMatrix = glm::mat3_cast(orientation);
+            } else {
+                /**
+                 * @brief Matrix corresponds to Ry * Rx * Rz.
+                 * Rotations correspond to Tait-bryan angles of Y(1), X(2), Z(3)
+                 * https://en.wikipedia.org/wiki/Euler_angles#Rotation_matrix
+                 */
+                const float c3 = glm::cos(rotation.z);
+                const float s3 = glm::sin(rotation.z);
+                const float c2 = glm::cos(rotation.x);
+                const float s2 = glm::sin(rotation.x);
+                const float c1 = glm::cos(rotation.y);
+                const float s1 = glm::sin(rotation.y);
+                rotationMatrix = glm::mat3{
+                    {c1 * c3 + s1 * s2 * s3, c2 * s3, c1 * s2 * s3 - c3 * s1},
+                    {c3 * s1 * s2 - c1 * s3, c2 * c3, c1 * c3 * s2 + s1 * s3},
+                    {c2 * s1, -s2, c1 * c2}};
+            }
+            // Scaling the columns applies the scale before the rotation. The normal matrix scales
+            // them by the inverse, which is the inverse transpose for a rotation.
+            const glm::vec3 inverseScale = 1.0f / scale;
+            for (int i = 0; i < 3; i++) {
+                modelMatrix[i] = glm::vec4{rotationMatrix[i] * scale[i], 0.0f};
+                normalMatrix[i] = rotationMatrix[i] * inverseScale[i];
+            }
+            basisDirty = false;
+        }
+        if (translationDirty) {
+            modelMatrix[3] = glm::vec4{translation, 1.0f};
+            translationDirty = false;
+        }
+    }
+}  // namespace lve
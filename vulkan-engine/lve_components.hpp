@@ -0,0 +1,74 @@
+#pragma once
+
+#include <memory>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "lve_model.hpp"
+
+namespace lve {
+    /**
+     * @brief Position, rotation and scale of an object. The matrices are cached and only
+     * recomputed after a setter changed something they depend on, so objects that do not move
+     * cost no trigonometry per frame. A changed translation only replaces the last column.
+     *
+     * The rotation is either Tait-Bryan angles (Y, X, Z), as set by setRotation, or a quaternion,
+     * as set by setOrientation. Whichever was set last is used. Quaternions turn into matrices
+     * without any trigonometry.
+     *
+     * The first matrix access after a change updates the cache, so it must not race with other
+     * accesses of the same object. Reading different objects on different threads is fine.
+     */
+    class TransformComponent {
+       public:
+        const glm::vec3 &getTranslation() const { return translation; }
+        void setTranslation(const glm::vec3 &newTranslation);
+        void translate(const glm::vec3 &offset) { setTranslation(translation + offset); }
+
+        const glm::vec3 &getScale() const { return scale; }
+        void setScale(const glm::vec3 &newScale);
+
+        // The Euler angles in radians. Only meaningful while the rotation is not a quaternion.
+        const glm::vec3 &getRotation() const { return rotation; }
+        void setRotation(const glm::vec3 &newRotation);
+        void rotate(const glm::vec3 &angles) { setRotation(rotation + angles); }
+
+        bool hasQuaternionRotation() const { return quaternionRotation; }
+        // Converts the Euler angles if they are the current rotation.
+        glm::quat getOrientation() const;
+        void setOrientation(const glm::quat &newOrientation);
+
+        // Translate * Rotation * Scale.
+        const glm::mat4 &modelToWorldMatrix() const;
+        // The inverse transpose of the upper 3x3 of the model matrix.
+        const glm::mat3 &normalToWorldMatrix() const;
+
+       private:
+        // Fills in the matrices of many transforms at once.
+        friend class LVETransformBatch;
+
+        void updateMatrices() const;
+
+        glm::vec3 translation{};
+        glm::vec3 scale{1.0f, 1.0f, 1.0f};
+        glm::vec3 rotation{};
+        glm::quat orientation{1.0f, 0.0f, 0.0f, 0.0f};
+        bool quaternionRotation = false;
+
+        mutable glm::mat4 modelMatrix{1.0f};
+        mutable glm::mat3 normalMatrix{1.0f};
+        // Rotation or scale changed, which affects both matrices.
+        mutable bool basisDirty = false;
+        mutable bool translationDirty = false;
+    };
+
+    // What the render systems draw an entity with.
+    struct RenderComponent {
+        std::shared_ptr<LVEModel> model{};
+        glm::vec3 color{};
+        // Rasterized by the CPU occlusion culler to hide what is behind it. The model has to keep
+        // its CPU geometry.
+        bool isOccluder{false};
+    };
+}  // namespace lve
@@ -0,0 +1,45 @@
+#include "lve_compute_pipeline.hpp"
+
+#include <cassert>
+#include <chrono>
+#include <stdexcept>
+
+namespace lve {
+
+    LVEComputePipeline::LVEComputePipeline(LVEDevice &device,
+                                           ShaderCode compCode,
+                                           VkPipelineLayout pipelineLayout)
+        : lveDevice{device} {
+        assert(pipelineLayout != VK_NULL_HANDLE &&
+               "Cannot create compute pipeline: no pipelineLayout provided");
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = LVEPipeline::createShaderModule(lveDevice, compCode);
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = pipelineLayout;
+
+        const auto start = std::chrono::steady_clock::now();
+        const VkResult result = vkCreateComputePipelines(lveDevice.device(),
+                                                         lveDevice.getPipelineCache(),
+                                                         1,
+                                                         &pipelineInfo,
+                                                         nullptr,
+                                                         &computePipeline);
+        vkDestroyShaderModule(lveDevice.device(), pipelineInfo.stage.module, nullptr);
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create compute pipeline");
+        }
+        lveDevice.recordPipelineCreation(std::chrono::steady_clock::now() - start);
+    }
+
+    LVEComputePipeline::~LVEComputePipeline() {
+        vkDestroyPipeline(lveDevice.device(), computePipeline, nullptr);
+    }
+
+    void LVEComputePipeline::bind(VkCommandBuffer commandBuffer) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+    }
+}  // namespace lve
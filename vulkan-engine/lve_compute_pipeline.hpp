@@ -0,0 +1,27 @@
+#pragma once
+
+#include "lve_device.hpp"
+#include "lve_pipeline.hpp"
+
+namespace lve {
+    /**
+     * @brief A pipeline with a single compute shader stage. Unlike a graphics pipeline it has no
+     * fixed function state and does not depend on a render pass.
+     */
+    class LVEComputePipeline {
+       public:
+        LVEComputePipeline(LVEDevice &device,
+                           ShaderCode compCode,
+                           VkPipelineLayout pipelineLayout);
+        ~LVEComputePipeline();
+
+        LVEComputePipeline(const LVEComputePipeline &) = delete;
+        LVEComputePipeline &operator=(const LVEComputePipeline &) = delete;
+
+        void bind(VkCommandBuffer commandBuffer);
+
+       private:
+        LVEDevice &lveDevice;
+        VkPipeline computePipeline;
+    };
+}  // namespace lve
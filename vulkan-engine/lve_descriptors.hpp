@@ -0,0 +1,118 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "lve_device.hpp"
+
+namespace lve {
+    /**
+     * @brief Describes which resources a descriptor set contains, binding by binding. Built with
+     * the Builder, e.g.
+     * LVEDescriptorSetLayout::Builder{device}
+     *     .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+     *     .build();
+     */
+    class LVEDescriptorSetLayout {
+       public:
+        class Builder {
+           public:
+            Builder(LVEDevice &lveDevice) : lveDevice{lveDevice} {}
+
+            Builder &addBinding(uint32_t binding,
+                                VkDescriptorType descriptorType,
+                                VkShaderStageFlags stageFlags,
+                                uint32_t count = 1);
+            std::unique_ptr<LVEDescriptorSetLayout> build() const;
+
+           private:
+            LVEDevice &lveDevice;
+            std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+        };
+
+        LVEDescriptorSetLayout(LVEDevice &lveDevice,
+                               std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+        ~LVEDescriptorSetLayout();
+
+        LVEDescriptorSetLayout(const LVEDescriptorSetLayout &) = delete;
+        LVEDescriptorSetLayout &operator=(const LVEDescriptorSetLayout &) = delete;
+
+        VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+
+       private:
+        LVEDevice &lveDevice;
+        VkDescriptorSetLayout descriptorSetLayout;
+        std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings;
+
+        friend class LVEDescriptorWriter;
+    };
+
+    /**
+     * @brief Descriptor sets are allocated from a pool, which is sized up front for a maximum
+     * number of sets and descriptors of each type.
+     */
+    class LVEDescriptorPool {
+       public:
+        class Builder {
+           public:
+            Builder(LVEDevice &lveDevice) : lveDevice{lveDevice} {}
+
+            Builder &addPoolSize(VkDescriptorType descriptorType, uint32_t count);
+            Builder &setPoolFlags(VkDescriptorPoolCreateFlags flags);
+            Builder &setMaxSets(uint32_t count);
+            std::unique_ptr<LVEDescriptorPool> build() const;
+
+           private:
+            LVEDevice &lveDevice;
+            std::vector<VkDescriptorPoolSize> poolSizes{};
+            uint32_t maxSets = 1000;
+            VkDescriptorPoolCreateFlags poolFlags = 0;
+        };
+
+        LVEDescriptorPool(LVEDevice &lveDevice,
+                          uint32_t maxSets,
+                          VkDescriptorPoolCreateFlags poolFlags,
+                          const std::vector<VkDescriptorPoolSize> &poolSizes);
+        ~LVEDescriptorPool();
+
+        LVEDescriptorPool(const LVEDescriptorPool &) = delete;
+        LVEDescriptorPool &operator=(const LVEDescriptorPool &) = delete;
+
+        // Returns false if the pool ran out of space.
+        bool allocateDescriptor(const VkDescriptorSetLayout descriptorSetLayout,
+                                VkDescriptorSet &descriptor) const;
+        // Requires the pool to be created with VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT.
+        void freeDescriptors(std::vector<VkDescriptorSet> &descriptors) const;
+        // Frees every set allocated from the pool at once.
+        void resetPool();
+
+       private:
+        LVEDevice &lveDevice;
+        VkDescriptorPool descriptorPool;
+
+        friend class LVEDescriptorWriter;
+    };
+
+    /**
+     * @brief Collects the resources for the bindings of one set and writes them in one go.
+     */
+    class LVEDescriptorWriter {
+       public:
+        LVEDescriptorWriter(LVEDescriptorSetLayout &setLayout, LVEDescriptorPool &pool);
+
+        // The infos are referenced, not copied, so they have to live until build or overwrite.
+        LVEDescriptorWriter &writeBuffer(uint32_t binding, VkDescriptorBufferInfo *bufferInfo);
+        LVEDescriptorWriter &writeImage(uint32_t binding, VkDescriptorImageInfo *imageInfo);
+
+        // Allocates a new set and writes to it. Returns false if the pool ran out of space.
+        bool build(VkDescriptorSet &set);
+        // Writes to an existing set, which must not be in use by a pending command buffer.
+        void overwrite(VkDescriptorSet &set);
+
+       private:
+        LVEDescriptorSetLayout &setLayout;
+        LVEDescriptorPool &pool;
+        std::vector<VkWriteDescriptorSet> writes;
+    };
+}  // namespace lve
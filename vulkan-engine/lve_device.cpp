@@ -1,6 +1,10 @@
 #include "lve_device.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
 #include <iostream>
 #include <set>
 #include <unordered_set>
@@ -42,7 +46,8 @@ namespace lve {
     }
 
     // class member functions
-    LVEDevice::LVEDevice(LVEWindow &window) : window{window} {
+    LVEDevice::LVEDevice(LVEWindow &window)
+        : window{&window}, deviceExtensions{VK_KHR_SWAPCHAIN_EXTENSION_NAME} {
         // Create Vulkan instance
         createInstance();
         // Setup validation layers
@@ -53,9 +58,31 @@ namespace lve {
         // Features of the physical device we want to use
         createLogicalDevice();
         createCommandPool();
+        createFrameTimeline();
+        createPipelineCache();
+    }
+
+    LVEDevice::LVEDevice() : window{nullptr}, deviceExtensions{} {
+        createInstance();
+        setupDebugMessenger();
+        pickPhysicalDevice();
+        createLogicalDevice();
+        createCommandPool();
+        createFrameTimeline();
+        createPipelineCache();
     }
 
     LVEDevice::~LVEDevice() {
+        // Whatever is still queued may be in use by the last frames.
+        vkDeviceWaitIdle(device_);
+        for (auto &deferred : deferredDestructions) {
+            deferred.destroy();
+        }
+        deferredDestructions.clear();
+
+        savePipelineCache();
+        vkDestroyPipelineCache(device_, pipelineCache, nullptr);
+        vkDestroySemaphore(device_, frameTimeline, nullptr);
         vkDestroyCommandPool(device_, commandPool, nullptr);
         vkDestroyDevice(device_, nullptr);
 
@@ -63,7 +90,9 @@ namespace lve {
             DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
         }
 
-        vkDestroySurfaceKHR(instance, surface_, nullptr);
+        if (surface_ != VK_NULL_HANDLE) {
+            vkDestroySurfaceKHR(instance, surface_, nullptr);
+        }
         vkDestroyInstance(instance, nullptr);
     }
 
@@ -78,7 +107,16 @@ namespace lve {
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         appInfo.pEngineName = "No Engine";
         appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        // Ask for the newest version we know of that the loader supports. Features of newer
+        // versions are only turned on if the device supports them as well.
+        apiVersion = VK_API_VERSION_1_0;
+        auto enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
+            vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+        if (enumerateInstanceVersion != nullptr) {
+            enumerateInstanceVersion(&apiVersion);
+        }
+        apiVersion = std::min<uint32_t>(apiVersion, VK_API_VERSION_1_3);
+        appInfo.apiVersion = apiVersion;
 
         VkInstanceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -130,6 +168,7 @@ namespace lve {
 
         vkGetPhysicalDeviceProperties(physicalDevice, &properties);
         std::cout << "physical device: " << properties.deviceName << std::endl;
+        apiVersion = std::min(apiVersion, properties.apiVersion);
     }
 
     void LVEDevice::createLogicalDevice() {
@@ -148,18 +187,97 @@ namespace lve {
             queueCreateInfos.push_back(queueCreateInfo);
         }
 
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
         VkPhysicalDeviceFeatures deviceFeatures = {};
         deviceFeatures.samplerAnisotropy = VK_TRUE;
+        // Used by GPU driven rendering, which falls back to the CPU path without them.
+        deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+        deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+        // Used to count fragment shader invocations per pass, see LVEPassProfiler.
+        deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+        deviceFeatures.inheritedQueries = supportedFeatures.inheritedQueries;
+        enabledFeatures = deviceFeatures;
+
+        // Required Vulkan 1.2 features, checked by isDeviceSuitable.
+        VkPhysicalDeviceVulkan12Features features12{};
+        features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        // GPU progress is tracked with the frame timeline.
+        features12.timelineSemaphore = VK_TRUE;
+
+        // Optional Vulkan 1.3 features.
+        VkPhysicalDeviceVulkan13Features features13{};
+        features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+        if (apiVersion >= VK_API_VERSION_1_3) {
+            VkPhysicalDeviceVulkan13Features supportedFeatures13{};
+            supportedFeatures13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+            VkPhysicalDeviceFeatures2 supportedFeatures2{};
+            supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            supportedFeatures2.pNext = &supportedFeatures13;
+            vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures2);
+
+            // Render without render pass and framebuffer objects.
+            features13.dynamicRendering = supportedFeatures13.dynamicRendering;
+        }
+        enabledFeatures13 = features13;
+        enabledFeatures13.pNext = nullptr;
+
+        // Optional extensions.
+        std::vector<const char *> enabledExtensions = deviceExtensions;
+        calibratedTimestamps =
+            isDeviceExtensionSupported(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME) &&
+            supportsDeviceTimeDomain();
+        if (calibratedTimestamps) {
+            enabledExtensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+        }
+        VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures{};
+        pipelineLibraryFeatures.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+        graphicsPipelineLibrary =
+            isDeviceExtensionSupported(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+            isDeviceExtensionSupported(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+            supportsFastPipelineLinking();
+        if (graphicsPipelineLibrary) {
+            enabledExtensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+            enabledExtensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+            pipelineLibraryFeatures.graphicsPipelineLibrary = VK_TRUE;
+        }
+        // On top of the extended dynamic state of Vulkan 1.3.
+        VkPhysicalDeviceExtendedDynamicState3FeaturesEXT dynamicState3Features{};
+        dynamicState3Features.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+        if (supportsExtendedDynamicState() &&
+            isDeviceExtensionSupported(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME)) {
+            queryExtendedDynamicState3(dynamicState3Features);
+        }
+        const bool dynamicState3 = dynamicPolygonMode || unrestrictedDynamicTopology;
+        if (dynamicState3) {
+            enabledExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+        }
 
         VkDeviceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        createInfo.pNext = &features12;
+        void **featuresNext = &features12.pNext;
+        if (apiVersion >= VK_API_VERSION_1_3) {
+            *featuresNext = &features13;
+            featuresNext = &features13.pNext;
+        }
+        if (graphicsPipelineLibrary) {
+            *featuresNext = &pipelineLibraryFeatures;
+            featuresNext = &pipelineLibraryFeatures.pNext;
+        }
+        if (dynamicState3) {
+            *featuresNext = &dynamicState3Features;
+        }
 
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
         createInfo.pEnabledFeatures = &deviceFeatures;
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+        createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
         // might not really be necessary anymore because device specific validation layers
         // have been deprecated
@@ -175,7 +293,117 @@ namespace lve {
         }
 
         vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
-        vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+        if (!isHeadless()) {
+            vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+        }
+
+        if (calibratedTimestamps) {
+            getCalibratedTimestampsEXT = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(
+                vkGetDeviceProcAddr(device_, "vkGetCalibratedTimestampsEXT"));
+            calibratedTimestamps = getCalibratedTimestampsEXT != nullptr;
+        }
+        if (dynamicPolygonMode) {
+            cmdSetPolygonModeEXT = reinterpret_cast<PFN_vkCmdSetPolygonModeEXT>(
+                vkGetDeviceProcAddr(device_, "vkCmdSetPolygonModeEXT"));
+            dynamicPolygonMode = cmdSetPolygonModeEXT != nullptr;
+        }
+    }
+
+    bool LVEDevice::isDeviceExtensionSupported(const char *extensionName) {
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(
+            physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+        for (const auto &extension : availableExtensions) {
+            if (strcmp(extension.extensionName, extensionName) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool LVEDevice::supportsDeviceTimeDomain() {
+        auto getTimeDomains = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(
+            vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+        if (getTimeDomains == nullptr) {
+            return false;
+        }
+        uint32_t domainCount = 0;
+        getTimeDomains(physicalDevice, &domainCount, nullptr);
+        std::vector<VkTimeDomainEXT> domains(domainCount);
+        getTimeDomains(physicalDevice, &domainCount, domains.data());
+        return std::find(domains.begin(), domains.end(), VK_TIME_DOMAIN_DEVICE_EXT) !=
+               domains.end();
+    }
+
+    bool LVEDevice::supportsFastPipelineLinking() {
+        VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT supportedLibraryFeatures{};
+        supportedLibraryFeatures.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+        VkPhysicalDeviceFeatures2 supportedFeatures2{};
+        supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supportedFeatures2.pNext = &supportedLibraryFeatures;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures2);
+
+        // Without fast linking, linking may take as long as compiling the whole pipeline, which
+        // defeats the purpose.
+        VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT libraryProperties{};
+        libraryProperties.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &libraryProperties;
+        vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+        return supportedLibraryFeatures.graphicsPipelineLibrary == VK_TRUE &&
+               libraryProperties.graphicsPipelineLibraryFastLinking == VK_TRUE;
+    }
+
+    void LVEDevice::queryExtendedDynamicState3(
+        VkPhysicalDeviceExtendedDynamicState3FeaturesEXT &features) {
+        VkPhysicalDeviceExtendedDynamicState3FeaturesEXT supportedFeatures3{};
+        supportedFeatures3.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+        VkPhysicalDeviceFeatures2 supportedFeatures2{};
+        supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supportedFeatures2.pNext = &supportedFeatures3;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures2);
+
+        VkPhysicalDeviceExtendedDynamicState3PropertiesEXT properties3{};
+        properties3.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &properties3;
+        vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+
+        // The other states of the extension are not varied by anything yet.
+        features.extendedDynamicState3PolygonMode =
+            supportedFeatures3.extendedDynamicState3PolygonMode;
+        dynamicPolygonMode = supportedFeatures3.extendedDynamicState3PolygonMode == VK_TRUE;
+        // A property, which only holds while the extension is enabled.
+        unrestrictedDynamicTopology = properties3.dynamicPrimitiveTopologyUnrestricted == VK_TRUE;
+    }
+
+    void LVEDevice::cmdSetPolygonMode(VkCommandBuffer commandBuffer, VkPolygonMode polygonMode) {
+        assert(dynamicPolygonMode && "Dynamic polygon mode is not supported");
+        cmdSetPolygonModeEXT(commandBuffer, polygonMode);
+    }
+
+    void LVEDevice::getCalibratedTimestamp(uint64_t &deviceTimestamp,
+                                           std::chrono::steady_clock::time_point &hostTime) {
+        assert(calibratedTimestamps && "Calibrated timestamps are not supported");
+        // Only the device time domain is read. The host time domains differ between platforms,
+        // while bracketing the call with the steady clock works everywhere. The bracket is short
+        // compared to the latencies it is used to measure.
+        VkCalibratedTimestampInfoEXT timestampInfo{};
+        timestampInfo.sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+        timestampInfo.timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+        uint64_t maxDeviation = 0;
+        const auto before = std::chrono::steady_clock::now();
+        getCalibratedTimestampsEXT(device_, 1, &timestampInfo, &deviceTimestamp, &maxDeviation);
+        const auto after = std::chrono::steady_clock::now();
+        hostTime = before + (after - before) / 2;
     }
 
     void LVEDevice::createCommandPool() {
@@ -192,15 +420,189 @@ namespace lve {
         }
     }
 
-    void LVEDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
+    void LVEDevice::createFrameTimeline() {
+        VkSemaphoreTypeCreateInfo typeInfo{};
+        typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        // No frame is done yet.
+        typeInfo.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &typeInfo;
+        if (vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &frameTimeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create frame timeline semaphore!");
+        }
+    }
+
+    void LVEDevice::createPipelineCache() {
+        std::vector<char> data;
+        std::ifstream file{PIPELINE_CACHE_PATH, std::ios::ate | std::ios::binary};
+        if (file.is_open()) {
+            data.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(data.data(), data.size());
+            if (!file || !isPipelineCacheCompatible(data)) {
+                // Drivers are supposed to reject foreign data themselves, but not all of them do.
+                std::cout << "Ignoring pipeline cache " << PIPELINE_CACHE_PATH
+                          << ", it is from another device or driver" << std::endl;
+                data.clear();
+            }
+        }
+
+        VkPipelineCacheCreateInfo cacheInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cacheInfo.initialDataSize = data.size();
+        cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+        if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+        loadedPipelineCacheSize = data.size();
+    }
+
+    bool LVEDevice::isPipelineCacheCompatible(const std::vector<char> &data) const {
+        // VkPipelineCacheHeaderVersionOne: header size, header version, vendor ID, device ID and
+        // the pipeline cache UUID, which changes with the driver version.
+        constexpr size_t HEADER_SIZE = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+        if (data.size() < HEADER_SIZE) {
+            return false;
+        }
+        uint32_t header[4];
+        std::memcpy(header, data.data(), sizeof(header));
+        return header[0] >= HEADER_SIZE && header[0] <= data.size() &&
+               header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+               header[2] == properties.vendorID && header[3] == properties.deviceID &&
+               std::memcmp(data.data() + sizeof(header),
+                           properties.pipelineCacheUUID,
+                           VK_UUID_SIZE) == 0;
+    }
+
+    void LVEDevice::savePipelineCache() {
+        size_t size = 0;
+        if (vkGetPipelineCacheData(device_, pipelineCache, &size, nullptr) != VK_SUCCESS) {
+            std::cout << "Failed to get pipeline cache data" << std::endl;
+            return;
+        }
+        std::vector<char> data(size);
+        if (vkGetPipelineCacheData(device_, pipelineCache, &size, data.data()) != VK_SUCCESS) {
+            std::cout << "Failed to get pipeline cache data" << std::endl;
+            return;
+        }
+        data.resize(size);
+
+        // Written next to the old file first, so a crash halfway leaves the old file intact.
+        const std::string tempPath = std::string{PIPELINE_CACHE_PATH} + ".tmp";
+        {
+            std::ofstream file{tempPath, std::ios::binary | std::ios::trunc};
+            file.write(data.data(), data.size());
+            if (!file) {
+                std::cout << "Failed to write pipeline cache " << tempPath << std::endl;
+                return;
+            }
+        }
+        // Renaming onto an existing file fails on Windows.
+        if (std::rename(tempPath.c_str(), PIPELINE_CACHE_PATH) != 0 &&
+            (std::remove(PIPELINE_CACHE_PATH) != 0 ||
+             std::rename(tempPath.c_str(), PIPELINE_CACHE_PATH) != 0)) {
+            std::cout << "Failed to write pipeline cache " << PIPELINE_CACHE_PATH << std::endl;
+        }
+    }
+
+    void LVEDevice::recordPipelineCreation(std::chrono::steady_clock::duration duration) {
+        pipelineCount++;
+        pipelineCreationNs +=
+            std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    }
+
+    LVEDevice::PipelineStats LVEDevice::getPipelineStats() const {
+        PipelineStats stats{};
+        stats.loadedCacheSize = loadedPipelineCacheSize;
+        stats.pipelineCount = pipelineCount;
+        stats.creationTimeMs = static_cast<double>(pipelineCreationNs) / 1e6;
+        return stats;
+    }
+
+    uint64_t LVEDevice::getCompletedFrame() {
+        uint64_t value = 0;
+        if (vkGetSemaphoreCounterValue(device_, frameTimeline, &value) != VK_SUCCESS) {
+            throw std::runtime_error("failed to read frame timeline semaphore!");
+        }
+        updateCompletedFrame(value);
+        return lastCompletedFrame;
+    }
+
+    void LVEDevice::updateCompletedFrame(uint64_t frame) {
+        // Only ever moves forward, even if several threads update it at once.
+        uint64_t completed = lastCompletedFrame;
+        while (completed < frame &&
+               !lastCompletedFrame.compare_exchange_weak(completed, frame)) {
+        }
+    }
+
+    bool LVEDevice::waitForFrame(uint64_t frame, uint64_t timeout) {
+        if (frame <= lastCompletedFrame) {
+            return true;
+        }
+        assert(frame <= lastSubmittedFrame && "Waiting for a frame that was never submitted");
+
+        VkSemaphoreWaitInfo waitInfo{};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &frameTimeline;
+        waitInfo.pValues = &frame;
+        const VkResult result = vkWaitSemaphores(device_, &waitInfo, timeout);
+        if (result == VK_TIMEOUT) {
+            return false;
+        }
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to wait for frame timeline semaphore!");
+        }
+        updateCompletedFrame(frame);
+        return true;
+    }
+
+    void LVEDevice::deferDestruction(std::function<void()> destroy) {
+        std::lock_guard<std::mutex> lock{deferredDestructionMutex};
+        deferredDestructions.push_back({getRecordingFrame(), std::move(destroy)});
+    }
+
+    void LVEDevice::destroyBufferDeferred(VkBuffer buffer, VkDeviceMemory memory) {
+        deferDestruction([device = device_, buffer, memory]() {
+            vkDestroyBuffer(device, buffer, nullptr);
+            vkFreeMemory(device, memory, nullptr);
+        });
+    }
+
+    void LVEDevice::collectDeferredDestructions() {
+        // Destroyed outside of the lock, so destructors may queue further destructions.
+        std::vector<std::function<void()>> ready;
+        {
+            std::lock_guard<std::mutex> lock{deferredDestructionMutex};
+            if (deferredDestructions.empty()) {
+                return;
+            }
+            const uint64_t completedFrame = getCompletedFrame();
+            while (!deferredDestructions.empty() &&
+                   deferredDestructions.front().frame <= completedFrame) {
+                ready.push_back(std::move(deferredDestructions.front().destroy));
+                deferredDestructions.pop_front();
+            }
+        }
+        for (auto &destroy : ready) {
+            destroy();
+        }
+    }
+
+    void LVEDevice::createSurface() { window->createWindowSurface(instance, &surface_); }
 
     bool LVEDevice::isDeviceSuitable(VkPhysicalDevice device) {
         QueueFamilyIndices indices = findQueueFamilies(device);
 
         bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-        bool swapChainAdequate = false;
-        if (extensionsSupported) {
+        // Without a window nothing is presented.
+        bool swapChainAdequate = isHeadless();
+        if (extensionsSupported && !isHeadless()) {
             SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
             swapChainAdequate =
                 !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
@@ -210,7 +612,24 @@ namespace lve {
         vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
         return indices.isComplete() && extensionsSupported && swapChainAdequate &&
-               supportedFeatures.samplerAnisotropy;
+               supportedFeatures.samplerAnisotropy && supportsTimelineSemaphores(device);
+    }
+
+    bool LVEDevice::supportsTimelineSemaphores(VkPhysicalDevice device) {
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(device, &deviceProperties);
+        // Core in Vulkan 1.2, which both the instance and the device have to support.
+        if (std::min(apiVersion, deviceProperties.apiVersion) < VK_API_VERSION_1_2) {
+            return false;
+        }
+
+        VkPhysicalDeviceVulkan12Features supportedFeatures12{};
+        supportedFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 supportedFeatures2{};
+        supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supportedFeatures2.pNext = &supportedFeatures12;
+        vkGetPhysicalDeviceFeatures2(device, &supportedFeatures2);
+        return supportedFeatures12.timelineSemaphore == VK_TRUE;
     }
 
     void LVEDevice::populateDebugMessengerCreateInfo(
@@ -262,11 +681,14 @@ namespace lve {
     }
 
     std::vector<const char *> LVEDevice::getRequiredExtensions() {
-        uint32_t glfwExtensionCount = 0;
-        const char **glfwExtensions;
-        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-        std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        std::vector<const char *> extensions;
+        // Headless devices never create a surface, so they do not need GLFW (or a display).
+        if (!isHeadless()) {
+            uint32_t glfwExtensionCount = 0;
+            const char **glfwExtensions;
+            glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+            extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        }
 
         if (enableValidationLayers) {
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -331,7 +753,13 @@ namespace lve {
                 indices.graphicsFamilyHasValue = true;
             }
             VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+            if (isHeadless()) {
+                // Nothing is presented, the graphics queue stands in for the present queue.
+                presentSupport = indices.graphicsFamilyHasValue &&
+                                 indices.graphicsFamily == static_cast<uint32_t>(i);
+            } else {
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+            }
             if (queueFamily.queueCount > 0 && presentSupport) {
                 indices.presentFamily = i;
                 indices.presentFamilyHasValue = true;
@@ -388,17 +816,33 @@ namespace lve {
         throw std::runtime_error("failed to find supported format!");
     }
 
+    bool LVEDevice::hasFormatFeatures(VkFormat format, VkFormatFeatureFlags features) {
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+        return (props.optimalTilingFeatures & features) == features;
+    }
+
     uint32_t LVEDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+        uint32_t memoryType;
+        if (!tryFindMemoryType(typeFilter, properties, memoryType)) {
+            throw std::runtime_error("failed to find suitable memory type!");
+        }
+        return memoryType;
+    }
+
+    bool LVEDevice::tryFindMemoryType(uint32_t typeFilter,
+                                      VkMemoryPropertyFlags properties,
+                                      uint32_t &memoryType) {
         VkPhysicalDeviceMemoryProperties memProperties;
         vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
         for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
             if ((typeFilter & (1 << i)) &&
                 (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-                return i;
+                memoryType = i;
+                return true;
             }
         }
-
-        throw std::runtime_error("failed to find suitable memory type!");
+        return false;
     }
 
     void LVEDevice::createBuffer(VkDeviceSize size,
@@ -504,7 +948,8 @@ namespace lve {
     void LVEDevice::createImageWithInfo(const VkImageCreateInfo &imageInfo,
                                         VkMemoryPropertyFlags properties,
                                         VkImage &image,
-                                        VkDeviceMemory &imageMemory) {
+                                        VkDeviceMemory &imageMemory,
+                                        VkMemoryPropertyFlags preferredProperties) {
         if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
             throw std::runtime_error("failed to create image!");
         }
@@ -515,7 +960,12 @@ namespace lve {
         VkMemoryAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
         allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+        if (preferredProperties == 0 ||
+            !tryFindMemoryType(memRequirements.memoryTypeBits,
+                               properties | preferredProperties,
+                               allocInfo.memoryTypeIndex)) {
+            allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+        }
 
         if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
             throw std::runtime_error("failed to allocate image memory!");
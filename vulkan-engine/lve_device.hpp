@@ -1,5 +1,10 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -30,6 +35,10 @@ namespace lve {
 #endif
 
         LVEDevice(LVEWindow &window);
+        // Headless: No window, surface or swap chain support is needed, so any device with a
+        // graphics queue will do, including software rasterizers like lavapipe. Present
+        // queue and surface are VK_NULL_HANDLE.
+        LVEDevice();
         ~LVEDevice();
 
         // Not copyable or movable
@@ -43,15 +52,22 @@ namespace lve {
         VkSurfaceKHR surface() { return surface_; }
         VkQueue graphicsQueue() { return graphicsQueue_; }
         VkQueue presentQueue() { return presentQueue_; }
+        bool isHeadless() const { return window == nullptr; }
 
         SwapChainSupportDetails getSwapChainSupport() {
             return querySwapChainSupport(physicalDevice);
         }
         uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+        // Same, but returns false instead of throwing if there is none.
+        bool tryFindMemoryType(uint32_t typeFilter,
+                               VkMemoryPropertyFlags properties,
+                               uint32_t &memoryType);
         QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
         VkFormat findSupportedFormat(const std::vector<VkFormat> &candidates,
                                      VkImageTiling tiling,
                                      VkFormatFeatureFlags features);
+        // Whether images of the format with optimal tiling have all the features.
+        bool hasFormatFeatures(VkFormat format, VkFormatFeatureFlags features);
 
         // Buffer Helper Functions
         void createBuffer(VkDeviceSize size,
@@ -65,12 +81,98 @@ namespace lve {
         void copyBufferToImage(
             VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
 
+        // preferredProperties are added to properties if a memory type has them all.
         void createImageWithInfo(const VkImageCreateInfo &imageInfo,
                                  VkMemoryPropertyFlags properties,
                                  VkImage &image,
-                                 VkDeviceMemory &imageMemory);
+                                 VkDeviceMemory &imageMemory,
+                                 VkMemoryPropertyFlags preferredProperties = 0);
+
+        // Whether pipelines can be built from separately compiled parts that link quickly
+        // (VK_EXT_graphics_pipeline_library with fast linking).
+        bool supportsGraphicsPipelineLibrary() const { return graphicsPipelineLibrary; }
+
+        // Whether cull mode, front face, topology, primitive restart, depth bias enable and the
+        // depth test can be set while recording (extended dynamic state 1 and 2, core in 1.3).
+        bool supportsExtendedDynamicState() const { return apiVersion >= VK_API_VERSION_1_3; }
+        // Whether the topology can change to another class (e.g. lines to triangles) than the
+        // pipeline was created with. Only the class is baked in otherwise.
+        bool supportsUnrestrictedDynamicTopology() const { return unrestrictedDynamicTopology; }
+        // Whether cmdSetPolygonMode can be used (VK_EXT_extended_dynamic_state3).
+        bool supportsDynamicPolygonMode() const { return dynamicPolygonMode; }
+        void cmdSetPolygonMode(VkCommandBuffer commandBuffer, VkPolygonMode polygonMode);
+
+        // Whether getCalibratedTimestamp can be used (VK_EXT_calibrated_timestamps).
+        bool supportsCalibratedTimestamps() const { return calibratedTimestamps; }
+        // Reads the current GPU timestamp, in the units of timestamp queries, and the CPU time it
+        // was taken at. Used to put GPU timestamps on the CPU timeline.
+        void getCalibratedTimestamp(uint64_t &deviceTimestamp,
+                                    std::chrono::steady_clock::time_point &hostTime);
+
+        /**
+         * @brief GPU progress, engine wide. Every frame submission signals the frame timeline
+         * semaphore with its frame number. Numbers start at 1 and increase by one per frame, so
+         * whether frame N is done is a single comparison. Anything that has to wait for the GPU,
+         * like uploads, deletion queues and readbacks, can remember the frame number it was
+         * recorded in, instead of creating a fence.
+         */
+        VkSemaphore getFrameTimeline() { return frameTimeline; }
+        // Hands out the number the next frame submission signals the frame timeline with. Must
+        // be called from the thread that submits frames, right before the submission.
+        uint64_t beginFrameSubmission() { return ++lastSubmittedFrame; }
+        // The frame that was submitted last, 0 before the first one.
+        uint64_t getLastSubmittedFrame() const { return lastSubmittedFrame; }
+        // The frame that is being recorded, or the next one if none is. Everything recorded so
+        // far is done once this frame is.
+        uint64_t getRecordingFrame() const { return lastSubmittedFrame + 1; }
+        // The last frame the GPU has finished. Does not wait.
+        uint64_t getCompletedFrame();
+        bool isFrameComplete(uint64_t frame) {
+            return frame <= lastCompletedFrame || frame <= getCompletedFrame();
+        }
+        // Blocks until the GPU has finished the frame. Returns false on timeout.
+        bool waitForFrame(uint64_t frame, uint64_t timeout = UINT64_MAX);
+
+        /**
+         * @brief Deferred destruction. destroy is called once the frame that is being recorded
+         * is done, so objects can be released while frames in flight, including the current one,
+         * may still use them. Thread safe.
+         * The queue is processed by collectDeferredDestructions, which renderers call at the
+         * start of every frame, and flushed when the device is destroyed.
+         */
+        void deferDestruction(std::function<void()> destroy);
+        void destroyBufferDeferred(VkBuffer buffer, VkDeviceMemory memory);
+        // Runs the destructions whose frames are done. Does not wait.
+        void collectDeferredDestructions();
+
+        /**
+         * @brief The pipeline cache every pipeline is created with. Loaded from
+         * PIPELINE_CACHE_PATH when the device is created and written back when it is destroyed,
+         * so later runs skip most of the shader compilation. Files written for another GPU or
+         * driver are ignored.
+         */
+        static constexpr const char *PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+        VkPipelineCache getPipelineCache() { return pipelineCache; }
+        // Writes the cache to disk now instead of at shutdown. Failures are only reported.
+        void savePipelineCache();
+
+        struct PipelineStats {
+            // Size of the cache that was loaded, 0 if it started out empty.
+            size_t loadedCacheSize = 0;
+            uint32_t pipelineCount = 0;
+            // Spent in vkCreate*Pipelines, summed over all threads that create pipelines.
+            double creationTimeMs = 0.0;
+        };
+        // Pipelines report how long their creation took. Thread safe.
+        void recordPipelineCreation(std::chrono::steady_clock::duration duration);
+        PipelineStats getPipelineStats() const;
 
         VkPhysicalDeviceProperties properties;
+        // The optional features that were found and turned on, on top of the required ones.
+        VkPhysicalDeviceFeatures enabledFeatures{};
+        VkPhysicalDeviceVulkan13Features enabledFeatures13{};
+        // The Vulkan version that can be used, the lower one of the instance and the device.
+        uint32_t apiVersion = VK_API_VERSION_1_0;
 
        private:
         void createInstance();
@@ -79,6 +181,11 @@ namespace lve {
         void pickPhysicalDevice();
         void createLogicalDevice();
         void createCommandPool();
+        void createFrameTimeline();
+        void createPipelineCache();
+        // Whether the data starts with a header that matches this device and driver.
+        bool isPipelineCacheCompatible(const std::vector<char> &data) const;
+        void updateCompletedFrame(uint64_t frame);
 
         // helper functions
         bool isDeviceSuitable(VkPhysicalDevice device);
@@ -88,21 +195,54 @@ namespace lve {
         void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
         void hasGflwRequiredInstanceExtensions();
         bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+        bool isDeviceExtensionSupported(const char *extensionName);
+        bool supportsDeviceTimeDomain();
+        bool supportsFastPipelineLinking();
+        // Fills in which of the extended dynamic state 3 features are used.
+        void queryExtendedDynamicState3(VkPhysicalDeviceExtendedDynamicState3FeaturesEXT &features);
+        bool supportsTimelineSemaphores(VkPhysicalDevice device);
         SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
         VkInstance instance;
         VkDebugUtilsMessengerEXT debugMessenger;
         VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-        LVEWindow &window;
+        // nullptr for headless devices.
+        LVEWindow *window;
         VkCommandPool commandPool;
 
         VkDevice device_;
-        VkSurfaceKHR surface_;
+        VkSurfaceKHR surface_ = VK_NULL_HANDLE;
         VkQueue graphicsQueue_;
-        VkQueue presentQueue_;
+        VkQueue presentQueue_ = VK_NULL_HANDLE;
 
         const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
-        const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+        // Empty for headless devices.
+        const std::vector<const char *> deviceExtensions;
+        bool calibratedTimestamps = false;
+        bool graphicsPipelineLibrary = false;
+        bool unrestrictedDynamicTopology = false;
+        bool dynamicPolygonMode = false;
+        PFN_vkCmdSetPolygonModeEXT cmdSetPolygonModeEXT = nullptr;
+        PFN_vkGetCalibratedTimestampsEXT getCalibratedTimestampsEXT = nullptr;
+
+        VkSemaphore frameTimeline = VK_NULL_HANDLE;
+        // Atomic, because deferred destructions are tagged from any thread.
+        std::atomic<uint64_t> lastSubmittedFrame{0};
+        // Cached, so polling for frames that are long done does not call into the driver.
+        std::atomic<uint64_t> lastCompletedFrame{0};
+
+        VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+        size_t loadedPipelineCacheSize = 0;
+        std::atomic<uint32_t> pipelineCount{0};
+        std::atomic<int64_t> pipelineCreationNs{0};
+
+        struct DeferredDestruction {
+            uint64_t frame;
+            std::function<void()> destroy;
+        };
+        std::mutex deferredDestructionMutex;
+        // Ordered by frame, since frame numbers only grow.
+        std::deque<DeferredDestruction> deferredDestructions;
     };
 
 }  // namespace lve
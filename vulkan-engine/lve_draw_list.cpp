@@ -0,0 +1,61 @@
+#include "lve_draw_list.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace lve {
+
+    uint64_t DrawKey::make(uint32_t pipelineId,
+                           uint32_t materialId,
+                           uint32_t modelId,
+                           float depth) {
+        constexpr uint64_t depthMax = (1ull << DEPTH_BITS) - 1;
+        const float clampedDepth = std::clamp(depth, 0.0f, 1.0f);
+        const uint64_t quantizedDepth =
+            static_cast<uint64_t>(clampedDepth * static_cast<float>(depthMax));
+
+        return (static_cast<uint64_t>(pipelineId & ((1u << PIPELINE_BITS) - 1)) << PIPELINE_SHIFT) |
+               (static_cast<uint64_t>(materialId & ((1u << MATERIAL_BITS) - 1)) << MATERIAL_SHIFT) |
+               (static_cast<uint64_t>(modelId & ((1u << MODEL_BITS) - 1)) << MODEL_SHIFT) |
+               (std::min(quantizedDepth, depthMax) << DEPTH_SHIFT);
+    }
+
+    void LVEDrawList::sort() {
+        constexpr uint32_t passCount = sizeof(uint64_t);
+        constexpr uint32_t bucketCount = 256;
+        if (items.size() < 2) {
+            return;
+        }
+
+        // Build the histograms of all passes in a single sweep over the keys.
+        std::array<std::array<uint32_t, bucketCount>, passCount> histograms{};
+        for (const auto &item : items) {
+            for (uint32_t pass = 0; pass < passCount; pass++) {
+                histograms[pass][(item.key >> (pass * 8)) & 0xff]++;
+            }
+        }
+
+        scratch.resize(items.size());
+        const auto itemCount = static_cast<uint32_t>(items.size());
+        for (uint32_t pass = 0; pass < passCount; pass++) {
+            auto &histogram = histograms[pass];
+            // All keys share this byte, so this pass would not move anything.
+            const uint32_t firstByte = (items[0].key >> (pass * 8)) & 0xff;
+            if (histogram[firstByte] == itemCount) {
+                continue;
+            }
+
+            // Turn the counts into the starting offset of every bucket.
+            uint32_t offset = 0;
+            for (auto &count : histogram) {
+                const uint32_t bucketSize = count;
+                count = offset;
+                offset += bucketSize;
+            }
+            for (const auto &item : items) {
+                scratch[histogram[(item.key >> (pass * 8)) & 0xff]++] = item;
+            }
+            items.swap(scratch);
+        }
+    }
+}  // namespace lve
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+    /**
+     * @brief Packs the state a draw needs into a 64 bit integer so that sorting the keys groups
+     * draws by how expensive it is to switch between them. From most to least significant:
+     * pipeline (8 bits) | material (12 bits) | model (20 bits) | depth (24 bits)
+     * Ids wider than their field are wrapped. That only costs a few extra state changes, because
+     * the command state tracker compares the actual objects, not the ids.
+     */
+    struct DrawKey {
+        static constexpr uint32_t DEPTH_BITS = 24;
+        static constexpr uint32_t MODEL_BITS = 20;
+        static constexpr uint32_t MATERIAL_BITS = 12;
+        static constexpr uint32_t PIPELINE_BITS = 8;
+
+        static constexpr uint32_t DEPTH_SHIFT = 0;
+        static constexpr uint32_t MODEL_SHIFT = DEPTH_SHIFT + DEPTH_BITS;
+        static constexpr uint32_t MATERIAL_SHIFT = MODEL_SHIFT + MODEL_BITS;
+        static constexpr uint32_t PIPELINE_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+        static_assert(PIPELINE_SHIFT + PIPELINE_BITS == 64, "Draw key fields must fill 64 bits");
+
+        // depth is the normalized device depth in [0, 1]. Smaller values sort first, so opaque
+        // draws within the same state are rendered front to back.
+        static uint64_t make(uint32_t pipelineId,
+                             uint32_t materialId,
+                             uint32_t modelId,
+                             float depth);
+    };
+
+    struct DrawItem {
+        uint64_t key;
+        uint32_t objectIndex;
+    };
+
+    /**
+     * @brief A list of draws that is rebuilt every frame and sorted by DrawKey with a radix sort.
+     */
+    class LVEDrawList {
+       public:
+        void clear() { items.clear(); }
+        void reserve(size_t count) { items.reserve(count); }
+        void add(uint64_t key, uint32_t objectIndex) { items.push_back({key, objectIndex}); }
+
+        // Stable LSD radix sort on the keys, one byte per pass. Passes in which every key has the
+        // same byte are skipped, which is common for the pipeline and material bytes.
+        void sort();
+
+        size_t size() const { return items.size(); }
+        bool empty() const { return items.empty(); }
+        const DrawItem &operator[](size_t index) const { return items[index]; }
+        std::vector<DrawItem>::const_iterator begin() const { return items.begin(); }
+        std::vector<DrawItem>::const_iterator end() const { return items.end(); }
+
+       private:
+        std::vector<DrawItem> items;
+        // Ping-pong buffer for the radix sort, kept around to avoid reallocating every frame.
+        std::vector<DrawItem> scratch;
+    };
+}  // namespace lve
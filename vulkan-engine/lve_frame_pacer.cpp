@@ -0,0 +1,42 @@
+#include "lve_frame_pacer.hpp"
+
+#include <thread>
+
+namespace lve {
+
+    namespace {
+        // Sleeping is only accurate to about a millisecond on some platforms, so the last part
+        // of the wait spins.
+        constexpr auto SPIN_DURATION = std::chrono::microseconds(1500);
+    }  // namespace
+
+    LVEFramePacer::LVEFramePacer(double targetFrameRate) { setTargetFrameRate(targetFrameRate); }
+
+    void LVEFramePacer::setTargetFrameRate(double frameRate) {
+        targetFrameRate = frameRate;
+        framePeriod = frameRate > 0.0 ? std::chrono::duration_cast<Clock::duration>(
+                                            std::chrono::duration<double>(1.0 / frameRate))
+                                      : Clock::duration::zero();
+        nextFrameTime = Clock::now();
+    }
+
+    void LVEFramePacer::waitForNextFrame() {
+        if (framePeriod == Clock::duration::zero()) {
+            return;
+        }
+
+        auto now = Clock::now();
+        if (now < nextFrameTime) {
+            if (nextFrameTime - now > SPIN_DURATION) {
+                std::this_thread::sleep_until(nextFrameTime - SPIN_DURATION);
+            }
+            while (Clock::now() < nextFrameTime) {
+                std::this_thread::yield();
+            }
+            nextFrameTime += framePeriod;
+        } else {
+            // Running late. Start the schedule over from now instead of catching up.
+            nextFrameTime = now + framePeriod;
+        }
+    }
+}  // namespace lve
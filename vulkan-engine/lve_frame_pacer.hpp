@@ -0,0 +1,28 @@
+#pragma once
+
+#include <chrono>
+
+namespace lve {
+    /**
+     * @brief Caps the frame rate by waiting at the start of every frame until its time slot has
+     * come. Frames that run late do not try to catch up, so a hitch is not followed by a burst.
+     */
+    class LVEFramePacer {
+       public:
+        using Clock = std::chrono::steady_clock;
+
+        // 0 leaves the frame rate uncapped.
+        explicit LVEFramePacer(double targetFrameRate = 0.0);
+
+        void setTargetFrameRate(double targetFrameRate);
+        double getTargetFrameRate() const { return targetFrameRate; }
+
+        // Blocks until the next frame may start. Returns immediately when uncapped.
+        void waitForNextFrame();
+
+       private:
+        double targetFrameRate;
+        Clock::duration framePeriod{};
+        Clock::time_point nextFrameTime{};
+    };
+}  // namespace lve
@@ -0,0 +1,362 @@
+#include "lve_headless_renderer.hpp"
+
+#include <array>
+#include <stdexcept>
+
+namespace lve {
+
+    LVEHeadlessRenderer::LVEHeadlessRenderer(LVEDevice& device,
+                                             VkExtent2D extent,
+                                             int framesInFlight)
+        : lveDevice{device}, extent{extent} {
+        assert(framesInFlight > 0 && "Need at least one frame in flight");
+        depthFormat = lveDevice.findSupportedFormat(
+            {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+        frames.resize(framesInFlight);
+        createRenderPass();
+        createFrames();
+    }
+
+    LVEHeadlessRenderer::~LVEHeadlessRenderer() {
+        vkDeviceWaitIdle(lveDevice.device());
+        for (auto& frame : frames) {
+            vkFreeCommandBuffers(
+                lveDevice.device(), lveDevice.getCommandPool(), 1, &frame.commandBuffer);
+            vkDestroyFramebuffer(lveDevice.device(), frame.framebuffer, nullptr);
+            vkDestroyImageView(lveDevice.device(), frame.colorImageView, nullptr);
+            vkDestroyImage(lveDevice.device(), frame.colorImage, nullptr);
+            vkFreeMemory(lveDevice.device(), frame.colorImageMemory, nullptr);
+            vkDestroyImageView(lveDevice.device(), frame.depthImageView, nullptr);
+            vkDestroyImage(lveDevice.device(), frame.depthImage, nullptr);
+            vkFreeMemory(lveDevice.device(), frame.depthImageMemory, nullptr);
+        }
+        vkDestroyRenderPass(lveDevice.device(), renderPass, nullptr);
+    }
+
+    void LVEHeadlessRenderer::createRenderPass() {
+        VkAttachmentDescription colorAttachment{};
+        colorAttachment.format = COLOR_FORMAT;
+        colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        // Ready to be copied into the readback buffer.
+        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+        VkAttachmentDescription depthAttachment{};
+        depthAttachment.format = depthFormat;
+        depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference colorAttachmentRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+        VkAttachmentReference depthAttachmentRef{1,
+                                                 VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorAttachmentRef;
+        subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+        // The images of a frame index are only reused after its frame is done, so the
+        // first dependency only orders the layout transitions. The second one makes the color
+        // writes visible to the copy at the end of the frame.
+        std::array<VkSubpassDependency, 2> dependencies{};
+        dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[0].dstSubpass = 0;
+        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                       VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependencies[0].srcAccessMask = 0;
+        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                       VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependencies[1].srcSubpass = 0;
+        dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        renderPassInfo.pAttachments = attachments.data();
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+        renderPassInfo.pDependencies = dependencies.data();
+
+        if (vkCreateRenderPass(lveDevice.device(), &renderPassInfo, nullptr, &renderPass) !=
+            VK_SUCCESS) {
+            throw std::runtime_error("Failed to create headless render pass");
+        }
+    }
+
+    void LVEHeadlessRenderer::createFrames() {
+        for (auto& frame : frames) {
+            createImage(COLOR_FORMAT,
+                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                        VK_IMAGE_ASPECT_COLOR_BIT,
+                        frame.colorImage,
+                        frame.colorImageMemory,
+                        frame.colorImageView);
+            createImage(depthFormat,
+                        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                        VK_IMAGE_ASPECT_DEPTH_BIT,
+                        frame.depthImage,
+                        frame.depthImageMemory,
+                        frame.depthImageView);
+
+            std::array<VkImageView, 2> attachments = {frame.colorImageView, frame.depthImageView};
+            VkFramebufferCreateInfo framebufferInfo{};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = renderPass;
+            framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+            framebufferInfo.pAttachments = attachments.data();
+            framebufferInfo.width = extent.width;
+            framebufferInfo.height = extent.height;
+            framebufferInfo.layers = 1;
+            if (vkCreateFramebuffer(
+                    lveDevice.device(), &framebufferInfo, nullptr, &frame.framebuffer) !=
+                VK_SUCCESS) {
+                throw std::runtime_error("Failed to create headless framebuffer");
+            }
+
+            // Host coherent, so the pixels can be read as soon as the frame is done.
+            frame.readbackBuffer = std::make_unique<LVEBuffer>(
+                lveDevice,
+                4,
+                extent.width * extent.height,
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            // Stays mapped for the lifetime of the buffer.
+            frame.readbackBuffer->map();
+
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandPool = lveDevice.getCommandPool();
+            allocInfo.commandBufferCount = 1;
+            if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo, &frame.commandBuffer) !=
+                VK_SUCCESS) {
+                throw std::runtime_error("Failed to allocate command buffers");
+            }
+        }
+    }
+
+    void LVEHeadlessRenderer::createImage(VkFormat format,
+                                          VkImageUsageFlags usage,
+                                          VkImageAspectFlags aspect,
+                                          VkImage& image,
+                                          VkDeviceMemory& memory,
+                                          VkImageView& view) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = extent.width;
+        imageInfo.extent.height = extent.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = usage;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        lveDevice.createImageWithInfo(
+            imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange.aspectMask = aspect;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+        if (vkCreateImageView(lveDevice.device(), &viewInfo, nullptr, &view) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create headless image view");
+        }
+    }
+
+    VkCommandBuffer LVEHeadlessRenderer::beginFrame() {
+        assert(!isFrameStarted && "Cannot call beginFrame while already in progress.");
+        lveDevice.collectDeferredDestructions();
+        auto& frame = frames[currentFrameIndex];
+        // Frames finish in submission order, so everything older than this frame index is
+        // handed out on the way.
+        while (frame.readbackPending) {
+            auto& oldest = frames[oldestPendingFrameIndex];
+            lveDevice.waitForFrame(oldest.timelineFrame);
+            deliverReadback(oldest);
+        }
+
+        isFrameStarted = true;
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        if (vkBeginCommandBuffer(frame.commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to begin recording command buffer");
+        }
+        return frame.commandBuffer;
+    }
+
+    void LVEHeadlessRenderer::endFrame() {
+        assert(isFrameStarted && "Cannot call endFrame while frame is not in progress");
+        auto& frame = frames[currentFrameIndex];
+        auto commandBuffer = frame.commandBuffer;
+
+        // The render pass left the color image in TRANSFER_SRC_OPTIMAL.
+        VkBufferImageCopy region{};
+        region.bufferOffset = 0;
+        // Tightly packed rows.
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {extent.width, extent.height, 1};
+        vkCmdCopyImageToBuffer(commandBuffer,
+                               frame.colorImage,
+                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               frame.readbackBuffer->getBuffer(),
+                               1,
+                               &region);
+
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = frame.readbackBuffer->getBuffer();
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_HOST_BIT,
+                             0,
+                             0,
+                             nullptr,
+                             1,
+                             &barrier,
+                             0,
+                             nullptr);
+
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to record command buffer");
+        }
+
+        frame.timelineFrame = lveDevice.beginFrameSubmission();
+        VkSemaphore frameTimeline = lveDevice.getFrameTimeline();
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &frame.timelineFrame;
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &frameTimeline;
+        if (vkQueueSubmit(lveDevice.graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE) !=
+            VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit headless frame");
+        }
+        frame.readbackPending = true;
+        frame.frameNumber = nextFrameNumber++;
+
+        isFrameStarted = false;
+        currentFrameIndex = (currentFrameIndex + 1) % static_cast<int>(frames.size());
+    }
+
+    void LVEHeadlessRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer,
+                                                       VkSubpassContents contents) {
+        assert(isFrameStarted &&
+               "Cannot call beginSwapChainRenderPass while frame is not in progress");
+        assert(commandBuffer == getCurrentCommandBuffer() &&
+               "Cannot begin render pass on command buffer from a different frame");
+
+        // Same clear values as LVERenderer.
+        std::array<VkClearValue, 2> clearValues{};
+        clearValues[0].color = {0.01f, 0.01f, 0.01f, 0.1f};
+        clearValues[1].depthStencil = {1.0f, 0};
+
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = renderPass;
+        renderPassInfo.framebuffer = frames[currentFrameIndex].framebuffer;
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = extent;
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.pClearValues = clearValues.data();
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+
+        if (contents == VK_SUBPASS_CONTENTS_INLINE) {
+            VkViewport viewport{};
+            viewport.width = static_cast<float>(extent.width);
+            viewport.height = static_cast<float>(extent.height);
+            viewport.minDepth = 0.0f;
+            viewport.maxDepth = 1.0f;
+            VkRect2D scissor{{0, 0}, extent};
+            vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+            vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        }
+    }
+
+    void LVEHeadlessRenderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer) {
+        assert(isFrameStarted &&
+               "Cannot call endSwapChainRenderPass while frame is not in progress");
+        assert(commandBuffer == getCurrentCommandBuffer() &&
+               "Cannot end render pass on command buffer from a different frame");
+        vkCmdEndRenderPass(commandBuffer);
+    }
+
+    void LVEHeadlessRenderer::pollReadbacks() {
+        while (frames[oldestPendingFrameIndex].readbackPending) {
+            auto& oldest = frames[oldestPendingFrameIndex];
+            if (!lveDevice.isFrameComplete(oldest.timelineFrame)) {
+                return;
+            }
+            deliverReadback(oldest);
+        }
+    }
+
+    void LVEHeadlessRenderer::flushReadbacks() {
+        assert(!isFrameStarted && "Cannot flush readbacks while frame is in progress");
+        while (frames[oldestPendingFrameIndex].readbackPending) {
+            auto& oldest = frames[oldestPendingFrameIndex];
+            lveDevice.waitForFrame(oldest.timelineFrame);
+            deliverReadback(oldest);
+        }
+    }
+
+    void LVEHeadlessRenderer::deliverReadback(Frame& frame) {
+        frame.readbackPending = false;
+        oldestPendingFrameIndex = (oldestPendingFrameIndex + 1) % static_cast<int>(frames.size());
+        if (readbackCallback) {
+            Readback readback{};
+            readback.frameNumber = frame.frameNumber;
+            readback.extent = extent;
+            readback.format = COLOR_FORMAT;
+            readback.rowPitch = extent.width * 4;
+            readback.pixels = static_cast<const uint8_t*>(frame.readbackBuffer->getMappedMemory());
+            readbackCallback(readback);
+        }
+    }
+}  // namespace lve
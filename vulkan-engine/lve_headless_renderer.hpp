@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "lve_buffer.hpp"
+#include "lve_device.hpp"
+#include "lve_pipeline.hpp"
+
+namespace lve {
+    /**
+     * @brief Renders into offscreen images instead of a swap chain, for a headless LVEDevice.
+     * Drives the same beginFrame / beginSwapChainRenderPass / endSwapChainRenderPass / endFrame
+     * sequence as LVERenderer, so render systems work with both.
+     *
+     * Every frame in flight has its own color and depth image and a host visible buffer the
+     * color image is copied into at the end of the frame. The readback is handed out once the
+     * frame is done on the device's frame timeline, without stalling the frames that are still in
+     * flight.
+     */
+    class LVEHeadlessRenderer {
+       public:
+        // Color format of the offscreen images. Four bytes per pixel, in RGBA order.
+        static constexpr VkFormat COLOR_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+        // A finished frame. pixels is only valid during the callback.
+        struct Readback {
+            uint64_t frameNumber;
+            VkExtent2D extent;
+            VkFormat format;
+            // Bytes between the starts of two rows.
+            uint32_t rowPitch;
+            const uint8_t *pixels;
+        };
+        using ReadbackCallback = std::function<void(const Readback &)>;
+
+        LVEHeadlessRenderer(LVEDevice &lveDevice, VkExtent2D extent, int framesInFlight = 2);
+        ~LVEHeadlessRenderer();
+
+        LVEHeadlessRenderer(const LVEHeadlessRenderer &) = delete;
+        LVEHeadlessRenderer &operator=(const LVEHeadlessRenderer &) = delete;
+
+        bool isFrameInProgress() const { return isFrameStarted; }
+        int getFrameIndex() const {
+            assert(isFrameStarted && "Cannot get frame index when frame not in progress");
+            return currentFrameIndex;
+        }
+        VkCommandBuffer getCurrentCommandBuffer() const {
+            assert(isFrameStarted && "Cannot get command buffer when frame not in progress");
+            return frames[currentFrameIndex].commandBuffer;
+        }
+        int getFramesInFlight() const { return static_cast<int>(frames.size()); }
+
+        PipelineRenderTarget getSwapChainRenderTarget() const { return {renderPass}; }
+        float getAspectRatio() const {
+            return static_cast<float>(extent.width) / static_cast<float>(extent.height);
+        }
+        VkExtent2D getSwapChainExtent() const { return extent; }
+        VkFormat getSwapChainDepthFormat() const { return depthFormat; }
+
+        // Called with every finished frame, in submission order.
+        void setReadbackCallback(ReadbackCallback callback) { readbackCallback = callback; }
+
+        // Waits for the frame that last used this frame index, hands out its readback and
+        // begins recording. Never returns nullptr, there is no swap chain to recreate.
+        VkCommandBuffer beginFrame();
+        // Copies the color image into the readback buffer and submits the frame.
+        void endFrame();
+        void beginSwapChainRenderPass(VkCommandBuffer commandBuffer,
+                                      VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+        void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
+
+        // Hands out the readbacks of all frames the GPU has finished, without waiting.
+        void pollReadbacks();
+        // Waits for all submitted frames and hands out their readbacks.
+        void flushReadbacks();
+
+       private:
+        struct Frame {
+            VkImage colorImage = VK_NULL_HANDLE;
+            VkDeviceMemory colorImageMemory = VK_NULL_HANDLE;
+            VkImageView colorImageView = VK_NULL_HANDLE;
+            VkImage depthImage = VK_NULL_HANDLE;
+            VkDeviceMemory depthImageMemory = VK_NULL_HANDLE;
+            VkImageView depthImageView = VK_NULL_HANDLE;
+            VkFramebuffer framebuffer = VK_NULL_HANDLE;
+            std::unique_ptr<LVEBuffer> readbackBuffer;
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            // Set from submission until the readback was handed out.
+            bool readbackPending = false;
+            // Counts the frames of this renderer, from 0.
+            uint64_t frameNumber = 0;
+            // The number the submission signals the device's frame timeline with.
+            uint64_t timelineFrame = 0;
+        };
+
+        void createRenderPass();
+        void createFrames();
+        void createImage(VkFormat format,
+                         VkImageUsageFlags usage,
+                         VkImageAspectFlags aspect,
+                         VkImage &image,
+                         VkDeviceMemory &memory,
+                         VkImageView &view);
+        void deliverReadback(Frame &frame);
+
+        LVEDevice &lveDevice;
+        VkExtent2D extent;
+        VkFormat depthFormat;
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        std::vector<Frame> frames;
+        ReadbackCallback readbackCallback;
+
+        int currentFrameIndex{0};
+        bool isFrameStarted{false};
+        uint64_t nextFrameNumber{0};
+        // The oldest frame whose readback has not been handed out yet, to keep them in order.
+        int oldestPendingFrameIndex{0};
+    };
+}  // namespace lve
@@ -0,0 +1,395 @@
+#include "lve_hiz_pyramid.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <stdexcept>
+
+#include "lve_swap_chain.hpp"
+#include "shaders/hiz_downsample.comp.spv.hpp"
+
+namespace lve {
+
+    namespace {
+        constexpr uint32_t WORKGROUP_SIZE = 8;
+        // Enough sets for a pyramid of a 2^32 x 2^32 depth buffer.
+        constexpr uint32_t MAX_LEVELS = 32;
+
+        struct DownsamplePushConstantData {
+            uint32_t sourceWidth;
+            uint32_t sourceHeight;
+            uint32_t destinationWidth;
+            uint32_t destinationHeight;
+        };
+
+        bool hasStencilComponent(VkFormat format) {
+            return format == VK_FORMAT_D32_SFLOAT_S8_UINT ||
+                   format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D16_UNORM_S8_UINT;
+        }
+    }  // namespace
+
+    LVEHiZPyramid::LVEHiZPyramid(LVEDevice &device) : lveDevice{device} {
+        createSampler();
+        createPipelineLayout();
+        createPipeline();
+    }
+
+    LVEHiZPyramid::~LVEHiZPyramid() {
+        destroyImage();
+        vkDestroyPipelineLayout(lveDevice.device(), pipelineLayout, nullptr);
+        vkDestroySampler(lveDevice.device(), sampler, nullptr);
+    }
+
+    void LVEHiZPyramid::createSampler() {
+        // The pyramid is only read with texelFetch, so filtering never happens. The sampler is
+        // still needed for the combined image sampler descriptors.
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.minLod = 0.f;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+        if (vkCreateSampler(lveDevice.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create depth pyramid sampler");
+        }
+    }
+
+    void LVEHiZPyramid::createPipelineLayout() {
+        setLayout =
+            LVEDescriptorSetLayout::Builder{lveDevice}
+                .addBinding(
+                    0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+                .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+                .build();
+
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(DownsamplePushConstantData);
+
+        VkDescriptorSetLayout descriptorSetLayout = setLayout->getDescriptorSetLayout();
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        if (vkCreatePipelineLayout(
+                lveDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create pipeline layout");
+        }
+    }
+
+    void LVEHiZPyramid::createPipeline() {
+        downsamplePipeline = std::make_unique<LVEComputePipeline>(
+            lveDevice, shaders::HIZ_DOWNSAMPLE_COMP, pipelineLayout);
+    }
+
+    bool LVEHiZPyramid::resize(VkExtent2D extent) {
+        if (image != VK_NULL_HANDLE && extent.width == depthExtent.width &&
+            extent.height == depthExtent.height) {
+            return false;
+        }
+        retireImage();
+        depthExtent = extent;
+        createImage();
+        return true;
+    }
+
+    void LVEHiZPyramid::recordInitialization(VkCommandBuffer commandBuffer) {
+        if (!needsInitialization) {
+            return;
+        }
+        // Descriptors referring to the pyramid are bound before the first build, so it has to be
+        // in the layout they expect right away.
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, getLevelCount(), 0, 1};
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0,
+                             0,
+                             nullptr,
+                             0,
+                             nullptr,
+                             1,
+                             &barrier);
+        needsInitialization = false;
+    }
+
+    void LVEHiZPyramid::createImage() {
+        levelExtents.clear();
+        VkExtent2D levelExtent = depthExtent;
+        do {
+            // Rounding up keeps every depth pixel inside the footprint of some texel.
+            levelExtent = {std::max(1u, (levelExtent.width + 1) / 2),
+                           std::max(1u, (levelExtent.height + 1) / 2)};
+            levelExtents.push_back(levelExtent);
+        } while (levelExtent.width > 1 || levelExtent.height > 1);
+        assert(levelExtents.size() <= MAX_LEVELS && "Depth pyramid has too many levels");
+        const uint32_t levelCount = static_cast<uint32_t>(levelExtents.size());
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = levelExtents[0].width;
+        imageInfo.extent.height = levelExtents[0].height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = levelCount;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = FORMAT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        // Written as a storage image by the downsampling, read as a sampled image by the culling.
+        imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        lveDevice.createImageWithInfo(
+            imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = FORMAT;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = levelCount;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+        if (vkCreateImageView(lveDevice.device(), &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create depth pyramid image view");
+        }
+
+        // Storage image views can only have a single level.
+        levelViews.resize(levelCount);
+        for (uint32_t level = 0; level < levelCount; level++) {
+            viewInfo.subresourceRange.baseMipLevel = level;
+            viewInfo.subresourceRange.levelCount = 1;
+            if (vkCreateImageView(lveDevice.device(), &viewInfo, nullptr, &levelViews[level]) !=
+                VK_SUCCESS) {
+                throw std::runtime_error("Failed to create depth pyramid image view");
+            }
+        }
+
+        // Transitioned in the command buffer of the frame that first uses it, instead of a
+        // submission of its own that would have to be waited for.
+        needsInitialization = true;
+
+        const uint32_t maxSets = MAX_LEVELS + LVESwapChain::MAX_FRAMES_IN_FLIGHT;
+        descriptorPool = LVEDescriptorPool::Builder{lveDevice}
+                             .setMaxSets(maxSets)
+                             .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxSets)
+                             .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, maxSets)
+                             .build();
+        levelSets.assign(levelCount, VK_NULL_HANDLE);
+        for (uint32_t level = 1; level < levelCount; level++) {
+            VkDescriptorImageInfo sourceInfo{
+                sampler, levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL};
+            VkDescriptorImageInfo destinationInfo{
+                VK_NULL_HANDLE, levelViews[level], VK_IMAGE_LAYOUT_GENERAL};
+            if (!LVEDescriptorWriter{*setLayout, *descriptorPool}
+                     .writeImage(0, &sourceInfo)
+                     .writeImage(1, &destinationInfo)
+                     .build(levelSets[level])) {
+                throw std::runtime_error("Failed to allocate depth pyramid descriptor set");
+            }
+        }
+        // The depth image is filled in by build.
+        depthSets.resize(LVESwapChain::MAX_FRAMES_IN_FLIGHT);
+        for (auto &set : depthSets) {
+            if (!descriptorPool->allocateDescriptor(setLayout->getDescriptorSetLayout(), set)) {
+                throw std::runtime_error("Failed to allocate depth pyramid descriptor set");
+            }
+        }
+    }
+
+    void LVEHiZPyramid::destroyImage() {
+        for (auto view : levelViews) {
+            vkDestroyImageView(lveDevice.device(), view, nullptr);
+        }
+        levelViews.clear();
+        if (image != VK_NULL_HANDLE) {
+            vkDestroyImageView(lveDevice.device(), imageView, nullptr);
+            vkDestroyImage(lveDevice.device(), image, nullptr);
+            vkFreeMemory(lveDevice.device(), imageMemory, nullptr);
+            image = VK_NULL_HANDLE;
+        }
+        descriptorPool.reset();
+    }
+
+    void LVEHiZPyramid::retireImage() {
+        if (image == VK_NULL_HANDLE) {
+            return;
+        }
+        // Frames in flight, including the one being recorded, may still sample the old pyramid
+        // or bind its sets. The sampler is shared with the new pyramid and stays.
+        std::shared_ptr<LVEDescriptorPool> oldPool = std::move(descriptorPool);
+        lveDevice.deferDestruction([device = lveDevice.device(),
+                                    oldImage = image,
+                                    oldMemory = imageMemory,
+                                    oldView = imageView,
+                                    oldLevelViews = levelViews,
+                                    oldPool]() mutable {
+            for (auto view : oldLevelViews) {
+                vkDestroyImageView(device, view, nullptr);
+            }
+            vkDestroyImageView(device, oldView, nullptr);
+            vkDestroyImage(device, oldImage, nullptr);
+            vkFreeMemory(device, oldMemory, nullptr);
+            oldPool.reset();
+        });
+        levelViews.clear();
+        image = VK_NULL_HANDLE;
+        imageMemory = VK_NULL_HANDLE;
+        imageView = VK_NULL_HANDLE;
+    }
+
+    void LVEHiZPyramid::build(VkCommandBuffer commandBuffer,
+                              int frameIndex,
+                              VkImage depthImage,
+                              VkImageView depthImageView,
+                              VkFormat depthFormat) {
+        assert(image != VK_NULL_HANDLE && "Cannot build depth pyramid before resize");
+
+        VkDescriptorImageInfo depthInfo{
+            sampler, depthImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        VkDescriptorImageInfo levelInfo{VK_NULL_HANDLE, levelViews[0], VK_IMAGE_LAYOUT_GENERAL};
+        LVEDescriptorWriter{*setLayout, *descriptorPool}
+            .writeImage(0, &depthInfo)
+            .writeImage(1, &levelInfo)
+            .overwrite(depthSets[frameIndex]);
+
+        VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+        if (hasStencilComponent(depthFormat)) {
+            // Layout transitions of combined depth stencil images have to include both aspects.
+            depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+        }
+
+        // The depth writes of the render pass have to finish before we sample the depth, and the
+        // previous frame's culling has to be done reading the pyramid before we overwrite it.
+        std::array<VkImageMemoryBarrier, 2> barriers{};
+        barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barriers[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].image = depthImage;
+        barriers[0].subresourceRange = {depthAspect, 0, 1, 0, 1};
+
+        // The old contents are never read, so the previous layout does not matter.
+        barriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barriers[1].srcAccessMask = 0;
+        barriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[1].image = image;
+        barriers[1].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, getLevelCount(), 0, 1};
+
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0,
+                             0,
+                             nullptr,
+                             0,
+                             nullptr,
+                             static_cast<uint32_t>(barriers.size()),
+                             barriers.data());
+
+        downsamplePipeline->bind(commandBuffer);
+        VkExtent2D sourceExtent = depthExtent;
+        for (uint32_t level = 0; level < getLevelCount(); level++) {
+            VkDescriptorSet set = level == 0 ? depthSets[frameIndex] : levelSets[level];
+            vkCmdBindDescriptorSets(commandBuffer,
+                                    VK_PIPELINE_BIND_POINT_COMPUTE,
+                                    pipelineLayout,
+                                    0,
+                                    1,
+                                    &set,
+                                    0,
+                                    nullptr);
+
+            const VkExtent2D destinationExtent = levelExtents[level];
+            DownsamplePushConstantData push{sourceExtent.width,
+                                            sourceExtent.height,
+                                            destinationExtent.width,
+                                            destinationExtent.height};
+            vkCmdPushConstants(commandBuffer,
+                               pipelineLayout,
+                               VK_SHADER_STAGE_COMPUTE_BIT,
+                               0,
+                               sizeof(DownsamplePushConstantData),
+                               &push);
+            vkCmdDispatch(commandBuffer,
+                          (destinationExtent.width + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE,
+                          (destinationExtent.height + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE,
+                          1);
+
+            // The next level reads what this one wrote. After the last level, this makes the
+            // whole pyramid visible to the culling.
+            VkImageMemoryBarrier levelBarrier{};
+            levelBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            levelBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+            levelBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            levelBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            levelBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            levelBarrier.image = image;
+            levelBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+            vkCmdPipelineBarrier(commandBuffer,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 0,
+                                 0,
+                                 nullptr,
+                                 0,
+                                 nullptr,
+                                 1,
+                                 &levelBarrier);
+            sourceExtent = destinationExtent;
+        }
+
+        // Hand the depth image back to the render pass that continues drawing into it.
+        VkImageMemoryBarrier depthBarrier = barriers[0];
+        depthBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        depthBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                     VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        depthBarrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                 VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                             0,
+                             0,
+                             nullptr,
+                             0,
+                             nullptr,
+                             1,
+                             &depthBarrier);
+    }
+
+    VkDescriptorImageInfo LVEHiZPyramid::descriptorInfo() const {
+        return VkDescriptorImageInfo{sampler, imageView, VK_IMAGE_LAYOUT_GENERAL};
+    }
+}  // namespace lve
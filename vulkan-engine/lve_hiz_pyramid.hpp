@@ -0,0 +1,82 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "lve_compute_pipeline.hpp"
+#include "lve_descriptors.hpp"
+#include "lve_device.hpp"
+
+namespace lve {
+    /**
+     * @brief A hierarchical depth (Hi-Z) pyramid built from a depth attachment by a compute
+     * shader.
+     * Level 0 has half the resolution of the depth buffer and each further level halves it again,
+     * down to 1x1. Every texel holds the farthest depth of the 2x2 texels below it, so a single
+     * fetch tells how far away the nearest possible occluder in its footprint is.
+     * Texel t of level k covers the depth pixels [t * 2^(k+1), (t + 1) * 2^(k+1)).
+     */
+    class LVEHiZPyramid {
+       public:
+        static constexpr VkFormat FORMAT = VK_FORMAT_R32_SFLOAT;
+
+        explicit LVEHiZPyramid(LVEDevice &device);
+        ~LVEHiZPyramid();
+
+        LVEHiZPyramid(const LVEHiZPyramid &) = delete;
+        LVEHiZPyramid &operator=(const LVEHiZPyramid &) = delete;
+
+        // Recreates the pyramid for a depth buffer of the given size, if it has changed. The old
+        // pyramid is destroyed once the frames in flight that may still use it are done, so this
+        // never waits. Returns true if the pyramid was recreated.
+        bool resize(VkExtent2D depthExtent);
+        // Records the transition of a new pyramid into the layout its descriptors expect. Does
+        // nothing if there was no resize since the last call. Call it in every frame before the
+        // first command that may access the pyramid.
+        void recordInitialization(VkCommandBuffer commandBuffer);
+
+        // Records the downsampling of the depth image into the pyramid. The depth image must be in
+        // DEPTH_STENCIL_ATTACHMENT_OPTIMAL layout and is returned to it. Afterwards the pyramid is
+        // ready to be sampled by compute shaders.
+        void build(VkCommandBuffer commandBuffer,
+                   int frameIndex,
+                   VkImage depthImage,
+                   VkImageView depthImageView,
+                   VkFormat depthFormat);
+
+        // All levels, in VK_IMAGE_LAYOUT_GENERAL. Meant for texelFetch.
+        VkDescriptorImageInfo descriptorInfo() const;
+        uint32_t getLevelCount() const { return static_cast<uint32_t>(levelViews.size()); }
+        VkExtent2D getDepthExtent() const { return depthExtent; }
+
+       private:
+        void createSampler();
+        void createPipelineLayout();
+        void createPipeline();
+        void createImage();
+        void destroyImage();
+        void retireImage();
+
+        LVEDevice &lveDevice;
+
+        VkSampler sampler;
+        std::unique_ptr<LVEDescriptorSetLayout> setLayout;
+        // Recreated with the image, since frames in flight may still use the sets of the old one.
+        std::unique_ptr<LVEDescriptorPool> descriptorPool;
+        VkPipelineLayout pipelineLayout;
+        std::unique_ptr<LVEComputePipeline> downsamplePipeline;
+
+        VkExtent2D depthExtent{0, 0};
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+        VkImageView imageView = VK_NULL_HANDLE;
+        std::vector<VkImageView> levelViews;
+        std::vector<VkExtent2D> levelExtents;
+        bool needsInitialization = false;
+        // levelSets[k] reads level k - 1 and writes level k. Entry 0 is unused.
+        std::vector<VkDescriptorSet> levelSets;
+        // Read the depth image and write level 0. One per frame in flight, because the depth image
+        // changes with the swap chain image and sets cannot be updated while a frame uses them.
+        std::vector<VkDescriptorSet> depthSets;
+    };
+}  // namespace lve
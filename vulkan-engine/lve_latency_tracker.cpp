@@ -0,0 +1,131 @@
+#include "lve_latency_tracker.hpp"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace lve {
+
+    LVELatencyTracker::LVELatencyTracker(LVEDevice &device, int framesInFlight)
+        : lveDevice{device},
+          timestampPeriod{static_cast<double>(device.properties.limits.timestampPeriod)},
+          frames(framesInFlight) {
+        // Guarantees timestamps on every graphics and compute queue.
+        if (!device.properties.limits.timestampComputeAndGraphics) {
+            return;
+        }
+
+        // A start and an end timestamp per frame in flight.
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = 2 * static_cast<uint32_t>(framesInFlight);
+        if (vkCreateQueryPool(lveDevice.device(), &queryPoolInfo, nullptr, &queryPool) !=
+            VK_SUCCESS) {
+            throw std::runtime_error("Failed to create timestamp query pool");
+        }
+    }
+
+    LVELatencyTracker::~LVELatencyTracker() {
+        if (queryPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(lveDevice.device(), queryPool, nullptr);
+        }
+    }
+
+    void LVELatencyTracker::markInputSampled() {
+        hasPendingInput = true;
+        pendingInputTime = Clock::now();
+    }
+
+    void LVELatencyTracker::beginFrame(VkCommandBuffer commandBuffer, int frameIndex) {
+        if (!isSupported()) {
+            return;
+        }
+        if (frames[frameIndex].pending) {
+            readResults(frameIndex);
+        }
+        const uint32_t firstQuery = 2 * static_cast<uint32_t>(frameIndex);
+        vkCmdResetQueryPool(commandBuffer, queryPool, firstQuery, 2);
+        vkCmdWriteTimestamp(
+            commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, firstQuery);
+    }
+
+    void LVELatencyTracker::endFrame(VkCommandBuffer commandBuffer, int frameIndex) {
+        if (!isSupported()) {
+            return;
+        }
+        const uint32_t firstQuery = 2 * static_cast<uint32_t>(frameIndex);
+        vkCmdWriteTimestamp(
+            commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, firstQuery + 1);
+
+        auto &frame = frames[frameIndex];
+        frame.submitTime = Clock::now();
+        // Without a mark, the input is as old as the frame.
+        frame.inputTime = hasPendingInput ? pendingInputTime : frame.submitTime;
+        frame.pending = true;
+        hasPendingInput = false;
+    }
+
+    void LVELatencyTracker::readResults(int frameIndex) {
+        auto &frame = frames[frameIndex];
+        frame.pending = false;
+
+        // The frame has finished, so this does not wait.
+        std::array<uint64_t, 2> timestamps{};
+        if (vkGetQueryPoolResults(lveDevice.device(),
+                                  queryPool,
+                                  2 * static_cast<uint32_t>(frameIndex),
+                                  2,
+                                  sizeof(timestamps),
+                                  timestamps.data(),
+                                  sizeof(uint64_t),
+                                  VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+            return;
+        }
+        const double gpuTimeNs = static_cast<double>(timestamps[1] - timestamps[0]) *
+                                 timestampPeriod;
+
+        Clock::duration latency;
+        if (lveDevice.supportsCalibratedTimestamps()) {
+            // Walk back from a GPU timestamp with a known CPU time to the end of the frame.
+            uint64_t nowTimestamp;
+            Clock::time_point nowTime;
+            lveDevice.getCalibratedTimestamp(nowTimestamp, nowTime);
+            const auto sinceEnd = std::chrono::duration<double, std::nano>(
+                static_cast<double>(nowTimestamp - timestamps[1]) * timestampPeriod);
+            const auto endTime = nowTime - std::chrono::duration_cast<Clock::duration>(sinceEnd);
+            latency = endTime - frame.inputTime;
+        } else {
+            latency = (frame.submitTime - frame.inputTime) +
+                      std::chrono::duration_cast<Clock::duration>(
+                          std::chrono::duration<double, std::nano>(gpuTimeNs));
+        }
+
+        const double latencyMs =
+            std::chrono::duration<double, std::milli>(latency).count();
+        frameCount++;
+        latencySumMs += latencyMs;
+        maxLatencyMs = std::max(maxLatencyMs, latencyMs);
+        lastGpuTimeMs = gpuTimeNs / 1e6;
+        gpuTimeSumMs += lastGpuTimeMs;
+    }
+
+    LVELatencyTracker::Stats LVELatencyTracker::getStats() const {
+        Stats stats{};
+        stats.frameCount = frameCount;
+        stats.calibrated = lveDevice.supportsCalibratedTimestamps();
+        if (frameCount > 0) {
+            stats.averageLatencyMs = latencySumMs / frameCount;
+            stats.maxLatencyMs = maxLatencyMs;
+            stats.averageGpuTimeMs = gpuTimeSumMs / frameCount;
+        }
+        return stats;
+    }
+
+    void LVELatencyTracker::resetStats() {
+        frameCount = 0;
+        latencySumMs = 0.0;
+        maxLatencyMs = 0.0;
+        gpuTimeSumMs = 0.0;
+    }
+}  // namespace lve
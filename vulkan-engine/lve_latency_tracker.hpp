@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+#include "lve_device.hpp"
+
+namespace lve {
+    /**
+     * @brief Measures the time from sampling input to the end of the frame's GPU work, when the
+     * image is handed to presentation. Time spent in the presentation engine and the display
+     * itself is not included.
+     *
+     * Every frame in flight writes a timestamp at the start and end of its command buffer. The
+     * results are read when the frame index is used again, once its previous frame is done. With
+     * VK_EXT_calibrated_timestamps the end timestamp is put on the CPU timeline, otherwise the
+     * latency is estimated as input to submission plus the GPU time of the frame.
+     */
+    class LVELatencyTracker {
+       public:
+        using Clock = std::chrono::steady_clock;
+
+        struct Stats {
+            uint32_t frameCount = 0;
+            double averageLatencyMs = 0.0;
+            double maxLatencyMs = 0.0;
+            double averageGpuTimeMs = 0.0;
+            // Whether the latencies were measured or estimated, see above.
+            bool calibrated = false;
+        };
+
+        LVELatencyTracker(LVEDevice &device, int framesInFlight);
+        ~LVELatencyTracker();
+
+        LVELatencyTracker(const LVELatencyTracker &) = delete;
+        LVELatencyTracker &operator=(const LVELatencyTracker &) = delete;
+
+        // False if the graphics queue has no timestamps. All other calls do nothing then.
+        bool isSupported() const { return queryPool != VK_NULL_HANDLE; }
+
+        // The input of the next submitted frame was sampled now.
+        void markInputSampled();
+        // Must be called at the start of the frame's command buffer, outside of a render pass,
+        // once the previous submission of the frame index has finished.
+        void beginFrame(VkCommandBuffer commandBuffer, int frameIndex);
+        // Must be called at the end of the frame's command buffer, right before submission.
+        void endFrame(VkCommandBuffer commandBuffer, int frameIndex);
+
+        // Over all frames read back since the last reset.
+        Stats getStats() const;
+        void resetStats();
+        // Of the frame read back last, 0 before the first one.
+        double getLastGpuTimeMs() const { return lastGpuTimeMs; }
+
+       private:
+        struct Frame {
+            bool pending = false;
+            Clock::time_point inputTime{};
+            Clock::time_point submitTime{};
+        };
+
+        void readResults(int frameIndex);
+
+        LVEDevice &lveDevice;
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        // Nanoseconds per timestamp tick.
+        double timestampPeriod;
+        std::vector<Frame> frames;
+
+        bool hasPendingInput = false;
+        Clock::time_point pendingInputTime{};
+
+        uint32_t frameCount = 0;
+        double latencySumMs = 0.0;
+        double maxLatencyMs = 0.0;
+        double gpuTimeSumMs = 0.0;
+        double lastGpuTimeMs = 0.0;
+    };
+}  // namespace lve
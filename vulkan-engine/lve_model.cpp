@@ -4,6 +4,7 @@
 
 #include <tiny_obj_loader.h>
 
+#include <atomic>
 #include <cassert>
 #include <cstring>
 #include <glm/gtx/hash.hpp>
@@ -26,22 +27,46 @@ namespace lve {
 
     LVEModel::LVEModel(LVEDevice &lveDevice, const LVEModel::Builder &builder)
         : lveDevice(lveDevice) {
+        static std::atomic<uint32_t> nextId{0};
+        id = nextId++;
         createVertexBuffers(builder.vertices);
         createIndexBuffers(builder.indices);
+
+        boundingBox.min = builder.vertices[0].position;
+        boundingBox.max = builder.vertices[0].position;
+        for (const auto &vertex : builder.vertices) {
+            boundingBox.min = glm::min(boundingBox.min, vertex.position);
+            boundingBox.max = glm::max(boundingBox.max, vertex.position);
+        }
+
+        if (builder.keepCpuGeometry) {
+            cpuPositions.reserve(builder.vertices.size());
+            for (const auto &vertex : builder.vertices) {
+                cpuPositions.push_back(vertex.position);
+            }
+            cpuIndices = builder.indices;
+            if (cpuIndices.empty()) {
+                for (uint32_t i = 0; i < vertexCount; i++) {
+                    cpuIndices.push_back(i);
+                }
+            }
+        }
     }
 
     LVEModel::~LVEModel() {
-        vkDestroyBuffer(lveDevice.device(), vertexBuffer, nullptr);
-        vkFreeMemory(lveDevice.device(), vertexBufferMemory, nullptr);
+        // Frames in flight may still draw the model, so the buffers outlive it until they are
+        // done. This lets models be unloaded at any time without waiting for the GPU.
+        lveDevice.destroyBufferDeferred(vertexBuffer, vertexBufferMemory);
         if (hasIndexBuffer) {
-            vkDestroyBuffer(lveDevice.device(), indexBuffer, nullptr);
-            vkFreeMemory(lveDevice.device(), indexBufferMemory, nullptr);
+            lveDevice.destroyBufferDeferred(indexBuffer, indexBufferMemory);
         }
     }
 
     std::unique_ptr<LVEModel> LVEModel::createModelFromFile(LVEDevice &device,
-                                                            const std::string &filepath) {
+                                                            const std::string &filepath,
+                                                            bool keepCpuGeometry) {
         Builder builder{};
+        builder.keepCpuGeometry = keepCpuGeometry;
         builder.loadModel(filepath);
         return std::make_unique<LVEModel>(device, builder);
     }
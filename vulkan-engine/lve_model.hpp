@@ -32,6 +32,12 @@ namespace lve {
             }
         };
 
+        // Axis aligned, in model space.
+        struct BoundingBox {
+            glm::vec3 min{0.f};
+            glm::vec3 max{0.f};
+        };
+
         struct Builder {
             /**
              * @brief Temporary helper object storing vertex and index information until they can be
@@ -39,6 +45,9 @@ namespace lve {
              */
             std::vector<Vertex> vertices{};
             std::vector<uint32_t> indices{};
+            // Keep a copy of the positions and indices in host memory after the upload, e.g. for
+            // models that are rasterized by the CPU occlusion culler.
+            bool keepCpuGeometry = false;
 
             void loadModel(const std::string &filepath);
         };
@@ -52,16 +61,32 @@ namespace lve {
         LVEModel &operator=(const LVEModel &) = delete;
 
         static std::unique_ptr<LVEModel> createModelFromFile(LVEDevice &device,
-                                                             const std::string &filepath);
+                                                             const std::string &filepath,
+                                                             bool keepCpuGeometry = false);
 
         void bind(VkCommandBuffer commandBuffer);
         void draw(VkCommandBuffer commandBuffer);
 
+        // Unique per model. Used to group draws of the same model together.
+        uint32_t getId() const { return id; }
+
+        // What draw needs, for recording the same draw indirectly.
+        bool hasIndices() const { return hasIndexBuffer; }
+        uint32_t getVertexCount() const { return vertexCount; }
+        uint32_t getIndexCount() const { return indexCount; }
+
+        const BoundingBox &getBoundingBox() const { return boundingBox; }
+        // Empty unless the model was built with keepCpuGeometry. The indices always describe a
+        // triangle list, even for models without an index buffer.
+        const std::vector<glm::vec3> &getCpuPositions() const { return cpuPositions; }
+        const std::vector<uint32_t> &getCpuIndices() const { return cpuIndices; }
+
        private:
         void createVertexBuffers(const std::vector<Vertex> &vertices);
         void createIndexBuffers(const std::vector<uint32_t> &indices);
 
         LVEDevice &lveDevice;
+        uint32_t id;
         VkBuffer vertexBuffer;
         VkDeviceMemory vertexBufferMemory;
         uint32_t vertexCount;
@@ -71,5 +96,9 @@ namespace lve {
         VkBuffer indexBuffer;
         VkDeviceMemory indexBufferMemory;
         uint32_t indexCount;
+
+        BoundingBox boundingBox{};
+        std::vector<glm::vec3> cpuPositions{};
+        std::vector<uint32_t> cpuIndices{};
     };
 }  // namespace lve
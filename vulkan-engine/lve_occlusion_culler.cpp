@@ -0,0 +1,395 @@
+#include "lve_occlusion_culler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+// SSE2 is part of every x86-64 CPU. Other targets use the scalar loop.
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define LVE_OCCLUSION_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace lve {
+
+    namespace {
+        constexpr uint32_t WIDTH = LVEOcclusionCuller::DEPTH_BUFFER_WIDTH;
+        constexpr uint32_t HEIGHT = LVEOcclusionCuller::DEPTH_BUFFER_HEIGHT;
+        static_assert(WIDTH % 4 == 0, "Depth buffer rows must be a multiple of the SIMD width");
+
+        // Clips a clip-space triangle against the near plane (z >= 0 with a [0, 1] depth range).
+        // Returns the number of vertices of the resulting convex polygon: 0, 3 or 4.
+        int clipAgainstNearPlane(const std::array<glm::vec4, 3> &in,
+                                 std::array<glm::vec4, 4> &out) {
+            int count = 0;
+            for (int i = 0; i < 3; i++) {
+                const glm::vec4 &a = in[i];
+                const glm::vec4 &b = in[(i + 1) % 3];
+                const bool aInside = a.z >= 0.f;
+                const bool bInside = b.z >= 0.f;
+                if (aInside) {
+                    out[count++] = a;
+                }
+                if (aInside != bInside) {
+                    const float t = a.z / (a.z - b.z);
+                    out[count++] = a + t * (b - a);
+                }
+            }
+            return count;
+        }
+
+        glm::vec3 toScreen(const glm::vec4 &clipPosition) {
+            const glm::vec3 ndc = glm::vec3{clipPosition} / clipPosition.w;
+            // Vulkan's NDC has y pointing down, just like the depth buffer rows.
+            return {(ndc.x * .5f + .5f) * static_cast<float>(WIDTH),
+                    (ndc.y * .5f + .5f) * static_cast<float>(HEIGHT),
+                    ndc.z};
+        }
+    }  // namespace
+
+    LVEOcclusionCuller::LVEOcclusionCuller(LVEThreadPool &threadPool) : threadPool{threadPool} {
+        uint32_t width = WIDTH;
+        uint32_t height = HEIGHT;
+        while (true) {
+            depthPyramid.emplace_back(width * height, 1.f);
+            if (width == 1 && height == 1) {
+                break;
+            }
+            width = std::max(1u, width / 2);
+            height = std::max(1u, height / 2);
+        }
+        occluderTriangles.resize(threadPool.threadCount() + 1);
+    }
+
+    LVEOcclusionCuller::~LVEOcclusionCuller() {
+        // The task references this object, so it has to finish before we go away.
+        if (pendingCulling.valid()) {
+            pendingCulling.wait();
+        }
+    }
+
+    void LVEOcclusionCuller::beginCulling(LVEScene &scene, const LVECamera &camera) {
+        // Results that were never picked up, e.g. because beginFrame failed, are dropped.
+        if (pendingCulling.valid()) {
+            pendingCulling.get();
+        }
+        const glm::mat4 projectionView = camera.getProjection() * camera.getView();
+        // Looking the pools up may create them, which only the main thread may do.
+        auto &renderables = scene.pool<RenderComponent>();
+        auto &transforms = scene.pool<TransformComponent>();
+        pendingCulling = threadPool.submit([this, &renderables, &transforms, projectionView]() {
+            cull(renderables, transforms, projectionView);
+        });
+    }
+
+    const std::vector<uint8_t> &LVEOcclusionCuller::waitForResults() {
+        if (pendingCulling.valid()) {
+            // Rethrows anything that went wrong on the worker.
+            pendingCulling.get();
+        }
+        return visibility;
+    }
+
+    void LVEOcclusionCuller::cull(LVEComponentPool<RenderComponent> &renderables,
+                                  LVEComponentPool<TransformComponent> &transforms,
+                                  const glm::mat4 &projectionView) {
+        const uint32_t maxChunks = threadPool.threadCount() + 1;
+        stats = {};
+
+        // 1. Transform the occluders into screen space triangles, clipped at the near plane.
+        std::vector<std::pair<const RenderComponent *, const TransformComponent *>> occluders;
+        for (size_t i = 0; i < renderables.size(); i++) {
+            const auto &renderable = renderables.at(i);
+            if (!renderable.isOccluder || renderable.model == nullptr ||
+                renderable.model->getCpuIndices().empty()) {
+                continue;
+            }
+            // The hint hits if the transform pool is sorted like the render pool.
+            if (const auto *transform = transforms.tryGet(renderables.entityAt(i), i)) {
+                occluders.emplace_back(&renderable, transform);
+            }
+        }
+        for (auto &triangles : occluderTriangles) {
+            triangles.clear();
+        }
+        threadPool.parallelFor(
+            occluders.size(), maxChunks, [&](uint32_t chunk, size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    transformOccluder(*occluders[i].first,
+                                      *occluders[i].second,
+                                      projectionView,
+                                      occluderTriangles[chunk]);
+                }
+            });
+        for (const auto &triangles : occluderTriangles) {
+            stats.occluderTriangles += static_cast<uint32_t>(triangles.size());
+        }
+
+        // 2. Rasterize. Every chunk owns a band of rows and walks all triangles, so no two
+        // threads ever write the same pixel.
+        threadPool.parallelFor(HEIGHT, maxChunks, [&](uint32_t, size_t firstRow, size_t endRow) {
+            std::fill(depthPyramid[0].begin() + firstRow * WIDTH,
+                      depthPyramid[0].begin() + endRow * WIDTH,
+                      1.f);
+            for (const auto &triangles : occluderTriangles) {
+                for (const auto &triangle : triangles) {
+                    rasterizeTriangle(triangle,
+                                      static_cast<uint32_t>(firstRow),
+                                      static_cast<uint32_t>(endRow));
+                }
+            }
+        });
+
+        // 3. The pyramid is small enough that building it in parallel does not pay off.
+        buildDepthPyramid();
+
+        // 4. Test every object against the pyramid.
+        visibility.assign(renderables.size(), 1);
+        std::atomic<uint32_t> frustumCulled{0};
+        std::atomic<uint32_t> occluded{0};
+        threadPool.parallelFor(
+            renderables.size(), maxChunks, [&](uint32_t, size_t begin, size_t end) {
+                uint32_t chunkFrustumCulled = 0;
+                uint32_t chunkOccluded = 0;
+                for (size_t i = begin; i < end; i++) {
+                    const auto &renderable = renderables.at(i);
+                    const auto *transform = transforms.tryGet(renderables.entityAt(i), i);
+                    if (renderable.model == nullptr || transform == nullptr) {
+                        continue;
+                    }
+                    const int result = testObject(renderable, *transform, projectionView);
+                    chunkFrustumCulled += result == 0 ? 1 : 0;
+                    chunkOccluded += result == 1 ? 1 : 0;
+                    visibility[i] = result == 2 ? 1 : 0;
+                }
+                frustumCulled += chunkFrustumCulled;
+                occluded += chunkOccluded;
+            });
+        stats.testedObjects = static_cast<uint32_t>(renderables.size());
+        stats.frustumCulledObjects = frustumCulled;
+        stats.occludedObjects = occluded;
+    }
+
+    void LVEOcclusionCuller::transformOccluder(const RenderComponent &occluder,
+                                               const TransformComponent &occluderTransform,
+                                               const glm::mat4 &projectionView,
+                                               std::vector<ScreenTriangle> &triangles) {
+        const glm::mat4 transform = projectionView * occluderTransform.modelToWorldMatrix();
+        const auto &positions = occluder.model->getCpuPositions();
+        const auto &indices = occluder.model->getCpuIndices();
+
+        std::vector<glm::vec4> clipPositions;
+        clipPositions.reserve(positions.size());
+        for (const auto &position : positions) {
+            clipPositions.push_back(transform * glm::vec4{position, 1.f});
+        }
+
+        std::array<glm::vec4, 3> triangle;
+        std::array<glm::vec4, 4> polygon;
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            triangle = {clipPositions[indices[i]],
+                        clipPositions[indices[i + 1]],
+                        clipPositions[indices[i + 2]]};
+            const int vertexCount = clipAgainstNearPlane(triangle, polygon);
+            // The clipped polygon is convex, so it can be split into a fan.
+            for (int v = 1; v + 1 < vertexCount; v++) {
+                triangles.push_back(
+                    {toScreen(polygon[0]), toScreen(polygon[v]), toScreen(polygon[v + 1])});
+            }
+        }
+    }
+
+    void LVEOcclusionCuller::rasterizeTriangle(const ScreenTriangle &triangle,
+                                               uint32_t firstRow,
+                                               uint32_t endRow) {
+        glm::vec3 v0 = triangle.v0;
+        glm::vec3 v1 = triangle.v1;
+        glm::vec3 v2 = triangle.v2;
+
+        // Twice the signed area. Occluders are rasterized regardless of their winding, so flip
+        // clockwise triangles around.
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+        if (std::abs(area) < std::numeric_limits<float>::epsilon()) {
+            return;
+        }
+        if (area < 0.f) {
+            std::swap(v1, v2);
+            area = -area;
+        }
+
+        const float minY = std::min({v0.y, v1.y, v2.y});
+        const float maxY = std::max({v0.y, v1.y, v2.y});
+        const float minX = std::min({v0.x, v1.x, v2.x});
+        const float maxX = std::max({v0.x, v1.x, v2.x});
+        if (maxY < static_cast<float>(firstRow) || minY >= static_cast<float>(endRow) ||
+            maxX < 0.f || minX >= static_cast<float>(WIDTH)) {
+            return;
+        }
+        const uint32_t rowBegin =
+            std::max(firstRow, static_cast<uint32_t>(std::max(0.f, std::floor(minY))));
+        const uint32_t rowEnd =
+            std::min(endRow, static_cast<uint32_t>(std::ceil(std::min(maxY, float(HEIGHT)))));
+        // Align the first column down to the SIMD width. The edge tests take care of the extra
+        // pixels on the left.
+        const uint32_t columnBegin = static_cast<uint32_t>(std::max(0.f, std::floor(minX))) & ~3u;
+        const uint32_t columnEnd =
+            static_cast<uint32_t>(std::ceil(std::min(maxX, static_cast<float>(WIDTH))));
+
+        // Edge functions E(x, y) = a * x + b * y + c, positive on the inner side of each edge.
+        // The edge opposite of a vertex is zero at that edge and equals area at the vertex.
+        const glm::vec3 a{v1.y - v2.y, v2.y - v0.y, v0.y - v1.y};
+        const glm::vec3 b{v2.x - v1.x, v0.x - v2.x, v1.x - v0.x};
+        const glm::vec3 c{-(a.x * v1.x + b.x * v1.y),
+                          -(a.y * v2.x + b.y * v2.y),
+                          -(a.z * v0.x + b.z * v0.y)};
+        // Depth is affine in screen space, so it is a plane as well.
+        const glm::vec3 depths{v0.z, v1.z, v2.z};
+        const float depthA = glm::dot(a, depths) / area;
+        const float depthB = glm::dot(b, depths) / area;
+        const float depthC = glm::dot(c, depths) / area;
+
+        for (uint32_t y = rowBegin; y < rowEnd; y++) {
+            float *row = depthPyramid[0].data() + y * WIDTH;
+            // Sample at pixel centers.
+            const float py = static_cast<float>(y) + .5f;
+            const glm::vec3 rowEdges = b * py + c;
+            const float rowDepth = depthB * py + depthC;
+
+#ifdef LVE_OCCLUSION_SSE2
+            const __m128 laneOffsets = _mm_setr_ps(.5f, 1.5f, 2.5f, 3.5f);
+            const __m128 zero = _mm_setzero_ps();
+            for (uint32_t x = columnBegin; x < columnEnd; x += 4) {
+                const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+                const __m128 e0 =
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a.x), px), _mm_set1_ps(rowEdges.x));
+                const __m128 e1 =
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a.y), px), _mm_set1_ps(rowEdges.y));
+                const __m128 e2 =
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a.z), px), _mm_set1_ps(rowEdges.z));
+                // Lanes inside all three edges are covered.
+                const __m128 coverage = _mm_and_ps(
+                    _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)),
+                    _mm_cmpge_ps(e2, zero));
+                if (_mm_movemask_ps(coverage) == 0) {
+                    continue;
+                }
+                const __m128 depth =
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(depthA), px), _mm_set1_ps(rowDepth));
+                const __m128 current = _mm_loadu_ps(row + x);
+                const __m128 nearest = _mm_min_ps(current, depth);
+                // Only covered lanes take the new depth.
+                _mm_storeu_ps(row + x,
+                              _mm_or_ps(_mm_and_ps(coverage, nearest),
+                                        _mm_andnot_ps(coverage, current)));
+            }
+#else
+            for (uint32_t x = columnBegin; x < columnEnd; x++) {
+                const float px = static_cast<float>(x) + .5f;
+                const glm::vec3 edges = a * px + rowEdges;
+                if (edges.x >= 0.f && edges.y >= 0.f && edges.z >= 0.f) {
+                    row[x] = std::min(row[x], depthA * px + rowDepth);
+                }
+            }
+#endif
+        }
+    }
+
+    void LVEOcclusionCuller::buildDepthPyramid() {
+        uint32_t sourceWidth = WIDTH;
+        uint32_t sourceHeight = HEIGHT;
+        for (size_t level = 1; level < depthPyramid.size(); level++) {
+            const auto &source = depthPyramid[level - 1];
+            auto &destination = depthPyramid[level];
+            const uint32_t width = std::max(1u, sourceWidth / 2);
+            const uint32_t height = std::max(1u, sourceHeight / 2);
+            for (uint32_t y = 0; y < height; y++) {
+                const uint32_t y0 = 2 * y;
+                const uint32_t y1 = std::min(2 * y + 1, sourceHeight - 1);
+                for (uint32_t x = 0; x < width; x++) {
+                    const uint32_t x0 = 2 * x;
+                    const uint32_t x1 = std::min(2 * x + 1, sourceWidth - 1);
+                    // The farthest depth keeps the test conservative.
+                    destination[y * width + x] = std::max({source[y0 * sourceWidth + x0],
+                                                           source[y0 * sourceWidth + x1],
+                                                           source[y1 * sourceWidth + x0],
+                                                           source[y1 * sourceWidth + x1]});
+                }
+            }
+            sourceWidth = width;
+            sourceHeight = height;
+        }
+    }
+
+    int LVEOcclusionCuller::testObject(const RenderComponent &renderable,
+                                       const TransformComponent &objectTransform,
+                                       const glm::mat4 &projectionView) const {
+        const glm::mat4 transform = projectionView * objectTransform.modelToWorldMatrix();
+        const auto &bounds = renderable.model->getBoundingBox();
+
+        glm::vec3 screenMin{std::numeric_limits<float>::max()};
+        glm::vec3 screenMax{std::numeric_limits<float>::lowest()};
+        uint32_t cornersBehindNearPlane = 0;
+        for (uint32_t corner = 0; corner < 8; corner++) {
+            const glm::vec3 position{(corner & 1) ? bounds.max.x : bounds.min.x,
+                                     (corner & 2) ? bounds.max.y : bounds.min.y,
+                                     (corner & 4) ? bounds.max.z : bounds.min.z};
+            const glm::vec4 clipPosition = transform * glm::vec4{position, 1.f};
+            if (clipPosition.z < 0.f) {
+                cornersBehindNearPlane++;
+                continue;
+            }
+            const glm::vec3 screenPosition = toScreen(clipPosition);
+            screenMin = glm::min(screenMin, screenPosition);
+            screenMax = glm::max(screenMax, screenPosition);
+        }
+        if (cornersBehindNearPlane == 8) {
+            return 0;
+        }
+        // The box crosses the near plane, so its projection is unbounded.
+        if (cornersBehindNearPlane > 0) {
+            return 2;
+        }
+        if (screenMax.x < 0.f || screenMin.x > static_cast<float>(WIDTH) || screenMax.y < 0.f ||
+            screenMin.y > static_cast<float>(HEIGHT) || screenMin.z > 1.f) {
+            return 0;
+        }
+
+        const auto toPixel = [](float value, uint32_t size) {
+            return static_cast<uint32_t>(std::clamp(value, 0.f, static_cast<float>(size - 1)));
+        };
+        uint32_t x0 = toPixel(std::floor(screenMin.x), WIDTH);
+        uint32_t x1 = toPixel(std::ceil(screenMax.x), WIDTH);
+        uint32_t y0 = toPixel(std::floor(screenMin.y), HEIGHT);
+        uint32_t y1 = toPixel(std::ceil(screenMax.y), HEIGHT);
+
+        // Pick the level at which the rectangle covers at most 2x2 texels (3x3 when it straddles
+        // texel borders), so the test stays cheap for large objects.
+        uint32_t level = 0;
+        uint32_t width = WIDTH;
+        uint32_t height = HEIGHT;
+        while (level + 1 < depthPyramid.size() && ((x1 - x0) > 1 || (y1 - y0) > 1)) {
+            level++;
+            x0 /= 2;
+            x1 /= 2;
+            y0 /= 2;
+            y1 /= 2;
+            width = std::max(1u, width / 2);
+            height = std::max(1u, height / 2);
+            x1 = std::min(x1, width - 1);
+            y1 = std::min(y1, height - 1);
+            x0 = std::min(x0, x1);
+            y0 = std::min(y0, y1);
+        }
+
+        const auto &levelDepths = depthPyramid[level];
+        float farthestOccluderDepth = 0.f;
+        for (uint32_t y = y0; y <= y1; y++) {
+            for (uint32_t x = x0; x <= x1; x++) {
+                farthestOccluderDepth = std::max(farthestOccluderDepth, levelDepths[y * width + x]);
+            }
+        }
+        return screenMin.z > farthestOccluderDepth ? 1 : 2;
+    }
+}  // namespace lve
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <vector>
+
+#include "lve_camera.hpp"
+#include "lve_components.hpp"
+#include "lve_scene.hpp"
+#include "lve_thread_pool.hpp"
+
+namespace lve {
+    /**
+     * @brief Culls objects that are hidden behind designated occluders, on the CPU and before any
+     * commands are recorded.
+     * The triangles of every occluder are rasterized into a small depth buffer, four pixels at a
+     * time with SIMD. Each pixel keeps the nearest occluder depth. The buffer is reduced into a
+     * pyramid in which every texel holds the farthest depth of the texels below it. An object is
+     * hidden if the nearest point of its bounding box is behind the farthest occluder depth
+     * everywhere on its screen-space rectangle.
+     * All work runs on the thread pool, so it overlaps with the GPU finishing the previous frame.
+     */
+    class LVEOcclusionCuller {
+       public:
+        // Powers of two so that every pyramid level halves cleanly. The width is a multiple of the
+        // SIMD width of four.
+        static constexpr uint32_t DEPTH_BUFFER_WIDTH = 256;
+        static constexpr uint32_t DEPTH_BUFFER_HEIGHT = 128;
+
+        struct Stats {
+            uint32_t occluderTriangles = 0;
+            uint32_t testedObjects = 0;
+            uint32_t frustumCulledObjects = 0;
+            uint32_t occludedObjects = 0;
+        };
+
+        explicit LVEOcclusionCuller(LVEThreadPool &threadPool);
+        ~LVEOcclusionCuller();
+
+        LVEOcclusionCuller(const LVEOcclusionCuller &) = delete;
+        LVEOcclusionCuller &operator=(const LVEOcclusionCuller &) = delete;
+
+        // Starts culling the entities of scene with a RenderComponent as seen by camera on the
+        // thread pool and returns immediately. The render and transform pools of scene must not
+        // be modified until waitForResults has returned.
+        void beginCulling(LVEScene &scene, const LVECamera &camera);
+        // Blocks until the last culling has finished. Entry i belongs to the entity at position i
+        // of the RenderComponent pool. It is 1 if the entity may be visible and 0 if it is
+        // certainly hidden or outside of the view.
+        const std::vector<uint8_t> &waitForResults();
+
+        // Valid after waitForResults.
+        const Stats &getStats() const { return stats; }
+
+       private:
+        // x and y in depth buffer pixels, z is the normalized device depth.
+        struct ScreenTriangle {
+            glm::vec3 v0;
+            glm::vec3 v1;
+            glm::vec3 v2;
+        };
+
+        void cull(LVEComponentPool<RenderComponent> &renderables,
+                  LVEComponentPool<TransformComponent> &transforms,
+                  const glm::mat4 &projectionView);
+        void transformOccluder(const RenderComponent &occluder,
+                               const TransformComponent &transform,
+                               const glm::mat4 &projectionView,
+                               std::vector<ScreenTriangle> &triangles);
+        void rasterizeTriangle(const ScreenTriangle &triangle, uint32_t firstRow, uint32_t endRow);
+        void buildDepthPyramid();
+        // Returns 0 if outside of the view, 1 if occluded and 2 if possibly visible.
+        int testObject(const RenderComponent &renderable,
+                       const TransformComponent &transform,
+                       const glm::mat4 &projectionView) const;
+
+        LVEThreadPool &threadPool;
+        std::future<void> pendingCulling;
+
+        // One list per chunk of occluders, so that chunks can be transformed in parallel.
+        std::vector<std::vector<ScreenTriangle>> occluderTriangles;
+        // Level 0 is the depth buffer itself. Each further level halves the resolution.
+        std::vector<std::vector<float>> depthPyramid;
+        std::vector<uint8_t> visibility;
+        Stats stats{};
+    };
+}  // namespace lve
@@ -0,0 +1,165 @@
+#include "lve_pass_profiler.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace lve {
+
+    LVEPassProfiler::LVEPassProfiler(LVEDevice &device, int framesInFlight)
+        : lveDevice{device},
+          timestampPeriod{static_cast<double>(device.properties.limits.timestampPeriod)},
+          frames(framesInFlight) {
+        if (!device.properties.limits.timestampComputeAndGraphics) {
+            return;
+        }
+
+        VkQueryPoolCreateInfo timestampPoolInfo{};
+        timestampPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        timestampPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        timestampPoolInfo.queryCount = 2 * MAX_PASSES * static_cast<uint32_t>(framesInFlight);
+        if (vkCreateQueryPool(lveDevice.device(), &timestampPoolInfo, nullptr, &timestampPool) !=
+            VK_SUCCESS) {
+            throw std::runtime_error("Failed to create timestamp query pool");
+        }
+
+        if (!device.enabledFeatures.pipelineStatisticsQuery ||
+            !device.enabledFeatures.inheritedQueries) {
+            return;
+        }
+        VkQueryPoolCreateInfo statisticsPoolInfo{};
+        statisticsPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        statisticsPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        statisticsPoolInfo.queryCount = MAX_PASSES * static_cast<uint32_t>(framesInFlight);
+        statisticsPoolInfo.pipelineStatistics =
+            VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+        if (vkCreateQueryPool(
+                lveDevice.device(), &statisticsPoolInfo, nullptr, &statisticsPool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create pipeline statistics query pool");
+        }
+    }
+
+    LVEPassProfiler::~LVEPassProfiler() {
+        if (timestampPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(lveDevice.device(), timestampPool, nullptr);
+        }
+        if (statisticsPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(lveDevice.device(), statisticsPool, nullptr);
+        }
+    }
+
+    VkQueryPipelineStatisticFlags LVEPassProfiler::getInheritedStatistics() const {
+        return supportsPipelineStatistics()
+                   ? VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT
+                   : 0;
+    }
+
+    void LVEPassProfiler::beginFrame(VkCommandBuffer commandBuffer, int frameIndex) {
+        if (!isSupported()) {
+            return;
+        }
+        if (!frames[frameIndex].passNames.empty()) {
+            readResults(frameIndex);
+        }
+        currentFrameIndex = frameIndex;
+        activeQuery = -1;
+
+        const uint32_t firstPass = MAX_PASSES * static_cast<uint32_t>(frameIndex);
+        vkCmdResetQueryPool(commandBuffer, timestampPool, 2 * firstPass, 2 * MAX_PASSES);
+        if (supportsPipelineStatistics()) {
+            vkCmdResetQueryPool(commandBuffer, statisticsPool, firstPass, MAX_PASSES);
+        }
+    }
+
+    void LVEPassProfiler::beginPass(VkCommandBuffer commandBuffer, const std::string &name) {
+        auto &passNames = frames[currentFrameIndex].passNames;
+        if (!isSupported() || passNames.size() >= MAX_PASSES) {
+            activeQuery = -1;
+            return;
+        }
+        const uint32_t query =
+            MAX_PASSES * static_cast<uint32_t>(currentFrameIndex) +
+            static_cast<uint32_t>(passNames.size());
+        passNames.push_back(name);
+        activeQuery = static_cast<int>(query);
+
+        vkCmdWriteTimestamp(
+            commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, 2 * query);
+        if (supportsPipelineStatistics()) {
+            vkCmdBeginQuery(commandBuffer, statisticsPool, query, 0);
+        }
+    }
+
+    void LVEPassProfiler::endPass(VkCommandBuffer commandBuffer) {
+        if (activeQuery < 0) {
+            return;
+        }
+        const uint32_t query = static_cast<uint32_t>(activeQuery);
+        if (supportsPipelineStatistics()) {
+            vkCmdEndQuery(commandBuffer, statisticsPool, query);
+        }
+        vkCmdWriteTimestamp(
+            commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, 2 * query + 1);
+        activeQuery = -1;
+    }
+
+    void LVEPassProfiler::readResults(int frameIndex) {
+        auto &passNames = frames[frameIndex].passNames;
+        const uint32_t passCount = static_cast<uint32_t>(passNames.size());
+        const uint32_t firstPass = MAX_PASSES * static_cast<uint32_t>(frameIndex);
+
+        // The frame has finished, so these do not wait.
+        std::vector<uint64_t> timestamps(2 * passCount);
+        std::vector<uint64_t> invocations(passCount, 0);
+        bool available = vkGetQueryPoolResults(lveDevice.device(),
+                                               timestampPool,
+                                               2 * firstPass,
+                                               2 * passCount,
+                                               timestamps.size() * sizeof(uint64_t),
+                                               timestamps.data(),
+                                               sizeof(uint64_t),
+                                               VK_QUERY_RESULT_64_BIT) == VK_SUCCESS;
+        if (available && supportsPipelineStatistics()) {
+            available = vkGetQueryPoolResults(lveDevice.device(),
+                                              statisticsPool,
+                                              firstPass,
+                                              passCount,
+                                              invocations.size() * sizeof(uint64_t),
+                                              invocations.data(),
+                                              sizeof(uint64_t),
+                                              VK_QUERY_RESULT_64_BIT) == VK_SUCCESS;
+        }
+
+        for (uint32_t i = 0; available && i < passCount; i++) {
+            auto pass = std::find_if(totals.begin(), totals.end(), [&](const PassTotals &pass) {
+                return pass.name == passNames[i];
+            });
+            if (pass == totals.end()) {
+                pass = totals.insert(totals.end(), PassTotals{passNames[i]});
+            }
+            pass->frameCount++;
+            pass->gpuTimeSumMs +=
+                static_cast<double>(timestamps[2 * i + 1] - timestamps[2 * i]) * timestampPeriod /
+                1e6;
+            pass->fragmentInvocationSum += static_cast<double>(invocations[i]);
+        }
+        passNames.clear();
+    }
+
+    std::vector<LVEPassProfiler::PassStats> LVEPassProfiler::getStats() const {
+        std::vector<PassStats> stats;
+        for (const auto &pass : totals) {
+            PassStats passStats{};
+            passStats.name = pass.name;
+            passStats.frameCount = pass.frameCount;
+            passStats.averageGpuTimeMs = pass.gpuTimeSumMs / pass.frameCount;
+            passStats.averageFragmentInvocations = pass.fragmentInvocationSum / pass.frameCount;
+            stats.push_back(passStats);
+        }
+        return stats;
+    }
+
+    void LVEPassProfiler::resetStats() {
+        // Passes that do not come back, e.g. after toggling them off, drop out of the stats.
+        totals.clear();
+    }
+}  // namespace lve
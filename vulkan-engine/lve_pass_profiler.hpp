@@ -0,0 +1,85 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "lve_device.hpp"
+
+namespace lve {
+    /**
+     * @brief Measures the GPU time of each pass of a frame, and how many fragment shader
+     * invocations it had if the device supports pipeline statistics queries.
+     *
+     * A pass is whatever is recorded between beginPass and endPass, e.g. a render pass including
+     * the barriers before it. Both must be called outside of a render pass. Like the latency
+     * tracker, every frame in flight has its own queries, and their results are read when the
+     * frame index is used again. Passes are told apart by name, in the order they first appeared.
+     */
+    class LVEPassProfiler {
+       public:
+        // Passes per frame beyond this are not measured.
+        static constexpr uint32_t MAX_PASSES = 8;
+
+        struct PassStats {
+            std::string name;
+            uint32_t frameCount = 0;
+            double averageGpuTimeMs = 0.0;
+            // 0 without pipeline statistics.
+            double averageFragmentInvocations = 0.0;
+        };
+
+        LVEPassProfiler(LVEDevice &device, int framesInFlight);
+        ~LVEPassProfiler();
+
+        LVEPassProfiler(const LVEPassProfiler &) = delete;
+        LVEPassProfiler &operator=(const LVEPassProfiler &) = delete;
+
+        // False if the graphics queue has no timestamps. All other calls do nothing then.
+        bool isSupported() const { return timestampPool != VK_NULL_HANDLE; }
+        // Needs the pipelineStatisticsQuery and inheritedQueries features, the latter because
+        // passes may execute secondary command buffers.
+        bool supportsPipelineStatistics() const { return statisticsPool != VK_NULL_HANDLE; }
+        // What the secondary command buffers of a measured pass must inherit, 0 without pipeline
+        // statistics.
+        VkQueryPipelineStatisticFlags getInheritedStatistics() const;
+
+        // Same requirements as LVELatencyTracker::beginFrame.
+        void beginFrame(VkCommandBuffer commandBuffer, int frameIndex);
+        void beginPass(VkCommandBuffer commandBuffer, const std::string &name);
+        void endPass(VkCommandBuffer commandBuffer);
+
+        // Over all frames read back since the last reset.
+        std::vector<PassStats> getStats() const;
+        void resetStats();
+
+       private:
+        struct Frame {
+            // Of the passes that were begun, in order.
+            std::vector<std::string> passNames;
+        };
+        struct PassTotals {
+            std::string name;
+            uint32_t frameCount = 0;
+            double gpuTimeSumMs = 0.0;
+            double fragmentInvocationSum = 0.0;
+        };
+
+        void readResults(int frameIndex);
+
+        LVEDevice &lveDevice;
+        // A start and an end timestamp per pass and frame in flight.
+        VkQueryPool timestampPool = VK_NULL_HANDLE;
+        // One fragment shader invocation count per pass and frame in flight.
+        VkQueryPool statisticsPool = VK_NULL_HANDLE;
+        // Nanoseconds per timestamp tick.
+        double timestampPeriod;
+        std::vector<Frame> frames;
+
+        int currentFrameIndex = 0;
+        // Where the pass between beginPass and endPass is in the query pools, with its timestamps
+        // at twice that. -1 if there is none or it is not measured.
+        int activeQuery = -1;
+
+        std::vector<PassTotals> totals;
+    };
+}  // namespace lve
@@ -1,89 +1,226 @@
 #include "lve_pipeline.hpp"
 
+#include <atomic>
 #include <cassert>
-#include <fstream>
+#include <chrono>
 #include <iostream>
+#include <iterator>
 #include <stdexcept>
 
 #include "lve_model.hpp"
 
 namespace lve {
+
+    namespace {
+        // The dynamic states that cover DrawState, in the order of its members.
+        constexpr VkDynamicState DRAW_STATES[] = {VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY,
+                                                  VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE,
+                                                  VK_DYNAMIC_STATE_POLYGON_MODE_EXT,
+                                                  VK_DYNAMIC_STATE_CULL_MODE,
+                                                  VK_DYNAMIC_STATE_FRONT_FACE,
+                                                  VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE,
+                                                  VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE,
+                                                  VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE,
+                                                  VK_DYNAMIC_STATE_DEPTH_COMPARE_OP};
+
+        // 0 for dynamic states that are not part of DrawState.
+        uint32_t drawStateBit(VkDynamicState state) {
+            for (uint32_t i = 0; i < std::size(DRAW_STATES); i++) {
+                if (DRAW_STATES[i] == state) {
+                    return 1u << i;
+                }
+            }
+            return 0;
+        }
+
+        // Topologies of one class can replace each other without unrestricted dynamic topology.
+        VkPrimitiveTopology firstOfTopologyClass(VkPrimitiveTopology topology) {
+            switch (topology) {
+                case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+                    return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+                case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+                case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+                case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+                case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+                    return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+                case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+                    return VK_PRIMITIVE_TOPOLOGY_PATCH_LIST;
+                default:
+                    return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+            }
+        }
+    }  // namespace
+
+    DrawState DrawState::fromConfig(const PipelineConfigInfo& configInfo) {
+        DrawState drawState{};
+        drawState.topology = configInfo.inputAssemblyInfo.topology;
+        drawState.primitiveRestartEnable = configInfo.inputAssemblyInfo.primitiveRestartEnable;
+        drawState.polygonMode = configInfo.rasterizationInfo.polygonMode;
+        drawState.cullMode = configInfo.rasterizationInfo.cullMode;
+        drawState.frontFace = configInfo.rasterizationInfo.frontFace;
+        drawState.depthBiasEnable = configInfo.rasterizationInfo.depthBiasEnable;
+        drawState.depthTestEnable = configInfo.depthStencilInfo.depthTestEnable;
+        drawState.depthWriteEnable = configInfo.depthStencilInfo.depthWriteEnable;
+        drawState.depthCompareOp = configInfo.depthStencilInfo.depthCompareOp;
+        return drawState;
+    }
+
+    void DrawState::applyTo(PipelineConfigInfo& configInfo) const {
+        configInfo.inputAssemblyInfo.topology = topology;
+        configInfo.inputAssemblyInfo.primitiveRestartEnable = primitiveRestartEnable;
+        configInfo.rasterizationInfo.polygonMode = polygonMode;
+        configInfo.rasterizationInfo.cullMode = cullMode;
+        configInfo.rasterizationInfo.frontFace = frontFace;
+        configInfo.rasterizationInfo.depthBiasEnable = depthBiasEnable;
+        configInfo.depthStencilInfo.depthTestEnable = depthTestEnable;
+        configInfo.depthStencilInfo.depthWriteEnable = depthWriteEnable;
+        configInfo.depthStencilInfo.depthCompareOp = depthCompareOp;
+    }
+
+    LVEPipeline::LVEPipeline(LVEDevice& device,
+                             ShaderCode vertCode,
+                             ShaderCode fragCode,
+                             const PipelineConfigInfo& configInfo)
+        : LVEPipeline(device,
+                      createGraphicsPipeline(device, vertCode, fragCode, configInfo),
+                      configInfo) {}
+
     LVEPipeline::LVEPipeline(LVEDevice& device,
-                             const std::string& vertFilepath,
-                             const std::string& fragFilepath,
+                             VkPipeline pipeline,
                              const PipelineConfigInfo& configInfo)
-        : lveDevice(device) {
-        createGraphicsPipeline(vertFilepath, fragFilepath, configInfo);
+        : lveDevice(device), graphicsPipeline{pipeline} {
+        static std::atomic<uint32_t> nextId{0};
+        id = nextId++;
+        for (VkDynamicState state : configInfo.dynamicStateEnables) {
+            dynamicDrawStates |= drawStateBit(state);
+        }
     }
 
     LVEPipeline::~LVEPipeline() {
-        vkDestroyShaderModule(lveDevice.device(), vertShaderModule, nullptr);
-        vkDestroyShaderModule(lveDevice.device(), fragShaderModule, nullptr);
-        vkDestroyPipeline(lveDevice.device(), graphicsPipeline, nullptr);
+        vkDestroyPipeline(lveDevice.device(), graphicsPipeline.load(), nullptr);
     }
 
     void LVEPipeline::bind(VkCommandBuffer commandBuffer) {
         // VK_PIPELINE_BIND_POINT_GRAPHICS signals that this is a graphics pipeline.
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline.load());
     }
 
-    std::vector<char> LVEPipeline::readFile(const std::string& filepath) {
-        // std::ios::ate => Immediately seek the end of file.
-        std::ifstream file{filepath, std::ios::ate | std::ios::binary};
-        if (!file.is_open()) {
-            throw std::runtime_error("Failed to open file: " + filepath);
+    void LVEPipeline::setDrawState(VkCommandBuffer commandBuffer,
+                                   const DrawState& drawState,
+                                   const DrawState* previous) {
+        const auto needs = [&](VkDynamicState state, auto DrawState::*member) {
+            return (dynamicDrawStates & drawStateBit(state)) != 0 &&
+                   (previous == nullptr || previous->*member != drawState.*member);
+        };
+        if (needs(VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY, &DrawState::topology)) {
+            vkCmdSetPrimitiveTopology(commandBuffer, drawState.topology);
+        }
+        if (needs(VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE, &DrawState::primitiveRestartEnable)) {
+            vkCmdSetPrimitiveRestartEnable(commandBuffer, drawState.primitiveRestartEnable);
+        }
+        if (needs(VK_DYNAMIC_STATE_POLYGON_MODE_EXT, &DrawState::polygonMode)) {
+            lveDevice.cmdSetPolygonMode(commandBuffer, drawState.polygonMode);
         }
-        size_t fileSize = static_cast<size_t>(file.tellg());
-        std::vector<char> buffer(fileSize);
+        if (needs(VK_DYNAMIC_STATE_CULL_MODE, &DrawState::cullMode)) {
+            vkCmdSetCullMode(commandBuffer, drawState.cullMode);
+        }
+        if (needs(VK_DYNAMIC_STATE_FRONT_FACE, &DrawState::frontFace)) {
+            vkCmdSetFrontFace(commandBuffer, drawState.frontFace);
+        }
+        if (needs(VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE, &DrawState::depthBiasEnable)) {
+            vkCmdSetDepthBiasEnable(commandBuffer, drawState.depthBiasEnable);
+        }
+        if (needs(VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE, &DrawState::depthTestEnable)) {
+            vkCmdSetDepthTestEnable(commandBuffer, drawState.depthTestEnable);
+        }
+        if (needs(VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE, &DrawState::depthWriteEnable)) {
+            vkCmdSetDepthWriteEnable(commandBuffer, drawState.depthWriteEnable);
+        }
+        if (needs(VK_DYNAMIC_STATE_DEPTH_COMPARE_OP, &DrawState::depthCompareOp)) {
+            vkCmdSetDepthCompareOp(commandBuffer, drawState.depthCompareOp);
+        }
+    }
 
-        // Seek to the start of the file
-        file.seekg(0);
-        file.read(buffer.data(), fileSize);
+    void LVEPipeline::replace(VkPipeline pipeline) {
+        const VkPipeline oldPipeline = graphicsPipeline.exchange(pipeline);
+        const VkDevice device = lveDevice.device();
+        lveDevice.deferDestruction(
+            [device, oldPipeline]() { vkDestroyPipeline(device, oldPipeline, nullptr); });
+    }
+
+    GraphicsPipelineCreateInfo::GraphicsPipelineCreateInfo(LVEDevice& device,
+                                                           ShaderCode vertCode,
+                                                           ShaderCode fragCode,
+                                                           const PipelineConfigInfo& configInfo)
+        : lveDevice{device},
+          ownsModules{true},
+          vertexSpecializationInfo{configInfo.vertexSpecialization.info()},
+          fragmentSpecializationInfo{configInfo.fragmentSpecialization.info()} {
+        const VkShaderModule vertModule = LVEPipeline::createShaderModule(lveDevice, vertCode);
+        VkShaderModule fragModule = VK_NULL_HANDLE;
+        if (!fragCode.empty()) {
+            try {
+                fragModule = LVEPipeline::createShaderModule(lveDevice, fragCode);
+            } catch (...) {
+                // The destructor does not run for a constructor that throws.
+                vkDestroyShaderModule(lveDevice.device(), vertModule, nullptr);
+                throw;
+            }
+        }
+        init(vertModule, fragModule, configInfo);
+    }
 
-        file.close();
-        return buffer;
+    GraphicsPipelineCreateInfo::GraphicsPipelineCreateInfo(LVEDevice& device,
+                                                           VkShaderModule vertModule,
+                                                           VkShaderModule fragModule,
+                                                           const PipelineConfigInfo& configInfo)
+        : lveDevice{device},
+          ownsModules{false},
+          vertexSpecializationInfo{configInfo.vertexSpecialization.info()},
+          fragmentSpecializationInfo{configInfo.fragmentSpecialization.info()} {
+        init(vertModule, fragModule, configInfo);
     }
 
-    void LVEPipeline::createGraphicsPipeline(const std::string& vertFilepath,
-                                             const std::string& fragFilepath,
-                                             const PipelineConfigInfo& configInfo) {
+    void GraphicsPipelineCreateInfo::init(VkShaderModule vertModule,
+                                          VkShaderModule fragModule,
+                                          const PipelineConfigInfo& configInfo) {
         assert(configInfo.pipelineLayout != VK_NULL_HANDLE &&
                "Cannor create graphics pipeline:: no pipelineLayout provided in configInfo");
-        assert(configInfo.renderPass != VK_NULL_HANDLE &&
-               "Cannor create graphics pipeline:: no renderPass provided in configInfo");
-
-        auto vertCode = readFile(vertFilepath);
-        auto fragCode = readFile(fragFilepath);
-
-        // std::cout << "Vertex shader code size: " << vertCode.size() << "\n";
-        // std::cout << "Fragment shader code size: " << fragCode.size() << "\n";
-
-        createShaderModule(vertCode, &vertShaderModule);
-        createShaderModule(fragCode, &fragShaderModule);
+        assert((configInfo.renderPass != VK_NULL_HANDLE ||
+                !configInfo.colorAttachmentFormats.empty() ||
+                configInfo.depthAttachmentFormat != VK_FORMAT_UNDEFINED) &&
+               "Cannor create graphics pipeline:: no renderPass or attachment formats provided in "
+               "configInfo");
 
-        VkPipelineShaderStageCreateInfo shaderStages[2];
         shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-        shaderStages[0].module = vertShaderModule;
+        shaderStages[0].module = vertModule;
+        stageCount = 1;
         // Name of entry function in vertex shader
         shaderStages[0].pName = "main";
         shaderStages[0].flags = 0;
         shaderStages[0].pNext = nullptr;
-        shaderStages[0].pSpecializationInfo = nullptr;
-
-        shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        shaderStages[1].module = fragShaderModule;
-        shaderStages[1].pName = "main";
-        shaderStages[1].flags = 0;
-        shaderStages[1].pNext = nullptr;
-        shaderStages[1].pSpecializationInfo = nullptr;
-
-        auto bindingDescriptions = LVEModel::Vertex::getBindingDescriptions();
-        auto attributeDescriptions = LVEModel::Vertex::getAttributeDescriptions();
+        shaderStages[0].pSpecializationInfo =
+            configInfo.vertexSpecialization.empty() ? nullptr : &vertexSpecializationInfo;
+
+        // Without a fragment shader only depth (and stencil) is written, which is all a depth
+        // pre-pass needs.
+        if (fragModule != VK_NULL_HANDLE) {
+            shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+            shaderStages[1].module = fragModule;
+            shaderStages[1].pName = "main";
+            shaderStages[1].flags = 0;
+            shaderStages[1].pNext = nullptr;
+            shaderStages[1].pSpecializationInfo =
+                configInfo.fragmentSpecialization.empty() ? nullptr : &fragmentSpecializationInfo;
+            stageCount = 2;
+        }
+
+        auto &bindingDescriptions = configInfo.bindingDescriptions;
+        auto &attributeDescriptions = configInfo.attributeDescriptions;
         // Describe how to interpret vertex buffer data that is the initial input into the graphics
         // pipeline.
-        VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
         vertexInputInfo.vertexAttributeDescriptionCount =
             static_cast<uint32_t>(attributeDescriptions.size());
@@ -92,10 +229,9 @@ namespace lve {
         vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
         vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
 
-        VkGraphicsPipelineCreateInfo pipelineInfo{};
         pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
         // The numver of programmable stages our pipeline will use
-        pipelineInfo.stageCount = 2;
+        pipelineInfo.stageCount = stageCount;
         pipelineInfo.pStages = shaderStages;
         pipelineInfo.pVertexInputState = &vertexInputInfo;
         pipelineInfo.pViewportState = &configInfo.viewportInfo;
@@ -110,33 +246,72 @@ namespace lve {
         pipelineInfo.renderPass = configInfo.renderPass;
         pipelineInfo.subpass = configInfo.subpass;
 
+        // With dynamic rendering, the pipeline only has to know the formats it renders to.
+        renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+        if (configInfo.renderPass == VK_NULL_HANDLE) {
+            renderingInfo.colorAttachmentCount =
+                static_cast<uint32_t>(configInfo.colorAttachmentFormats.size());
+            renderingInfo.pColorAttachmentFormats = configInfo.colorAttachmentFormats.data();
+            renderingInfo.depthAttachmentFormat = configInfo.depthAttachmentFormat;
+            renderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+            pipelineInfo.pNext = &renderingInfo;
+        }
+
         pipelineInfo.basePipelineIndex = -1;
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    }
 
-        if (vkCreateGraphicsPipelines(
-                lveDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) !=
-            VK_SUCCESS) {
+    GraphicsPipelineCreateInfo::~GraphicsPipelineCreateInfo() {
+        if (!ownsModules) {
+            return;
+        }
+        for (uint32_t i = 0; i < stageCount; i++) {
+            vkDestroyShaderModule(lveDevice.device(), shaderStages[i].module, nullptr);
+        }
+    }
+
+    VkPipeline LVEPipeline::createGraphicsPipeline(LVEDevice& device,
+                                                   ShaderCode vertCode,
+                                                   ShaderCode fragCode,
+                                                   const PipelineConfigInfo& configInfo) {
+        const GraphicsPipelineCreateInfo createInfo{device, vertCode, fragCode, configInfo};
+        VkPipeline pipeline;
+        const auto start = std::chrono::steady_clock::now();
+        if (vkCreateGraphicsPipelines(device.device(),
+                                      device.getPipelineCache(),
+                                      1,
+                                      &createInfo.get(),
+                                      nullptr,
+                                      &pipeline) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create graphics pipeline");
         }
+        device.recordPipelineCreation(std::chrono::steady_clock::now() - start);
+        return pipeline;
     }
 
-    void LVEPipeline::createShaderModule(const std::vector<char>& code,
-                                         VkShaderModule* shaderModule) {
+    VkShaderModule LVEPipeline::createShaderModule(LVEDevice& device, ShaderCode code) {
         // Configure this struct and pass to the function
         VkShaderModuleCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+        // In bytes.
+        createInfo.codeSize = code.size_bytes();
+        createInfo.pCode = code.data();
 
-        if (vkCreateShaderModule(lveDevice.device(), &createInfo, nullptr, shaderModule) !=
+        VkShaderModule shaderModule;
+        if (vkCreateShaderModule(device.device(), &createInfo, nullptr, &shaderModule) !=
             VK_SUCCESS) {
             throw std::runtime_error("Failed to create shader module.");
         }
+        return shaderModule;
     }
 
     void LVEPipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo) {
         // sType is the member that defines the struct type.
 
+        // Vertex input: One interleaved buffer with all the attributes of LVEModel::Vertex.
+        configInfo.bindingDescriptions = LVEModel::Vertex::getBindingDescriptions();
+        configInfo.attributeDescriptions = LVEModel::Vertex::getAttributeDescriptions();
+
         // First stage of pipeline: Input Assembler
         // Inputs list of vertices and groups them into geometry
         configInfo.inputAssemblyInfo.sType =
@@ -243,4 +418,70 @@ namespace lve {
         // No default for pipelineLayout, renderPass, and subpass.
     }
 
+    void LVEPipeline::depthPrepassPipelineConfigInfo(PipelineConfigInfo& configInfo) {
+        defaultPipelineConfigInfo(configInfo);
+
+        // Only fetch the position (location 0). The models keep a single interleaved vertex
+        // buffer, so the binding and its stride stay the same and the other attributes are
+        // skipped.
+        configInfo.attributeDescriptions.resize(1);
+        assert(configInfo.attributeDescriptions[0].location == 0 &&
+               "Expected the position to be the first vertex attribute");
+
+        // The pre-pass renders into a depth only render pass.
+        configInfo.colorBlendInfo.attachmentCount = 0;
+        configInfo.colorBlendInfo.pAttachments = nullptr;
+
+        configInfo.depthStencilInfo.depthTestEnable = VK_TRUE;
+        configInfo.depthStencilInfo.depthWriteEnable = VK_TRUE;
+        configInfo.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+    }
+
+    void LVEPipeline::makeDrawStateDynamic(PipelineConfigInfo& configInfo,
+                                           const LVEDevice& device) {
+        if (!device.supportsExtendedDynamicState()) {
+            // Every combination of draw state stays a pipeline of its own.
+            return;
+        }
+        const DrawState defaults{};
+        auto& states = configInfo.dynamicStateEnables;
+        states.insert(states.end(),
+                      {VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY,
+                       VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE,
+                       VK_DYNAMIC_STATE_CULL_MODE,
+                       VK_DYNAMIC_STATE_FRONT_FACE,
+                       VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE,
+                       VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE,
+                       VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE,
+                       VK_DYNAMIC_STATE_DEPTH_COMPARE_OP});
+        // Only the class of the topology remains baked in.
+        configInfo.inputAssemblyInfo.topology =
+            device.supportsUnrestrictedDynamicTopology()
+                ? defaults.topology
+                : firstOfTopologyClass(configInfo.inputAssemblyInfo.topology);
+        configInfo.inputAssemblyInfo.primitiveRestartEnable = defaults.primitiveRestartEnable;
+        configInfo.rasterizationInfo.cullMode = defaults.cullMode;
+        configInfo.rasterizationInfo.frontFace = defaults.frontFace;
+        configInfo.rasterizationInfo.depthBiasEnable = defaults.depthBiasEnable;
+        configInfo.depthStencilInfo.depthTestEnable = defaults.depthTestEnable;
+        configInfo.depthStencilInfo.depthWriteEnable = defaults.depthWriteEnable;
+        configInfo.depthStencilInfo.depthCompareOp = defaults.depthCompareOp;
+        if (device.supportsDynamicPolygonMode()) {
+            states.push_back(VK_DYNAMIC_STATE_POLYGON_MODE_EXT);
+            configInfo.rasterizationInfo.polygonMode = defaults.polygonMode;
+        }
+
+        configInfo.dynamicStateInfo.pDynamicStates = states.data();
+        configInfo.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(states.size());
+    }
+
+    void LVEPipeline::enableDepthPrepassTest(PipelineConfigInfo& configInfo) {
+        // The depth buffer already holds the nearest surface. Only fragments at exactly that
+        // depth pass, which requires both passes to compute the same positions (see the invariant
+        // gl_Position in the vertex shaders).
+        configInfo.depthStencilInfo.depthTestEnable = VK_TRUE;
+        configInfo.depthStencilInfo.depthWriteEnable = VK_FALSE;
+        configInfo.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    }
+
 }  // namespace lve
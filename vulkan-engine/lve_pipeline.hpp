@@ -1,15 +1,70 @@
 #pragma once
-#include <string>
+#include <atomic>
+#include <cstring>
+#include <span>
+#include <type_traits>
 #include <vector>
 
 #include "lve_device.hpp"
 
 namespace lve {
+    /**
+     * @brief The specialization constants of a shader stage, which are baked into the pipeline
+     * when it is created. The driver compiles them like literals, so branches on them and loops
+     * over them cost nothing at run time.
+     */
+    struct ShaderSpecialization {
+        std::vector<VkSpecializationMapEntry> mapEntries;
+        std::vector<uint8_t> data;
+
+        bool empty() const { return mapEntries.empty(); }
+        // Points into this object, so it must not change while the info is used.
+        VkSpecializationInfo info() const {
+            return {static_cast<uint32_t>(mapEntries.size()),
+                    mapEntries.data(),
+                    data.size(),
+                    data.data()};
+        }
+
+        /**
+         * @brief From a struct with a member per constant. The members get the constant IDs 0,
+         * 1, 2, ... in the order they are listed:
+         *     struct Constants { float ambient; VkBool32 shadows; uint32_t sampleCount; };
+         *     ShaderSpecialization::fromStruct(Constants{0.02f, VK_TRUE, 4},
+         *                                      &Constants::ambient,
+         *                                      &Constants::shadows,
+         *                                      &Constants::sampleCount);
+         * matches layout(constant_id = 0) const float AMBIENT and so on in the shader.
+         */
+        template <typename T, typename... Members>
+        static ShaderSpecialization fromStruct(const T& constants, Members T::*... members) {
+            static_assert(std::is_trivially_copyable_v<T>,
+                          "Specialization constants are copied byte by byte");
+            static_assert(((sizeof(Members) == 4 || sizeof(Members) == 8) && ...),
+                          "Specialization constants are 32 or 64 bit scalars, use VkBool32 for "
+                          "booleans");
+            ShaderSpecialization specialization;
+            specialization.data.resize(sizeof(T));
+            std::memcpy(specialization.data.data(), &constants, sizeof(T));
+            const auto base = reinterpret_cast<const uint8_t*>(&constants);
+            uint32_t constantId = 0;
+            (specialization.mapEntries.push_back(
+                 {constantId++,
+                  static_cast<uint32_t>(reinterpret_cast<const uint8_t*>(&(constants.*members)) -
+                                        base),
+                  sizeof(Members)}),
+             ...);
+            return specialization;
+        }
+    };
+
     struct PipelineConfigInfo {
         PipelineConfigInfo() = default;
         PipelineConfigInfo& operator=(const PipelineConfigInfo&) = delete;
         PipelineConfigInfo(const PipelineConfigInfo&) = delete;
 
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions{};
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
         VkPipelineViewportStateCreateInfo viewportInfo;
         VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo;
         VkPipelineRasterizationStateCreateInfo rasterizationInfo;
@@ -22,13 +77,103 @@ namespace lve {
         VkPipelineLayout pipelineLayout = nullptr;
         VkRenderPass renderPass = nullptr;
         uint32_t subpass = 0;
+        // Used instead of the render pass if it is VK_NULL_HANDLE, for dynamic rendering.
+        std::vector<VkFormat> colorAttachmentFormats{};
+        VkFormat depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+
+        // Empty for stages without specialization constants, or whose defaults are fine.
+        ShaderSpecialization vertexSpecialization{};
+        ShaderSpecialization fragmentSpecialization{};
+    };
+
+    /**
+     * @brief The fixed function state that varies between otherwise equal pipelines, like
+     * between materials and passes. With extended dynamic state it is set while recording, so a
+     * single pipeline covers every combination (see LVEPipeline::makeDrawStateDynamic). Without,
+     * each combination needs its own pipeline.
+     */
+    struct DrawState {
+        VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        VkBool32 primitiveRestartEnable = VK_FALSE;
+        VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+        VkCullModeFlags cullMode = VK_CULL_MODE_NONE;
+        VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+        VkBool32 depthBiasEnable = VK_FALSE;
+        VkBool32 depthTestEnable = VK_TRUE;
+        VkBool32 depthWriteEnable = VK_TRUE;
+        VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+
+        // The state a configuration bakes in.
+        static DrawState fromConfig(const PipelineConfigInfo& configInfo);
+        // Bakes the state into a configuration.
+        void applyTo(PipelineConfigInfo& configInfo) const;
+    };
+
+    // What a pipeline renders into: A render pass, or the attachment formats when rendering
+    // dynamically without one.
+    struct PipelineRenderTarget {
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        std::vector<VkFormat> colorAttachmentFormats{};
+        VkFormat depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+
+        void applyTo(PipelineConfigInfo& configInfo) const {
+            configInfo.renderPass = renderPass;
+            configInfo.colorAttachmentFormats = colorAttachmentFormats;
+            configInfo.depthAttachmentFormat = depthAttachmentFormat;
+        }
+    };
+
+    // Compiled SPIR-V, e.g. one of the arrays the build embeds in lve::shaders.
+    using ShaderCode = std::span<const uint32_t>;
+
+    /**
+     * @brief Everything vkCreateGraphicsPipelines reads for one pipeline, built from a
+     * configuration. Given shader code, it creates the shader modules and destroys them again
+     * with itself, so it only has to live until the create call returns. Points into configInfo,
+     * which has to outlive it.
+     */
+    class GraphicsPipelineCreateInfo {
+       public:
+        GraphicsPipelineCreateInfo(LVEDevice& device,
+                                   ShaderCode vertCode,
+                                   ShaderCode fragCode,
+                                   const PipelineConfigInfo& configInfo);
+        // With shader modules that are owned by the caller. fragModule may be VK_NULL_HANDLE.
+        GraphicsPipelineCreateInfo(LVEDevice& device,
+                                   VkShaderModule vertModule,
+                                   VkShaderModule fragModule,
+                                   const PipelineConfigInfo& configInfo);
+        ~GraphicsPipelineCreateInfo();
+
+        // Holds pointers to its own members.
+        GraphicsPipelineCreateInfo(const GraphicsPipelineCreateInfo&) = delete;
+        GraphicsPipelineCreateInfo& operator=(const GraphicsPipelineCreateInfo&) = delete;
+
+        const VkGraphicsPipelineCreateInfo& get() const { return pipelineInfo; }
+
+       private:
+        void init(VkShaderModule vertModule,
+                  VkShaderModule fragModule,
+                  const PipelineConfigInfo& configInfo);
+
+        LVEDevice& lveDevice;
+        bool ownsModules;
+        VkSpecializationInfo vertexSpecializationInfo;
+        VkSpecializationInfo fragmentSpecializationInfo;
+        VkPipelineShaderStageCreateInfo shaderStages[2]{};
+        uint32_t stageCount = 0;
+        VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+        VkPipelineRenderingCreateInfo renderingInfo{};
+        VkGraphicsPipelineCreateInfo pipelineInfo{};
     };
 
     class LVEPipeline {
        public:
+        // Empty fragCode creates a pipeline without a fragment shader, e.g. for depth only
+        // rendering.
         LVEPipeline(LVEDevice& device,
-                    const std::string& vertFilepath,
-                    const std::string& fragFilepath,
+                    ShaderCode vertCode,
+                    ShaderCode fragCode,
                     const PipelineConfigInfo& configInfo);
 
         ~LVEPipeline();
@@ -39,23 +184,56 @@ namespace lve {
         LVEPipeline& operator=(const LVEPipeline&) = delete;
 
         void bind(VkCommandBuffer commandBuffer);
+        // Sets the parts of the draw state that are dynamic in this pipeline, after binding it
+        // and before drawing. If previous is given, the state that was set since the bind, only
+        // what differs from it is set.
+        void setDrawState(VkCommandBuffer commandBuffer,
+                          const DrawState& drawState,
+                          const DrawState* previous = nullptr);
+        bool hasDynamicDrawState() const { return dynamicDrawStates != 0; }
+
+        // Unique per pipeline. Used to group draws of the same pipeline together.
+        uint32_t getId() const { return id; }
 
         static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
+        // The default configuration, reduced to what a depth pre-pass needs: only the vertex
+        // positions are fetched and there are no color attachments. Use without a fragment shader.
+        static void depthPrepassPipelineConfigInfo(PipelineConfigInfo& configInfo);
+        // Turns a configuration into one that draws on top of a depth pre-pass. Depth is tested
+        // against the pre-pass but not written again.
+        static void enableDepthPrepassTest(PipelineConfigInfo& configInfo);
+        // Makes the parts of the draw state that the device can set while recording dynamic, and
+        // resets them to their defaults. Configurations that only differ in those parts then
+        // describe the same pipeline, which the pipeline manager only creates once. Take the
+        // DrawState from the configuration first, since it has to be set for every draw.
+        static void makeDrawStateDynamic(PipelineConfigInfo& configInfo, const LVEDevice& device);
 
-       private:
-        static std::vector<char> readFile(const std::string& filepath);
+        // The pipeline does not need its shader modules once it is created, so they only live
+        // as long as the create call.
+        static VkShaderModule createShaderModule(LVEDevice& device, ShaderCode code);
 
-        void createGraphicsPipeline(const std::string& vertFilepath,
-                                    const std::string& fragFilepath,
-                                    const PipelineConfigInfo& configInfo);
+       private:
+        // Both create the Vulkan pipelines themselves and wrap them.
+        friend class LVEPipelineBuilder;
+        friend class LVEPipelineManager;
+        LVEPipeline(LVEDevice& device, VkPipeline pipeline, const PipelineConfigInfo& configInfo);
+        // Swaps in an equivalent pipeline, e.g. an optimized build of a quickly linked one, while
+        // frames may be recorded on other threads. The old one is destroyed once the frames that
+        // may have bound it are done.
+        void replace(VkPipeline pipeline);
 
-        // VkShaderModule* is pointer to pointer.
-        void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+        static VkPipeline createGraphicsPipeline(LVEDevice& device,
+                                                 ShaderCode vertCode,
+                                                 ShaderCode fragCode,
+                                                 const PipelineConfigInfo& configInfo);
 
         // Memory unsafe in general. The device will outlive any instances of the class here.
         LVEDevice& lveDevice;
-        VkPipeline graphicsPipeline;
-        VkShaderModule vertShaderModule;  // This is a pointer. Hover over it to see!
-        VkShaderModule fragShaderModule;  // This is a pointer. Hover over it to see!
+        uint32_t id;
+        // Which parts of the draw state are dynamic, one bit per DrawState member.
+        uint32_t dynamicDrawStates = 0;
+        // This is a pointer. Hover over it to see! Atomic, since it may be replaced while
+        // recording.
+        std::atomic<VkPipeline> graphicsPipeline;
     };
 }  // namespace lve
@@ -0,0 +1,154 @@
+#include "lve_pipeline_builder.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+namespace lve {
+
+    namespace {
+        uint32_t defaultBatchSize(bool threaded) {
+            return threaded ? 1 : std::numeric_limits<uint32_t>::max();
+        }
+    }  // namespace
+
+    LVEPipelineBuilder::LVEPipelineBuilder(LVEDevice &device,
+                                           LVEThreadPool *threadPool,
+                                           uint32_t batchSize)
+        : lveDevice{device},
+          threadPool{threadPool},
+          batchSize{batchSize > 0 ? batchSize : defaultBatchSize(threadPool != nullptr)} {}
+
+    LVEPipelineBuilder::~LVEPipelineBuilder() {
+        try {
+            build();
+        } catch (...) {
+            // Creation errors go to the handles. Only allocating can fail here, and destructors
+            // must not throw.
+        }
+    }
+
+    LVEPipelineBuilder::PipelineHandle LVEPipelineBuilder::add(
+        ShaderCode vertCode, ShaderCode fragCode, std::unique_ptr<PipelineConfigInfo> configInfo) {
+        // Completions have to be copyable, so the promise is shared.
+        auto pipeline = std::make_shared<std::promise<std::unique_ptr<LVEPipeline>>>();
+        PipelineHandle handle = pipeline->get_future();
+        Request request{vertCode, fragCode};
+        request.configInfo = std::move(configInfo);
+        request.completion = [pipeline](std::unique_ptr<LVEPipeline> created,
+                                        std::exception_ptr error,
+                                        std::chrono::nanoseconds) {
+            if (error != nullptr) {
+                pipeline->set_exception(error);
+            } else {
+                pipeline->set_value(std::move(created));
+            }
+        };
+        addRequest(std::move(request));
+        return handle;
+    }
+
+    void LVEPipelineBuilder::add(VkShaderModule vertModule,
+                                 VkShaderModule fragModule,
+                                 std::unique_ptr<PipelineConfigInfo> configInfo,
+                                 Completion completion) {
+        Request request{};
+        request.vertModule = vertModule;
+        request.fragModule = fragModule;
+        request.configInfo = std::move(configInfo);
+        request.completion = std::move(completion);
+        addRequest(std::move(request));
+    }
+
+    void LVEPipelineBuilder::addRequest(Request request) {
+        assert(request.configInfo != nullptr && "Cannot add a pipeline without a configuration");
+        pending.push_back(std::move(request));
+        if (threadPool != nullptr && pending.size() >= batchSize) {
+            submitBatch();
+        }
+    }
+
+    void LVEPipelineBuilder::build() {
+        while (!pending.empty()) {
+            submitBatch();
+        }
+    }
+
+    void LVEPipelineBuilder::submitBatch() {
+        const size_t count = std::min<size_t>(batchSize, pending.size());
+        Batch batch{std::make_move_iterator(pending.begin()),
+                    std::make_move_iterator(pending.begin() + count)};
+        pending.erase(pending.begin(), pending.begin() + count);
+
+        if (threadPool == nullptr) {
+            createBatch(lveDevice, batch);
+            return;
+        }
+        // The results go through the promises, so the task's own future is not needed.
+        LVEDevice &device = lveDevice;
+        threadPool->submit(
+            [&device, batch = std::move(batch)]() mutable { createBatch(device, batch); });
+    }
+
+    void LVEPipelineBuilder::createBatch(LVEDevice &device, Batch &batch) {
+        // A request whose shader modules cannot be created fails on its own and is left out.
+        std::vector<Request *> requests;
+        std::vector<std::unique_ptr<GraphicsPipelineCreateInfo>> createInfos;
+        std::vector<VkGraphicsPipelineCreateInfo> pipelineInfos;
+        for (auto &request : batch) {
+            try {
+                if (request.vertModule != VK_NULL_HANDLE) {
+                    createInfos.push_back(std::make_unique<GraphicsPipelineCreateInfo>(
+                        device, request.vertModule, request.fragModule, *request.configInfo));
+                } else {
+                    createInfos.push_back(std::make_unique<GraphicsPipelineCreateInfo>(
+                        device, request.vertCode, request.fragCode, *request.configInfo));
+                }
+            } catch (...) {
+                request.completion(nullptr, std::current_exception(), {});
+                continue;
+            }
+            requests.push_back(&request);
+            pipelineInfos.push_back(createInfos.back()->get());
+        }
+        if (requests.empty()) {
+            return;
+        }
+
+        std::vector<VkPipeline> pipelines(requests.size(), VK_NULL_HANDLE);
+        const auto start = std::chrono::steady_clock::now();
+        vkCreateGraphicsPipelines(device.device(),
+                                  device.getPipelineCache(),
+                                  static_cast<uint32_t>(pipelineInfos.size()),
+                                  pipelineInfos.data(),
+                                  nullptr,
+                                  pipelines.data());
+        // The driver does not say how the time was split, so every pipeline gets an equal share.
+        const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            (std::chrono::steady_clock::now() - start) / requests.size());
+        createInfos.clear();
+
+        // If the call fails, the pipelines that failed are VK_NULL_HANDLE and the others were
+        // still created.
+        for (size_t i = 0; i < requests.size(); i++) {
+            if (pipelines[i] == VK_NULL_HANDLE) {
+                requests[i]->completion(
+                    nullptr,
+                    std::make_exception_ptr(
+                        std::runtime_error("Failed to create graphics pipeline")),
+                    duration);
+                continue;
+            }
+            device.recordPipelineCreation(duration);
+            // The constructor is private to the builder, which rules out std::make_unique.
+            requests[i]->completion(std::unique_ptr<LVEPipeline>{new LVEPipeline(
+                                        device, pipelines[i], *requests[i]->configInfo)},
+                                    nullptr,
+                                    duration);
+        }
+    }
+}  // namespace lve
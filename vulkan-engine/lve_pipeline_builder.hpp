@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "lve_device.hpp"
+#include "lve_pipeline.hpp"
+#include "lve_thread_pool.hpp"
+
+namespace lve {
+    /**
+     * @brief Creates many graphics pipelines at once instead of one after the other. The
+     * pipelines are grouped into batches, each of which is created with a single
+     * vkCreateGraphicsPipelines call. With a thread pool the batches are created on its workers
+     * in parallel, otherwise on the thread that calls build(). All of them go through the
+     * device's pipeline cache, which Vulkan synchronizes internally.
+     *
+     *     LVEPipelineBuilder builder{device, &threadPool};
+     *     auto opaque = builder.add(vertCode, fragCode, std::move(opaqueConfig));
+     *     auto prepass = builder.add(prepassCode, {}, std::move(prepassConfig));
+     *     builder.build();
+     *     opaquePipeline = opaque.get();
+     */
+    class LVEPipelineBuilder {
+       public:
+        // Holds the pipeline once it is created, or rethrows why it could not be.
+        using PipelineHandle = std::future<std::unique_ptr<LVEPipeline>>;
+        // Called on the thread that created the batch, with either the pipeline or why it could
+        // not be created, and the pipeline's share of the batch's creation time.
+        using Completion = std::function<void(std::unique_ptr<LVEPipeline> pipeline,
+                                              std::exception_ptr error,
+                                              std::chrono::nanoseconds duration)>;
+
+        // A batchSize of 0 picks one pipeline per batch with a thread pool, since drivers tend to
+        // compile the pipelines of one call one after the other, and a single batch without.
+        LVEPipelineBuilder(LVEDevice &device,
+                           LVEThreadPool *threadPool = nullptr,
+                           uint32_t batchSize = 0);
+        // Starts whatever is still pending, so that every handle gets a result.
+        ~LVEPipelineBuilder();
+
+        LVEPipelineBuilder(const LVEPipelineBuilder &) = delete;
+        LVEPipelineBuilder &operator=(const LVEPipelineBuilder &) = delete;
+
+        // The configuration is taken over, since the pipeline may be created after the caller
+        // moved on. The shader code is not copied and has to stay alive until then, which the
+        // embedded shaders always do. With a thread pool, full batches start right away.
+        PipelineHandle add(ShaderCode vertCode,
+                           ShaderCode fragCode,
+                           std::unique_ptr<PipelineConfigInfo> configInfo);
+        // With shader modules that are owned by the caller and have to stay alive until
+        // completion is called. fragModule may be VK_NULL_HANDLE. For callers that hand out
+        // pipelines their own way, like LVEPipelineManager.
+        void add(VkShaderModule vertModule,
+                 VkShaderModule fragModule,
+                 std::unique_ptr<PipelineConfigInfo> configInfo,
+                 Completion completion);
+        // Starts everything that is still pending. Only blocks without a thread pool.
+        void build();
+
+       private:
+        struct Request {
+            // The modules if they are given, the code otherwise.
+            ShaderCode vertCode;
+            ShaderCode fragCode;
+            VkShaderModule vertModule = VK_NULL_HANDLE;
+            VkShaderModule fragModule = VK_NULL_HANDLE;
+            std::unique_ptr<PipelineConfigInfo> configInfo;
+            Completion completion;
+        };
+        using Batch = std::vector<Request>;
+
+        void addRequest(Request request);
+        // Takes the next batch off the pending requests and creates it.
+        void submitBatch();
+        static void createBatch(LVEDevice &device, Batch &batch);
+
+        LVEDevice &lveDevice;
+        LVEThreadPool *threadPool;
+        uint32_t batchSize;
+        Batch pending;
+    };
+}  // namespace lve
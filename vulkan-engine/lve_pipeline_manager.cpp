@@ -0,0 +1,561 @@
+#include "lve_pipeline_manager.hpp"
+
+#include <cassert>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <type_traits>
+
+namespace lve {
+
+    namespace {
+        // Serializes the parts of a pipeline description that affect the pipeline into a string,
+        // which is then used as the key. Comparing the whole key rules out hash collisions.
+        class KeyWriter {
+           public:
+            // Only for types without padding, since padding bytes are undefined.
+            template <typename T>
+            void add(const T &value) {
+                static_assert(std::is_trivially_copyable_v<T>, "Keys are copied byte by byte");
+                key.append(reinterpret_cast<const char *>(&value), sizeof(T));
+            }
+            template <typename T>
+            void addArray(const T *values, size_t count) {
+                add(count);
+                for (size_t i = 0; i < count; i++) {
+                    add(values[i]);
+                }
+            }
+            template <typename T>
+            void addVector(const std::vector<T> &values) {
+                addArray(values.data(), values.size());
+            }
+            void addShader(ShaderCode code) {
+                add(code.data());
+                add(code.size());
+            }
+            void addSpecialization(const ShaderSpecialization &specialization) {
+                addVector(specialization.mapEntries);
+                addVector(specialization.data);
+            }
+
+            std::string key;
+        };
+
+        // Everything that all libraries depend on.
+        void addCommonState(KeyWriter &writer, const PipelineConfigInfo &configInfo) {
+            // Extension structs are not part of the key, so none may be chained.
+            assert(configInfo.viewportInfo.pNext == nullptr &&
+                   configInfo.rasterizationInfo.pNext == nullptr &&
+                   configInfo.multisampleInfo.pNext == nullptr &&
+                   configInfo.colorBlendInfo.pNext == nullptr &&
+                   configInfo.depthStencilInfo.pNext == nullptr &&
+                   "Pipeline manager keys do not cover pNext chains");
+            writer.addArray(configInfo.dynamicStateInfo.pDynamicStates,
+                            configInfo.dynamicStateInfo.dynamicStateCount);
+            writer.add(configInfo.pipelineLayout);
+            writer.add(configInfo.renderPass);
+            writer.add(configInfo.subpass);
+            writer.addVector(configInfo.colorAttachmentFormats);
+            writer.add(configInfo.depthAttachmentFormat);
+        }
+
+        void addVertexInputState(KeyWriter &writer, const PipelineConfigInfo &configInfo) {
+            writer.addVector(configInfo.bindingDescriptions);
+            writer.addVector(configInfo.attributeDescriptions);
+
+            const auto &inputAssembly = configInfo.inputAssemblyInfo;
+            writer.add(inputAssembly.flags);
+            writer.add(inputAssembly.topology);
+            writer.add(inputAssembly.primitiveRestartEnable);
+        }
+
+        void addPreRasterizationState(KeyWriter &writer,
+                                      ShaderCode vertCode,
+                                      const PipelineConfigInfo &configInfo) {
+            writer.addShader(vertCode);
+            writer.addSpecialization(configInfo.vertexSpecialization);
+
+            const auto &viewport = configInfo.viewportInfo;
+            writer.add(viewport.flags);
+            writer.add(viewport.viewportCount);
+            writer.add(viewport.scissorCount);
+            // Only given if the viewport and scissor are not dynamic.
+            if (viewport.pViewports != nullptr) {
+                for (uint32_t i = 0; i < viewport.viewportCount; i++) {
+                    const VkViewport &v = viewport.pViewports[i];
+                    writer.add(v.x);
+                    writer.add(v.y);
+                    writer.add(v.width);
+                    writer.add(v.height);
+                    writer.add(v.minDepth);
+                    writer.add(v.maxDepth);
+                }
+            }
+            if (viewport.pScissors != nullptr) {
+                writer.addArray(viewport.pScissors, viewport.scissorCount);
+            }
+
+            const auto &rasterization = configInfo.rasterizationInfo;
+            writer.add(rasterization.flags);
+            writer.add(rasterization.depthClampEnable);
+            writer.add(rasterization.rasterizerDiscardEnable);
+            writer.add(rasterization.polygonMode);
+            writer.add(rasterization.cullMode);
+            writer.add(rasterization.frontFace);
+            writer.add(rasterization.depthBiasEnable);
+            writer.add(rasterization.depthBiasConstantFactor);
+            writer.add(rasterization.depthBiasClamp);
+            writer.add(rasterization.depthBiasSlopeFactor);
+            writer.add(rasterization.lineWidth);
+        }
+
+        void addMultisampleState(KeyWriter &writer, const PipelineConfigInfo &configInfo) {
+            const auto &multisample = configInfo.multisampleInfo;
+            writer.add(multisample.flags);
+            writer.add(multisample.rasterizationSamples);
+            writer.add(multisample.sampleShadingEnable);
+            writer.add(multisample.minSampleShading);
+            if (multisample.pSampleMask != nullptr) {
+                // One bit per sample.
+                writer.addArray(multisample.pSampleMask,
+                                (static_cast<size_t>(multisample.rasterizationSamples) + 31) / 32);
+            }
+            writer.add(multisample.alphaToCoverageEnable);
+            writer.add(multisample.alphaToOneEnable);
+        }
+
+        void addFragmentShaderState(KeyWriter &writer,
+                                    ShaderCode fragCode,
+                                    const PipelineConfigInfo &configInfo) {
+            writer.addShader(fragCode);
+            writer.addSpecialization(configInfo.fragmentSpecialization);
+            addMultisampleState(writer, configInfo);
+
+            const auto &depthStencil = configInfo.depthStencilInfo;
+            writer.add(depthStencil.flags);
+            writer.add(depthStencil.depthTestEnable);
+            writer.add(depthStencil.depthWriteEnable);
+            writer.add(depthStencil.depthCompareOp);
+            writer.add(depthStencil.depthBoundsTestEnable);
+            writer.add(depthStencil.stencilTestEnable);
+            writer.add(depthStencil.front);
+            writer.add(depthStencil.back);
+            writer.add(depthStencil.minDepthBounds);
+            writer.add(depthStencil.maxDepthBounds);
+        }
+
+        void addFragmentOutputState(KeyWriter &writer, const PipelineConfigInfo &configInfo) {
+            addMultisampleState(writer, configInfo);
+
+            const auto &colorBlend = configInfo.colorBlendInfo;
+            writer.add(colorBlend.flags);
+            writer.add(colorBlend.logicOpEnable);
+            writer.add(colorBlend.logicOp);
+            writer.addArray(colorBlend.pAttachments, colorBlend.attachmentCount);
+            writer.add(colorBlend.blendConstants);
+        }
+
+        std::string makeKey(ShaderCode vertCode,
+                            ShaderCode fragCode,
+                            const PipelineConfigInfo &configInfo) {
+            KeyWriter writer;
+            addCommonState(writer, configInfo);
+            addVertexInputState(writer, configInfo);
+            addPreRasterizationState(writer, vertCode, configInfo);
+            addFragmentShaderState(writer, fragCode, configInfo);
+            addFragmentOutputState(writer, configInfo);
+            return std::move(writer.key);
+        }
+
+        constexpr VkGraphicsPipelineLibraryFlagBitsEXT LIBRARY_PARTS[] = {
+            VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+            VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+            VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+            VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT};
+
+        // The key of a library only covers its part of the description, so that pipelines
+        // which differ elsewhere share it.
+        std::string makeLibraryKey(VkGraphicsPipelineLibraryFlagBitsEXT part,
+                                   ShaderCode vertCode,
+                                   ShaderCode fragCode,
+                                   const PipelineConfigInfo &configInfo) {
+            KeyWriter writer;
+            writer.add(part);
+            addCommonState(writer, configInfo);
+            switch (part) {
+                case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+                    addVertexInputState(writer, configInfo);
+                    break;
+                case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+                    addPreRasterizationState(writer, vertCode, configInfo);
+                    break;
+                case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+                    addFragmentShaderState(writer, fragCode, configInfo);
+                    break;
+                default:
+                    addFragmentOutputState(writer, configInfo);
+                    break;
+            }
+            return std::move(writer.key);
+        }
+
+        // The full create info reduced to the state of one library part.
+        VkGraphicsPipelineCreateInfo makeLibraryInfo(const VkGraphicsPipelineCreateInfo &full,
+                                                     VkGraphicsPipelineLibraryFlagBitsEXT part) {
+            VkGraphicsPipelineCreateInfo info{};
+            info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+            // The dynamic rendering formats, if any.
+            info.pNext = full.pNext;
+            info.pDynamicState = full.pDynamicState;
+            info.basePipelineHandle = VK_NULL_HANDLE;
+            info.basePipelineIndex = -1;
+            switch (part) {
+                case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+                    info.pNext = nullptr;
+                    info.pVertexInputState = full.pVertexInputState;
+                    info.pInputAssemblyState = full.pInputAssemblyState;
+                    return info;
+                case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+                    // The vertex shader is always the first stage.
+                    info.stageCount = 1;
+                    info.pStages = full.pStages;
+                    info.pViewportState = full.pViewportState;
+                    info.pRasterizationState = full.pRasterizationState;
+                    info.layout = full.layout;
+                    break;
+                case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+                    // Without a fragment shader, e.g. for a depth pre-pass, the library is empty
+                    // apart from its state.
+                    info.stageCount = full.stageCount - 1;
+                    info.pStages = info.stageCount > 0 ? full.pStages + 1 : nullptr;
+                    info.pMultisampleState = full.pMultisampleState;
+                    info.pDepthStencilState = full.pDepthStencilState;
+                    info.layout = full.layout;
+                    break;
+                default:
+                    info.pMultisampleState = full.pMultisampleState;
+                    info.pColorBlendState = full.pColorBlendState;
+                    break;
+            }
+            info.renderPass = full.renderPass;
+            info.subpass = full.subpass;
+            return info;
+        }
+    }  // namespace
+
+    LVEPipelineManager::LVEPipelineManager(LVEDevice &device, LVEThreadPool *threadPool)
+        : lveDevice{device}, threadPool{threadPool}, builder{device, threadPool} {}
+
+    LVEPipelineManager::~LVEPipelineManager() {
+        waitForCompiles(true);
+        releaseShaderModules();
+        // Linked pipelines do not depend on their libraries staying alive.
+        for (const auto &[key, library] : libraries) {
+            if (library.get() != VK_NULL_HANDLE) {
+                vkDestroyPipeline(lveDevice.device(), library.get(), nullptr);
+            }
+        }
+    }
+
+    LVEPipelineManager::PipelineHandle LVEPipelineManager::request(
+        const std::string &name,
+        ShaderCode vertCode,
+        ShaderCode fragCode,
+        std::unique_ptr<PipelineConfigInfo> configInfo) {
+        assert(configInfo != nullptr && "Cannot request a pipeline without a configuration");
+        std::string key = makeKey(vertCode, fragCode, *configInfo);
+
+        std::unique_lock<std::mutex> lock{mutex};
+        if (const auto it = entryIndices.find(key); it != entryIndices.end()) {
+            Entry &entry = entries[it->second];
+            entry.report.hits++;
+            hits++;
+            return entry.pipeline;
+        }
+
+        const VkShaderModule vertModule = getShaderModule(vertCode);
+        const VkShaderModule fragModule =
+            fragCode.empty() ? VK_NULL_HANDLE : getShaderModule(fragCode);
+        std::promise<SharedPipeline> pipeline;
+        const size_t entryIndex = entries.size();
+        entries.push_back({pipeline.get_future().share(), {name}});
+        entryIndices.emplace(std::move(key), entryIndex);
+        PipelineHandle handle = entries.back().pipeline;
+        lock.unlock();
+
+        if (lveDevice.supportsGraphicsPipelineLibrary()) {
+            LibraryKeys libraryKeys;
+            for (size_t i = 0; i < libraryKeys.size(); i++) {
+                libraryKeys[i] = makeLibraryKey(LIBRARY_PARTS[i], vertCode, fragCode, *configInfo);
+            }
+            // Linking compiled libraries is fast enough for the caller's thread. Compiling them
+            // is not, so that happens in the background, like whole pipelines without libraries.
+            if (threadPool == nullptr || librariesReady(libraryKeys)) {
+                linkFromLibraries(entryIndex,
+                                  libraryKeys,
+                                  vertModule,
+                                  fragModule,
+                                  *configInfo,
+                                  pipeline,
+                                  threadPool != nullptr);
+                return handle;
+            }
+            auto backgroundLink = threadPool->submit([this,
+                                                      entryIndex,
+                                                      libraryKeys = std::move(libraryKeys),
+                                                      vertModule,
+                                                      fragModule,
+                                                      configInfo = std::move(configInfo),
+                                                      pipeline = std::move(pipeline)]() mutable {
+                // Already on the thread pool, so the optimized link can follow right here.
+                linkFromLibraries(
+                    entryIndex, libraryKeys, vertModule, fragModule, *configInfo, pipeline, false);
+            });
+            std::lock_guard<std::mutex> backgroundLock{mutex};
+            backgroundLinks.push_back(std::move(backgroundLink));
+            return handle;
+        }
+        compile(entryIndex, vertModule, fragModule, std::move(configInfo), std::move(pipeline));
+        return handle;
+    }
+
+    VkShaderModule LVEPipelineManager::getShaderModule(ShaderCode code) {
+        const ShaderKey key{code.data(), code.size()};
+        if (const auto it = shaderModules.find(key); it != shaderModules.end()) {
+            return it->second;
+        }
+        const VkShaderModule shaderModule = LVEPipeline::createShaderModule(lveDevice, code);
+        shaderModules.emplace(key, shaderModule);
+        return shaderModule;
+    }
+
+    void LVEPipelineManager::compile(size_t entryIndex,
+                                     VkShaderModule vertModule,
+                                     VkShaderModule fragModule,
+                                     std::unique_ptr<PipelineConfigInfo> configInfo,
+                                     std::promise<SharedPipeline> pipeline) {
+        // Completions have to be copyable, so the promise is shared.
+        auto sharedPipeline = std::make_shared<std::promise<SharedPipeline>>(std::move(pipeline));
+        auto completion = [this, entryIndex, sharedPipeline](std::unique_ptr<LVEPipeline> created,
+                                                             std::exception_ptr error,
+                                                             std::chrono::nanoseconds duration) {
+            if (error != nullptr) {
+                sharedPipeline->set_exception(error);
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                entries[entryIndex].report.compileTimeMs =
+                    std::chrono::duration<double, std::milli>(duration).count();
+                entries[entryIndex].report.optimized = true;
+            }
+            sharedPipeline->set_value(std::move(created));
+        };
+
+        // With a thread pool, the builder starts the pipeline on it right away and build()
+        // returns immediately. Without one, build() creates it on this thread.
+        std::lock_guard<std::mutex> lock{builderMutex};
+        builder.add(vertModule, fragModule, std::move(configInfo), std::move(completion));
+        builder.build();
+    }
+
+    bool LVEPipelineManager::librariesReady(const LibraryKeys &libraryKeys) const {
+        std::lock_guard<std::mutex> lock{libraryMutex};
+        for (const auto &key : libraryKeys) {
+            const auto it = libraries.find(key);
+            if (it == libraries.end() ||
+                it->second.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void LVEPipelineManager::linkFromLibraries(size_t entryIndex,
+                                               const LibraryKeys &libraryKeys,
+                                               VkShaderModule vertModule,
+                                               VkShaderModule fragModule,
+                                               const PipelineConfigInfo &configInfo,
+                                               std::promise<SharedPipeline> &pipeline,
+                                               bool optimizeInBackground) {
+        SharedPipeline linkedPipeline;
+        Libraries parts{};
+        try {
+            const auto start = std::chrono::steady_clock::now();
+            const GraphicsPipelineCreateInfo createInfo{
+                lveDevice, vertModule, fragModule, configInfo};
+            for (size_t i = 0; i < parts.size(); i++) {
+                parts[i] = getLibrary(LIBRARY_PARTS[i], libraryKeys[i], createInfo.get());
+            }
+            const VkPipeline graphicsPipeline = link(parts, configInfo.pipelineLayout, false);
+            const auto duration = std::chrono::steady_clock::now() - start;
+            lveDevice.recordPipelineCreation(duration);
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                entries[entryIndex].report.linkTimeMs =
+                    std::chrono::duration<double, std::milli>(duration).count();
+            }
+            linkedPipeline.reset(new LVEPipeline(lveDevice, graphicsPipeline, configInfo));
+        } catch (...) {
+            pipeline.set_exception(std::current_exception());
+            return;
+        }
+        pipeline.set_value(linkedPipeline);
+
+        const VkPipelineLayout layout = configInfo.pipelineLayout;
+        if (!optimizeInBackground) {
+            optimize(entryIndex, parts, layout, linkedPipeline);
+            return;
+        }
+        std::lock_guard<std::mutex> lock{mutex};
+        backgroundLinks.push_back(
+            threadPool->submit([this, entryIndex, parts, layout, linkedPipeline]() {
+                optimize(entryIndex, parts, layout, linkedPipeline);
+            }));
+    }
+
+    void LVEPipelineManager::optimize(size_t entryIndex,
+                                      const Libraries &parts,
+                                      VkPipelineLayout layout,
+                                      const SharedPipeline &pipeline) {
+        const auto start = std::chrono::steady_clock::now();
+        VkPipeline optimizedPipeline;
+        try {
+            optimizedPipeline = link(parts, layout, true);
+        } catch (const std::exception &e) {
+            // The quickly linked pipeline works as well, only slower.
+            std::lock_guard<std::mutex> lock{mutex};
+            entries[entryIndex].report.optimizeError = e.what();
+            return;
+        }
+        const auto duration = std::chrono::steady_clock::now() - start;
+        pipeline->replace(optimizedPipeline);
+
+        std::lock_guard<std::mutex> lock{mutex};
+        entries[entryIndex].report.compileTimeMs =
+            std::chrono::duration<double, std::milli>(duration).count();
+        entries[entryIndex].report.optimized = true;
+    }
+
+    VkPipeline LVEPipelineManager::getLibrary(VkGraphicsPipelineLibraryFlagBitsEXT part,
+                                              std::string key,
+                                              const VkGraphicsPipelineCreateInfo &pipelineInfo) {
+        std::unique_lock<std::mutex> lock{libraryMutex};
+        if (const auto it = libraries.find(key); it != libraries.end()) {
+            // Possibly still being compiled for another request. Waited for without the lock,
+            // so that requests for other libraries go ahead.
+            const LibraryHandle existing = it->second;
+            lock.unlock();
+            if (existing.get() == VK_NULL_HANDLE) {
+                throw std::runtime_error("Failed to create graphics pipeline library");
+            }
+            return existing.get();
+        }
+        std::promise<VkPipeline> compiled;
+        libraries.emplace(std::move(key), compiled.get_future().share());
+        lock.unlock();
+
+        VkGraphicsPipelineCreateInfo libraryInfo = makeLibraryInfo(pipelineInfo, part);
+        VkGraphicsPipelineLibraryCreateInfoEXT libraryPart{};
+        libraryPart.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+        libraryPart.pNext = libraryInfo.pNext;
+        libraryPart.flags = part;
+        libraryInfo.pNext = &libraryPart;
+        // Keeps what the optimized link needs to optimize across the libraries.
+        libraryInfo.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR |
+                            VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+        VkPipeline library;
+        if (vkCreateGraphicsPipelines(lveDevice.device(),
+                                      lveDevice.getPipelineCache(),
+                                      1,
+                                      &libraryInfo,
+                                      nullptr,
+                                      &library) != VK_SUCCESS) {
+            // Requests waiting for it fail as well, and it is not compiled again.
+            compiled.set_value(VK_NULL_HANDLE);
+            throw std::runtime_error("Failed to create graphics pipeline library");
+        }
+        compiled.set_value(library);
+        return library;
+    }
+
+    VkPipeline LVEPipelineManager::link(const Libraries &parts,
+                                        VkPipelineLayout layout,
+                                        bool optimized) {
+        VkPipelineLibraryCreateInfoKHR libraryInfo{};
+        libraryInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+        libraryInfo.libraryCount = static_cast<uint32_t>(parts.size());
+        libraryInfo.pLibraries = parts.data();
+
+        VkGraphicsPipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.pNext = &libraryInfo;
+        pipelineInfo.flags = optimized ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+        pipelineInfo.layout = layout;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+        pipelineInfo.basePipelineIndex = -1;
+
+        VkPipeline pipeline;
+        if (vkCreateGraphicsPipelines(lveDevice.device(),
+                                      lveDevice.getPipelineCache(),
+                                      1,
+                                      &pipelineInfo,
+                                      nullptr,
+                                      &pipeline) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to link graphics pipeline");
+        }
+        return pipeline;
+    }
+
+    void LVEPipelineManager::waitForCompiles(bool includeBackgroundLinks) {
+        std::vector<PipelineHandle> pending;
+        std::vector<std::future<void>> pendingLinks;
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            pending.reserve(entries.size());
+            for (const auto &entry : entries) {
+                pending.push_back(entry.pipeline);
+            }
+            if (includeBackgroundLinks) {
+                pendingLinks = std::move(backgroundLinks);
+                backgroundLinks.clear();
+            }
+        }
+        // Without the lock, since the compiles take it to store their time.
+        for (const auto &pipeline : pending) {
+            pipeline.wait();
+        }
+        for (auto &link : pendingLinks) {
+            link.wait();
+        }
+    }
+
+    void LVEPipelineManager::releaseShaderModules() {
+        // Optimized links only use the libraries.
+        waitForCompiles(false);
+        std::lock_guard<std::mutex> lock{mutex};
+        for (const auto &[key, shaderModule] : shaderModules) {
+            vkDestroyShaderModule(lveDevice.device(), shaderModule, nullptr);
+        }
+        shaderModules.clear();
+    }
+
+    LVEPipelineManager::Stats LVEPipelineManager::getStats() const {
+        std::lock_guard<std::mutex> lock{mutex};
+        Stats stats{};
+        stats.hits = hits;
+        stats.misses = static_cast<uint32_t>(entries.size());
+        stats.shaderModules = static_cast<uint32_t>(shaderModules.size());
+        {
+            std::lock_guard<std::mutex> libraryLock{libraryMutex};
+            stats.libraries = static_cast<uint32_t>(libraries.size());
+        }
+        stats.pipelines.reserve(entries.size());
+        for (const auto &entry : entries) {
+            stats.pipelines.push_back(entry.report);
+        }
+        return stats;
+    }
+}  // namespace lve
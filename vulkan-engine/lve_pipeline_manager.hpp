@@ -0,0 +1,176 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "lve_device.hpp"
+#include "lve_pipeline.hpp"
+#include "lve_pipeline_builder.hpp"
+#include "lve_thread_pool.hpp"
+
+namespace lve {
+    /**
+     * @brief Hands out graphics pipelines by their full description, so that render systems
+     * asking for the same state share one pipeline instead of compiling it again. The key covers
+     * every field of the PipelineConfigInfo, including the specialization constants and the
+     * render target formats, and the shader code. Shader modules are created once per shader and
+     * shared by all pipelines that use it.
+     *
+     * Requests are thread safe. A request for a pipeline that is still being compiled gets the
+     * handle of that compile instead of starting another one.
+     *
+     * With VK_EXT_graphics_pipeline_library, a pipeline is put together from four separately
+     * compiled libraries: vertex input, pre-rasterization shaders, fragment shader and fragment
+     * output. Libraries are cached by the part of the description they depend on, so new
+     * combinations of known shaders and states only have to be linked. The first link skips
+     * link time optimization and is fast enough to happen in request() while the app is running,
+     * if all four libraries exist. Otherwise the missing ones are compiled on the thread pool and
+     * the handle becomes ready after the link that follows. Every library is compiled once, by
+     * the first request that needs it, and other requests only wait for the ones they share.
+     * The optimized pipeline is linked in the background and swapped in once it is ready.
+     * Without the extension, whole pipelines are compiled in the background by an
+     * LVEPipelineBuilder, and the handle only becomes ready when they are done.
+     */
+    class LVEPipelineManager {
+       public:
+        using SharedPipeline = std::shared_ptr<LVEPipeline>;
+        // Holds the pipeline once it is compiled, or rethrows why it could not be. Failed
+        // pipelines are not compiled again.
+        using PipelineHandle = std::shared_future<SharedPipeline>;
+
+        struct PipelineReport {
+            // Given by the first request.
+            std::string name;
+            // Requests after the first one.
+            uint32_t hits = 0;
+            // Until a usable pipeline existed, including compiling missing libraries. Only for
+            // pipelines linked from libraries.
+            double linkTimeMs = 0.0;
+            // Of the whole pipeline, or of the optimized link from libraries. 0 until it is done.
+            double compileTimeMs = 0.0;
+            // Whether the pipeline in use is the fully optimized one.
+            bool optimized = false;
+            // Why the optimized link failed, empty unless it did. The quickly linked pipeline
+            // stays in use.
+            std::string optimizeError;
+        };
+        struct Stats {
+            uint32_t hits = 0;
+            uint32_t misses = 0;
+            uint32_t shaderModules = 0;
+            uint32_t libraries = 0;
+            // In the order they were first requested.
+            std::vector<PipelineReport> pipelines;
+        };
+
+        // Misses are compiled on threadPool if it is given, otherwise in request() itself.
+        explicit LVEPipelineManager(LVEDevice &device, LVEThreadPool *threadPool = nullptr);
+        // Waits for compiles that are still running. Pipelines that were handed out stay valid.
+        ~LVEPipelineManager();
+
+        LVEPipelineManager(const LVEPipelineManager &) = delete;
+        LVEPipelineManager &operator=(const LVEPipelineManager &) = delete;
+
+        // Shader code is identified by its address and size, which is unique for the embedded
+        // shaders, and has to stay alive as long as the manager. The configuration is taken over,
+        // since a miss may be compiled after the caller moved on.
+        PipelineHandle request(const std::string &name,
+                               ShaderCode vertCode,
+                               ShaderCode fragCode,
+                               std::unique_ptr<PipelineConfigInfo> configInfo);
+        // Waits for the pipeline.
+        SharedPipeline get(const std::string &name,
+                           ShaderCode vertCode,
+                           ShaderCode fragCode,
+                           std::unique_ptr<PipelineConfigInfo> configInfo) {
+            return request(name, vertCode, fragCode, std::move(configInfo)).get();
+        }
+        // The pipeline if it is ready, nullptr if it is still compiling. For callers that must
+        // not wait, e.g. to skip draws with a new material until its pipeline exists. Rethrows
+        // every time if the compile failed, so callers of optional pipelines should drop the
+        // handle then.
+        static SharedPipeline getIfReady(const PipelineHandle &handle) {
+            if (handle.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+                return nullptr;
+            }
+            return handle.get();
+        }
+
+        // Waits for the running compiles, apart from optimized links, and destroys the shader
+        // modules, which pipelines and libraries do not need once they exist. Later misses create
+        // them again. Must not be called concurrently with request().
+        void releaseShaderModules();
+
+        Stats getStats() const;
+
+       private:
+        struct Entry {
+            PipelineHandle pipeline;
+            PipelineReport report;
+        };
+        using ShaderKey = std::pair<const uint32_t *, size_t>;
+        // One per VkGraphicsPipelineLibraryFlagBitsEXT.
+        using Libraries = std::array<VkPipeline, 4>;
+        using LibraryKeys = std::array<std::string, 4>;
+        // VK_NULL_HANDLE if the library could not be compiled.
+        using LibraryHandle = std::shared_future<VkPipeline>;
+
+        // Expects the mutex to be held.
+        VkShaderModule getShaderModule(ShaderCode code);
+        void compile(size_t entryIndex,
+                     VkShaderModule vertModule,
+                     VkShaderModule fragModule,
+                     std::unique_ptr<PipelineConfigInfo> configInfo,
+                     std::promise<SharedPipeline> pipeline);
+        // Whether all of the libraries are compiled, so that linking them does not wait.
+        bool librariesReady(const LibraryKeys &libraryKeys) const;
+        // Links the pipeline from libraries, compiling those that are missing, and then links
+        // the optimized pipeline, on the thread pool if optimizeInBackground is set.
+        void linkFromLibraries(size_t entryIndex,
+                               const LibraryKeys &libraryKeys,
+                               VkShaderModule vertModule,
+                               VkShaderModule fragModule,
+                               const PipelineConfigInfo &configInfo,
+                               std::promise<SharedPipeline> &pipeline,
+                               bool optimizeInBackground);
+        void optimize(size_t entryIndex,
+                      const Libraries &libraries,
+                      VkPipelineLayout layout,
+                      const SharedPipeline &pipeline);
+        VkPipeline getLibrary(VkGraphicsPipelineLibraryFlagBitsEXT part,
+                              std::string key,
+                              const VkGraphicsPipelineCreateInfo &pipelineInfo);
+        VkPipeline link(const Libraries &libraries, VkPipelineLayout layout, bool optimized);
+        void waitForCompiles(bool includeBackgroundLinks);
+
+        LVEDevice &lveDevice;
+        LVEThreadPool *threadPool;
+
+        mutable std::mutex mutex;
+        // Indices into entries, by the serialized description.
+        std::unordered_map<std::string, size_t> entryIndices;
+        std::vector<Entry> entries;
+        std::map<ShaderKey, VkShaderModule> shaderModules;
+        // Links from libraries that had to be compiled first, and optimized links. Both may
+        // still run after the handle of their pipeline is ready.
+        std::vector<std::future<void>> backgroundLinks;
+        uint32_t hits = 0;
+
+        // Compiles the misses without the extension. Not thread safe on its own.
+        std::mutex builderMutex;
+        LVEPipelineBuilder builder;
+
+        // Only held to look up and add libraries, not while they are compiled.
+        mutable std::mutex libraryMutex;
+        std::unordered_map<std::string, LibraryHandle> libraries;
+    };
+}  // namespace lve
@@ -0,0 +1,899 @@
+#include "lve_render_graph.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+#include <stdexcept>
+
+namespace lve {
+
+    // *************** Pass Builder *********************
+
+    LVERenderGraph::PassBuilder &LVERenderGraph::PassBuilder::writeColor(
+        RenderGraphResource resource, const VkClearColorValue *clearValue) {
+        Access access{resource, AccessType::ColorAttachment, 0, clearValue != nullptr, {}};
+        if (clearValue != nullptr) {
+            access.clearValue.color = *clearValue;
+        }
+        return graph.addAccess(*this, access);
+    }
+
+    LVERenderGraph::PassBuilder &LVERenderGraph::PassBuilder::writeDepth(
+        RenderGraphResource resource, const VkClearDepthStencilValue *clearValue) {
+        Access access{resource, AccessType::DepthAttachment, 0, clearValue != nullptr, {}};
+        if (clearValue != nullptr) {
+            access.clearValue.depthStencil = *clearValue;
+        }
+        return graph.addAccess(*this, access);
+    }
+
+    LVERenderGraph::PassBuilder &LVERenderGraph::PassBuilder::readDepth(
+        RenderGraphResource resource) {
+        return graph.addAccess(*this, {resource, AccessType::DepthReadOnly, 0, false, {}});
+    }
+
+    LVERenderGraph::PassBuilder &LVERenderGraph::PassBuilder::sample(
+        RenderGraphResource resource, VkPipelineStageFlags stages) {
+        return graph.addAccess(*this, {resource, AccessType::Sampled, stages, false, {}});
+    }
+
+    LVERenderGraph::PassBuilder &LVERenderGraph::PassBuilder::readStorage(
+        RenderGraphResource resource, VkPipelineStageFlags stages) {
+        return graph.addAccess(*this, {resource, AccessType::StorageRead, stages, false, {}});
+    }
+
+    LVERenderGraph::PassBuilder &LVERenderGraph::PassBuilder::writeStorage(
+        RenderGraphResource resource, VkPipelineStageFlags stages) {
+        return graph.addAccess(*this, {resource, AccessType::StorageWrite, stages, false, {}});
+    }
+
+    LVERenderGraph::PassBuilder &LVERenderGraph::PassBuilder::readTransfer(
+        RenderGraphResource resource) {
+        return graph.addAccess(*this, {resource, AccessType::TransferRead, 0, false, {}});
+    }
+
+    LVERenderGraph::PassBuilder &LVERenderGraph::PassBuilder::writeTransfer(
+        RenderGraphResource resource) {
+        // Like a clear, the previous contents are not needed.
+        return graph.addAccess(*this, {resource, AccessType::TransferWrite, 0, true, {}});
+    }
+
+    LVERenderGraph::PassBuilder &LVERenderGraph::PassBuilder::useSecondaryCommandBuffers() {
+        graph.passes[passIndex].contents = VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS;
+        return *this;
+    }
+
+    LVERenderGraph::PassBuilder &LVERenderGraph::PassBuilder::setSideEffects() {
+        graph.passes[passIndex].sideEffects = true;
+        return *this;
+    }
+
+    LVERenderGraph::PassBuilder &LVERenderGraph::PassBuilder::record(
+        std::function<void(const RenderGraphPassContext &)> callback) {
+        graph.passes[passIndex].callback = std::move(callback);
+        return *this;
+    }
+
+    // *************** Render Graph *********************
+
+    LVERenderGraph::LVERenderGraph(LVEDevice &device, bool dynamicRendering)
+        : lveDevice{device}, dynamicRendering{dynamicRendering} {}
+
+    LVERenderGraph::~LVERenderGraph() {
+        for (auto &frame : frames) {
+            destroyTransientImages(frame);
+            for (auto framebuffer : frame.framebuffers) {
+                vkDestroyFramebuffer(lveDevice.device(), framebuffer, nullptr);
+            }
+        }
+        for (auto &kv : renderPasses) {
+            vkDestroyRenderPass(lveDevice.device(), kv.second, nullptr);
+        }
+    }
+
+    void LVERenderGraph::beginFrame(int frameIndex) {
+        passes.clear();
+        resources.clear();
+        stats = {};
+        currentFrameIndex = frameIndex;
+        if (frames.size() <= static_cast<size_t>(frameIndex)) {
+            frames.resize(frameIndex + 1);
+        }
+
+        // The GPU is done with the last frame that had this index.
+        auto &frame = frames[currentFrameIndex];
+        for (auto framebuffer : frame.framebuffers) {
+            vkDestroyFramebuffer(lveDevice.device(), framebuffer, nullptr);
+        }
+        frame.framebuffers.clear();
+    }
+
+    RenderGraphResource LVERenderGraph::importImage(const std::string &name,
+                                                    const ImportedImage &image) {
+        Resource resource{};
+        resource.name = name;
+        resource.format = image.format;
+        resource.extent = image.extent;
+        resource.imported = true;
+        resource.importedImage = image;
+        resources.push_back(resource);
+        return static_cast<RenderGraphResource>(resources.size() - 1);
+    }
+
+    RenderGraphResource LVERenderGraph::createImage(const std::string &name,
+                                                    const ImageDesc &desc) {
+        Resource resource{};
+        resource.name = name;
+        resource.format = desc.format;
+        resource.extent = desc.extent;
+        resource.imported = false;
+        resources.push_back(resource);
+        return static_cast<RenderGraphResource>(resources.size() - 1);
+    }
+
+    LVERenderGraph::PassBuilder LVERenderGraph::addPass(const std::string &name) {
+        Pass pass{};
+        pass.name = name;
+        passes.push_back(std::move(pass));
+        return PassBuilder{*this, static_cast<uint32_t>(passes.size() - 1)};
+    }
+
+    void LVERenderGraph::addBlitPass(const std::string &name,
+                                     RenderGraphResource source,
+                                     RenderGraphResource destination,
+                                     VkFilter filter) {
+        addPass(name)
+            .readTransfer(source)
+            .writeTransfer(destination)
+            .record([this, source, destination, filter](const RenderGraphPassContext &context) {
+                const VkExtent2D srcExtent = resources[source].extent;
+                const VkExtent2D dstExtent = resources[destination].extent;
+                VkImageBlit region{};
+                region.srcSubresource = {aspectFor(resources[source].format), 0, 0, 1};
+                region.srcOffsets[1] = {static_cast<int32_t>(srcExtent.width),
+                                        static_cast<int32_t>(srcExtent.height),
+                                        1};
+                region.dstSubresource = {aspectFor(resources[destination].format), 0, 0, 1};
+                region.dstOffsets[1] = {static_cast<int32_t>(dstExtent.width),
+                                        static_cast<int32_t>(dstExtent.height),
+                                        1};
+                vkCmdBlitImage(context.commandBuffer,
+                               getImage(source),
+                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               getImage(destination),
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               1,
+                               &region,
+                               filter);
+            });
+    }
+
+    LVERenderGraph::PassBuilder &LVERenderGraph::addAccess(PassBuilder &builder,
+                                                           const Access &access) {
+        assert(access.resource < resources.size() && "Unknown render graph resource");
+        auto &pass = passes[builder.passIndex];
+        for (auto &other : pass.accesses) {
+            assert(other.resource != access.resource &&
+                   "A pass can only access a resource in one way");
+        }
+        for (auto &other : pass.accesses) {
+            assert((!isAttachment(access.type) || !isAttachment(other.type) ||
+                    (resources[access.resource].extent.width ==
+                         resources[other.resource].extent.width &&
+                     resources[access.resource].extent.height ==
+                         resources[other.resource].extent.height)) &&
+                   "Attachments of a pass must have the same size");
+        }
+        pass.accesses.push_back(access);
+        return builder;
+    }
+
+    void LVERenderGraph::execute(VkCommandBuffer commandBuffer, LVEPassProfiler *profiler) {
+        stats.passCount = static_cast<uint32_t>(passes.size());
+        cullPasses();
+        computeLifetimes();
+        createTransientImages();
+
+        states.assign(resources.size(), ResourceState{});
+        for (size_t i = 0; i < resources.size(); i++) {
+            if (resources[i].imported) {
+                const auto &image = resources[i].importedImage;
+                // Whatever made the image ready counts as its last write.
+                states[i].layout = image.initialLayout;
+                states[i].writeStages = image.initialStages;
+                states[i].hasContents = image.initialLayout != VK_IMAGE_LAYOUT_UNDEFINED;
+            }
+        }
+        blockStates.assign(frames[currentFrameIndex].blocks.size(), ResourceState{});
+
+        for (uint32_t i = 0; i < static_cast<uint32_t>(passes.size()); i++) {
+            if (passes[i].culled) {
+                continue;
+            }
+            if (profiler != nullptr) {
+                profiler->beginPass(commandBuffer, passes[i].name);
+            }
+            recordPass(commandBuffer, i);
+            if (profiler != nullptr) {
+                profiler->endPass(commandBuffer);
+            }
+        }
+
+        // Hand the outputs over in the layouts they are expected in, again in a single barrier.
+        VkPipelineStageFlags srcStages = 0;
+        std::vector<VkImageMemoryBarrier> barriers;
+        for (size_t i = 0; i < resources.size(); i++) {
+            const auto &resource = resources[i];
+            if (!resource.imported ||
+                resource.importedImage.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED ||
+                resource.importedImage.finalLayout == states[i].layout) {
+                continue;
+            }
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.oldLayout = states[i].layout;
+            barrier.newLayout = resource.importedImage.finalLayout;
+            barrier.srcAccessMask = states[i].writeAccess;
+            barrier.dstAccessMask = 0;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = resource.importedImage.image;
+            barrier.subresourceRange = {aspectFor(resource.format), 0, 1, 0, 1};
+            barriers.push_back(barrier);
+            srcStages |= states[i].writeStages | states[i].readStages;
+        }
+        if (!barriers.empty()) {
+            vkCmdPipelineBarrier(commandBuffer,
+                                 srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                 VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                 0,
+                                 0,
+                                 nullptr,
+                                 0,
+                                 nullptr,
+                                 static_cast<uint32_t>(barriers.size()),
+                                 barriers.data());
+            stats.barrierBatchCount++;
+            stats.imageBarrierCount += static_cast<uint32_t>(barriers.size());
+        }
+    }
+
+    void LVERenderGraph::cullPasses() {
+        // Walk backwards from the outputs. A pass is needed if it writes contents that are still
+        // needed at that point. Its reads are then needed from earlier passes, unless it
+        // overwrites a resource completely.
+        std::vector<bool> needed(resources.size(), false);
+        for (size_t i = 0; i < resources.size(); i++) {
+            needed[i] = resources[i].imported &&
+                        resources[i].importedImage.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED;
+        }
+
+        for (size_t p = passes.size(); p-- > 0;) {
+            auto &pass = passes[p];
+            bool alive = pass.sideEffects;
+            for (auto &access : pass.accesses) {
+                alive = alive || (isWrite(access.type) && needed[access.resource]);
+            }
+            pass.culled = !alive;
+            if (!alive) {
+                stats.culledPassCount++;
+                continue;
+            }
+
+            pass.storeAccess.resize(pass.accesses.size());
+            for (size_t i = 0; i < pass.accesses.size(); i++) {
+                pass.storeAccess[i] = needed[pass.accesses[i].resource];
+            }
+            for (auto &access : pass.accesses) {
+                // Anything but a clear builds on what was there before.
+                needed[access.resource] = !isWrite(access.type) || !access.clear;
+            }
+        }
+    }
+
+    void LVERenderGraph::computeLifetimes() {
+        for (uint32_t p = 0; p < static_cast<uint32_t>(passes.size()); p++) {
+            if (passes[p].culled) {
+                continue;
+            }
+            for (auto &access : passes[p].accesses) {
+                auto &resource = resources[access.resource];
+                resource.firstPass = std::min(resource.firstPass, p);
+                resource.lastPass = std::max(resource.lastPass, p);
+                resource.usage |= usageFor(access.type);
+            }
+        }
+    }
+
+    void LVERenderGraph::createTransientImages() {
+        auto &frame = frames[currentFrameIndex];
+
+        std::vector<uint64_t> layoutKey;
+        std::vector<uint32_t> transients;
+        for (uint32_t i = 0; i < static_cast<uint32_t>(resources.size()); i++) {
+            auto &resource = resources[i];
+            if (resource.imported || resource.firstPass == UINT32_MAX) {
+                continue;
+            }
+            resource.physicalIndex = static_cast<uint32_t>(transients.size());
+            transients.push_back(i);
+            layoutKey.push_back(resource.format);
+            layoutKey.push_back(static_cast<uint64_t>(resource.extent.width) << 32 |
+                                resource.extent.height);
+            layoutKey.push_back(resource.usage);
+            layoutKey.push_back(static_cast<uint64_t>(resource.firstPass) << 32 |
+                                resource.lastPass);
+        }
+        stats.transientImageCount = static_cast<uint32_t>(transients.size());
+
+        // The same graph as last time, which is the common case.
+        if (layoutKey != frame.layoutKey) {
+            destroyTransientImages(frame);
+            frame.layoutKey = layoutKey;
+            frame.images.resize(transients.size());
+
+            std::vector<VkMemoryRequirements> requirements(transients.size());
+            for (size_t t = 0; t < transients.size(); t++) {
+                const auto &resource = resources[transients[t]];
+                VkImageCreateInfo imageInfo{};
+                imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+                imageInfo.imageType = VK_IMAGE_TYPE_2D;
+                imageInfo.extent = {resource.extent.width, resource.extent.height, 1};
+                imageInfo.mipLevels = 1;
+                imageInfo.arrayLayers = 1;
+                imageInfo.format = resource.format;
+                imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+                imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                imageInfo.usage = resource.usage;
+                imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+                imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+                if (vkCreateImage(
+                        lveDevice.device(), &imageInfo, nullptr, &frame.images[t].image) !=
+                    VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create transient image " + resource.name);
+                }
+                vkGetImageMemoryRequirements(
+                    lveDevice.device(), frame.images[t].image, &requirements[t]);
+            }
+
+            // Greedy aliasing: Largest images first, each into the first block whose images are
+            // all dead while it is alive. Every image is bound at offset 0 of its block, which
+            // satisfies any alignment.
+            struct Block {
+                VkDeviceSize size;
+                uint32_t memoryTypeBits;
+                std::vector<uint32_t> members;
+            };
+            std::vector<Block> blocks;
+            std::vector<uint32_t> order(transients.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+                return requirements[a].size > requirements[b].size;
+            });
+            for (uint32_t t : order) {
+                const auto &resource = resources[transients[t]];
+                size_t b = 0;
+                for (; b < blocks.size(); b++) {
+                    if ((blocks[b].memoryTypeBits & requirements[t].memoryTypeBits) == 0) {
+                        continue;
+                    }
+                    bool overlaps = false;
+                    for (uint32_t member : blocks[b].members) {
+                        const auto &other = resources[transients[member]];
+                        overlaps = overlaps || (other.firstPass <= resource.lastPass &&
+                                                resource.firstPass <= other.lastPass);
+                    }
+                    if (!overlaps) {
+                        break;
+                    }
+                }
+                if (b == blocks.size()) {
+                    blocks.push_back({0, requirements[t].memoryTypeBits, {}});
+                }
+                blocks[b].size = std::max(blocks[b].size, requirements[t].size);
+                blocks[b].memoryTypeBits &= requirements[t].memoryTypeBits;
+                blocks[b].members.push_back(t);
+                frame.images[t].block = static_cast<uint32_t>(b);
+                frame.unaliasedMemorySize += requirements[t].size;
+            }
+
+            frame.blocks.resize(blocks.size(), VK_NULL_HANDLE);
+            for (size_t b = 0; b < blocks.size(); b++) {
+                VkMemoryAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+                allocInfo.allocationSize = blocks[b].size;
+                allocInfo.memoryTypeIndex = lveDevice.findMemoryType(
+                    blocks[b].memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                if (vkAllocateMemory(lveDevice.device(), &allocInfo, nullptr, &frame.blocks[b]) !=
+                    VK_SUCCESS) {
+                    throw std::runtime_error("Failed to allocate transient image memory");
+                }
+                frame.memorySize += blocks[b].size;
+            }
+
+            for (size_t t = 0; t < transients.size(); t++) {
+                const auto &resource = resources[transients[t]];
+                auto &image = frame.images[t];
+                if (vkBindImageMemory(
+                        lveDevice.device(), image.image, frame.blocks[image.block], 0) !=
+                    VK_SUCCESS) {
+                    throw std::runtime_error("Failed to bind transient image memory");
+                }
+
+                VkImageViewCreateInfo viewInfo{};
+                viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+                viewInfo.image = image.image;
+                viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+                viewInfo.format = resource.format;
+                // Views of depth stencil images only see the depth, like the swap chain's.
+                viewInfo.subresourceRange.aspectMask =
+                    aspectFor(resource.format) & ~VK_IMAGE_ASPECT_STENCIL_BIT;
+                viewInfo.subresourceRange.baseMipLevel = 0;
+                viewInfo.subresourceRange.levelCount = 1;
+                viewInfo.subresourceRange.baseArrayLayer = 0;
+                viewInfo.subresourceRange.layerCount = 1;
+                if (vkCreateImageView(lveDevice.device(), &viewInfo, nullptr, &image.view) !=
+                    VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create transient image view");
+                }
+            }
+        }
+
+        stats.transientMemorySize = frame.memorySize;
+        stats.unaliasedMemorySize = frame.unaliasedMemorySize;
+    }
+
+    void LVERenderGraph::destroyTransientImages(FrameResources &frame) {
+        for (auto &image : frame.images) {
+            vkDestroyImageView(lveDevice.device(), image.view, nullptr);
+            vkDestroyImage(lveDevice.device(), image.image, nullptr);
+        }
+        for (auto block : frame.blocks) {
+            vkFreeMemory(lveDevice.device(), block, nullptr);
+        }
+        frame.images.clear();
+        frame.blocks.clear();
+        frame.layoutKey.clear();
+        frame.memorySize = 0;
+        frame.unaliasedMemorySize = 0;
+    }
+
+    void LVERenderGraph::recordPass(VkCommandBuffer commandBuffer, uint32_t passIndex) {
+        auto &pass = passes[passIndex];
+        auto &frame = frames[currentFrameIndex];
+
+        // Attachments are colors in declaration order, then depth.
+        std::vector<uint32_t> attachmentOrder;
+        for (uint32_t i = 0; i < static_cast<uint32_t>(pass.accesses.size()); i++) {
+            if (pass.accesses[i].type == AccessType::ColorAttachment) {
+                attachmentOrder.push_back(i);
+            }
+        }
+        for (uint32_t i = 0; i < static_cast<uint32_t>(pass.accesses.size()); i++) {
+            if (pass.accesses[i].type == AccessType::DepthAttachment ||
+                pass.accesses[i].type == AccessType::DepthReadOnly) {
+                assert((attachmentOrder.empty() ||
+                        pass.accesses[attachmentOrder.back()].type ==
+                            AccessType::ColorAttachment) &&
+                       "A pass can only have one depth attachment");
+                attachmentOrder.push_back(i);
+            }
+        }
+
+        // The load ops depend on the contents before the barriers below, which may discard them.
+        std::vector<uint32_t> renderPassKey;
+        for (uint32_t i : attachmentOrder) {
+            const auto &access = pass.accesses[i];
+            VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            if (access.clear) {
+                loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            } else if (states[access.resource].hasContents) {
+                loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+            }
+            renderPassKey.push_back(resources[access.resource].format);
+            renderPassKey.push_back(loadOp);
+            renderPassKey.push_back(pass.storeAccess[i] ? VK_ATTACHMENT_STORE_OP_STORE
+                                                        : VK_ATTACHMENT_STORE_OP_DONT_CARE);
+            renderPassKey.push_back(layoutFor(access.type));
+        }
+
+        VkPipelineStageFlags srcStages = 0;
+        VkPipelineStageFlags dstStages = 0;
+        std::vector<VkImageMemoryBarrier> barriers;
+        for (auto &access : pass.accesses) {
+            const auto &resource = resources[access.resource];
+            auto &state = states[access.resource];
+            if (!resource.imported && resource.firstPass == passIndex) {
+                // The memory may have belonged to another image earlier in the frame.
+                state = blockStates[frame.images[resource.physicalIndex].block];
+                state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+                state.hasContents = false;
+            }
+            addBarrier(access, state, srcStages, dstStages, barriers);
+        }
+        if (dstStages != 0) {
+            vkCmdPipelineBarrier(commandBuffer,
+                                 srcStages,
+                                 dstStages,
+                                 0,
+                                 0,
+                                 nullptr,
+                                 0,
+                                 nullptr,
+                                 static_cast<uint32_t>(barriers.size()),
+                                 barriers.data());
+            stats.barrierBatchCount++;
+            stats.imageBarrierCount += static_cast<uint32_t>(barriers.size());
+        }
+        for (auto &access : pass.accesses) {
+            const auto &resource = resources[access.resource];
+            if (!resource.imported) {
+                blockStates[frame.images[resource.physicalIndex].block] = states[access.resource];
+            }
+        }
+
+        RenderGraphPassContext context{commandBuffer, VK_NULL_HANDLE, VK_NULL_HANDLE, {0, 0}};
+        if (!attachmentOrder.empty()) {
+            context.extent = resources[pass.accesses[attachmentOrder[0]].resource].extent;
+            if (dynamicRendering) {
+                beginRendering(commandBuffer, pass, attachmentOrder, renderPassKey, context.extent);
+            } else {
+                beginRenderPass(commandBuffer, pass, attachmentOrder, renderPassKey, context);
+            }
+
+            // Secondary command buffers set their own dynamic state.
+            if (pass.contents == VK_SUBPASS_CONTENTS_INLINE) {
+                VkViewport viewport{};
+                viewport.width = static_cast<float>(context.extent.width);
+                viewport.height = static_cast<float>(context.extent.height);
+                viewport.minDepth = 0.0f;
+                viewport.maxDepth = 1.0f;
+                VkRect2D scissor{{0, 0}, context.extent};
+                vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+                vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+            }
+        }
+
+        if (pass.callback) {
+            pass.callback(context);
+        }
+
+        if (!attachmentOrder.empty()) {
+            if (dynamicRendering) {
+                vkCmdEndRendering(commandBuffer);
+            } else {
+                vkCmdEndRenderPass(commandBuffer);
+            }
+        }
+    }
+
+    void LVERenderGraph::beginRenderPass(VkCommandBuffer commandBuffer,
+                                         const Pass &pass,
+                                         const std::vector<uint32_t> &attachmentOrder,
+                                         const std::vector<uint32_t> &renderPassKey,
+                                         RenderGraphPassContext &context) {
+        auto &frame = frames[currentFrameIndex];
+        std::vector<VkImageView> views;
+        std::vector<VkClearValue> clearValues;
+        for (uint32_t i : attachmentOrder) {
+            views.push_back(getImageView(pass.accesses[i].resource));
+            clearValues.push_back(pass.accesses[i].clearValue);
+        }
+        context.renderPass = getRenderPass(renderPassKey);
+
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = context.renderPass;
+        framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+        framebufferInfo.pAttachments = views.data();
+        framebufferInfo.width = context.extent.width;
+        framebufferInfo.height = context.extent.height;
+        framebufferInfo.layers = 1;
+        if (vkCreateFramebuffer(
+                lveDevice.device(), &framebufferInfo, nullptr, &context.framebuffer) !=
+            VK_SUCCESS) {
+            throw std::runtime_error("Failed to create framebuffer for pass " + pass.name);
+        }
+        frame.framebuffers.push_back(context.framebuffer);
+
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = context.renderPass;
+        renderPassInfo.framebuffer = context.framebuffer;
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = context.extent;
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.pClearValues = clearValues.data();
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, pass.contents);
+    }
+
+    void LVERenderGraph::beginRendering(VkCommandBuffer commandBuffer,
+                                        const Pass &pass,
+                                        const std::vector<uint32_t> &attachmentOrder,
+                                        const std::vector<uint32_t> &renderPassKey,
+                                        VkExtent2D extent) {
+        // Same ops and layouts a render pass for the key would have.
+        std::vector<VkRenderingAttachmentInfo> colorAttachments;
+        VkRenderingAttachmentInfo depthAttachment{};
+        bool hasDepth = false;
+        for (size_t a = 0; a < attachmentOrder.size(); a++) {
+            const auto &access = pass.accesses[attachmentOrder[a]];
+            VkRenderingAttachmentInfo attachment{};
+            attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+            attachment.imageView = getImageView(access.resource);
+            attachment.imageLayout = static_cast<VkImageLayout>(renderPassKey[a * 4 + 3]);
+            attachment.loadOp = static_cast<VkAttachmentLoadOp>(renderPassKey[a * 4 + 1]);
+            attachment.storeOp = static_cast<VkAttachmentStoreOp>(renderPassKey[a * 4 + 2]);
+            attachment.clearValue = access.clearValue;
+            if (isDepthLayout(attachment.imageLayout)) {
+                depthAttachment = attachment;
+                hasDepth = true;
+            } else {
+                colorAttachments.push_back(attachment);
+            }
+        }
+
+        VkRenderingInfo renderingInfo{};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        if (pass.contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) {
+            renderingInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+        }
+        renderingInfo.renderArea = {{0, 0}, extent};
+        renderingInfo.layerCount = 1;
+        renderingInfo.colorAttachmentCount = static_cast<uint32_t>(colorAttachments.size());
+        renderingInfo.pColorAttachments = colorAttachments.data();
+        renderingInfo.pDepthAttachment = hasDepth ? &depthAttachment : nullptr;
+        vkCmdBeginRendering(commandBuffer, &renderingInfo);
+    }
+
+    void LVERenderGraph::addBarrier(const Access &access,
+                                    ResourceState &state,
+                                    VkPipelineStageFlags &srcStages,
+                                    VkPipelineStageFlags &dstStages,
+                                    std::vector<VkImageMemoryBarrier> &barriers) {
+        const VkImageLayout layout = layoutFor(access.type);
+        const VkAccessFlags accessFlags = accessFlagsFor(access.type);
+        const VkPipelineStageFlags stages = stagesFor(access);
+        const bool write = isWrite(access.type);
+        const bool layoutChange = state.layout != layout;
+
+        if (!write && !layoutChange) {
+            // Reads only have to wait for the last write, and only once per stage.
+            if ((stages & ~state.visibleStages) != 0 && state.writeStages != 0) {
+                srcStages |= state.writeStages;
+                dstStages |= stages;
+                if (state.writeAccess != 0) {
+                    VkImageMemoryBarrier barrier{};
+                    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                    barrier.oldLayout = state.layout;
+                    barrier.newLayout = layout;
+                    barrier.srcAccessMask = state.writeAccess;
+                    barrier.dstAccessMask = accessFlags;
+                    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.image = getImage(access.resource);
+                    barrier.subresourceRange = {
+                        aspectFor(resources[access.resource].format), 0, 1, 0, 1};
+                    barriers.push_back(barrier);
+                }
+                state.visibleStages |= stages;
+            }
+            state.readStages |= stages;
+            return;
+        }
+
+        // Writes and layout transitions wait for all earlier accesses.
+        const VkPipelineStageFlags waitStages = state.writeStages | state.readStages;
+        srcStages |= waitStages != 0 ? waitStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        dstStages |= stages;
+        if (layoutChange || state.writeAccess != 0) {
+            // Contents that are about to be cleared or were never written can be discarded,
+            // which spares the transition from preserving them.
+            const bool discard = access.clear || !state.hasContents;
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.oldLayout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+            barrier.newLayout = layout;
+            barrier.srcAccessMask = state.writeAccess;
+            barrier.dstAccessMask = accessFlags;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = getImage(access.resource);
+            barrier.subresourceRange = {aspectFor(resources[access.resource].format), 0, 1, 0, 1};
+            barriers.push_back(barrier);
+        }
+
+        // A layout transition counts as a write, so later reads in other stages wait for it.
+        const VkAccessFlags writeMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                        VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        state.layout = layout;
+        state.writeStages = stages;
+        state.writeAccess = accessFlags & writeMask;
+        state.visibleStages = stages;
+        state.readStages = write ? 0 : stages;
+        state.hasContents = state.hasContents || write;
+    }
+
+    VkRenderPass LVERenderGraph::getRenderPass(const std::vector<uint32_t> &key) {
+        auto it = renderPasses.find(key);
+        if (it != renderPasses.end()) {
+            return it->second;
+        }
+
+        // Every attachment stays in the layout of the pass. Transitions are the barriers' job.
+        std::vector<VkAttachmentDescription> attachments;
+        std::vector<VkAttachmentReference> colorRefs;
+        VkAttachmentReference depthRef{};
+        bool hasDepth = false;
+        for (size_t i = 0; i + 3 < key.size(); i += 4) {
+            const auto layout = static_cast<VkImageLayout>(key[i + 3]);
+            VkAttachmentDescription attachment{};
+            attachment.format = static_cast<VkFormat>(key[i]);
+            attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+            attachment.loadOp = static_cast<VkAttachmentLoadOp>(key[i + 1]);
+            attachment.storeOp = static_cast<VkAttachmentStoreOp>(key[i + 2]);
+            attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            attachment.initialLayout = layout;
+            attachment.finalLayout = layout;
+
+            VkAttachmentReference ref{static_cast<uint32_t>(attachments.size()), layout};
+            if (isDepthLayout(layout)) {
+                depthRef = ref;
+                hasDepth = true;
+            } else {
+                colorRefs.push_back(ref);
+            }
+            attachments.push_back(attachment);
+        }
+
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = static_cast<uint32_t>(colorRefs.size());
+        subpass.pColorAttachments = colorRefs.data();
+        subpass.pDepthStencilAttachment = hasDepth ? &depthRef : nullptr;
+
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        renderPassInfo.pAttachments = attachments.data();
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+
+        VkRenderPass renderPass;
+        if (vkCreateRenderPass(lveDevice.device(), &renderPassInfo, nullptr, &renderPass) !=
+            VK_SUCCESS) {
+            throw std::runtime_error("Failed to create render graph render pass");
+        }
+        renderPasses.emplace(key, renderPass);
+        return renderPass;
+    }
+
+    VkImage LVERenderGraph::getImage(RenderGraphResource resource) const {
+        const auto &r = resources[resource];
+        if (r.imported) {
+            return r.importedImage.image;
+        }
+        assert(r.physicalIndex != UINT32_MAX && "Image is not used by any pass");
+        return frames[currentFrameIndex].images[r.physicalIndex].image;
+    }
+
+    VkImageView LVERenderGraph::getImageView(RenderGraphResource resource) const {
+        const auto &r = resources[resource];
+        if (r.imported) {
+            return r.importedImage.view;
+        }
+        assert(r.physicalIndex != UINT32_MAX && "Image is not used by any pass");
+        return frames[currentFrameIndex].images[r.physicalIndex].view;
+    }
+
+    bool LVERenderGraph::isWrite(AccessType type) {
+        return type == AccessType::ColorAttachment || type == AccessType::DepthAttachment ||
+               type == AccessType::StorageWrite || type == AccessType::TransferWrite;
+    }
+
+    bool LVERenderGraph::isAttachment(AccessType type) {
+        return type == AccessType::ColorAttachment || type == AccessType::DepthAttachment ||
+               type == AccessType::DepthReadOnly;
+    }
+
+    VkImageLayout LVERenderGraph::layoutFor(AccessType type) {
+        switch (type) {
+            case AccessType::ColorAttachment:
+                return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            case AccessType::DepthAttachment:
+                return VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            case AccessType::DepthReadOnly:
+                return VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+            case AccessType::Sampled:
+                return VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            case AccessType::StorageRead:
+            case AccessType::StorageWrite:
+                return VK_IMAGE_LAYOUT_GENERAL;
+            case AccessType::TransferRead:
+                return VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            case AccessType::TransferWrite:
+                return VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        }
+        return VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+
+    VkAccessFlags LVERenderGraph::accessFlagsFor(AccessType type) {
+        switch (type) {
+            case AccessType::ColorAttachment:
+                return VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            case AccessType::DepthAttachment:
+                return VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            case AccessType::DepthReadOnly:
+                return VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+            case AccessType::Sampled:
+            case AccessType::StorageRead:
+                return VK_ACCESS_SHADER_READ_BIT;
+            case AccessType::StorageWrite:
+                return VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            case AccessType::TransferRead:
+                return VK_ACCESS_TRANSFER_READ_BIT;
+            case AccessType::TransferWrite:
+                return VK_ACCESS_TRANSFER_WRITE_BIT;
+        }
+        return 0;
+    }
+
+    VkPipelineStageFlags LVERenderGraph::stagesFor(const Access &access) {
+        switch (access.type) {
+            case AccessType::ColorAttachment:
+                return VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            case AccessType::DepthAttachment:
+            case AccessType::DepthReadOnly:
+                return VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                       VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            case AccessType::TransferRead:
+            case AccessType::TransferWrite:
+                return VK_PIPELINE_STAGE_TRANSFER_BIT;
+            default:
+                return access.stages;
+        }
+    }
+
+    VkImageUsageFlags LVERenderGraph::usageFor(AccessType type) {
+        switch (type) {
+            case AccessType::ColorAttachment:
+                return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+            case AccessType::DepthAttachment:
+            case AccessType::DepthReadOnly:
+                return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            case AccessType::Sampled:
+                return VK_IMAGE_USAGE_SAMPLED_BIT;
+            case AccessType::StorageRead:
+            case AccessType::StorageWrite:
+                return VK_IMAGE_USAGE_STORAGE_BIT;
+            case AccessType::TransferRead:
+                return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            case AccessType::TransferWrite:
+                return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        }
+        return 0;
+    }
+
+    VkImageAspectFlags LVERenderGraph::aspectFor(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_D16_UNORM:
+            case VK_FORMAT_X8_D24_UNORM_PACK32:
+            case VK_FORMAT_D32_SFLOAT:
+                return VK_IMAGE_ASPECT_DEPTH_BIT;
+            case VK_FORMAT_D16_UNORM_S8_UINT:
+            case VK_FORMAT_D24_UNORM_S8_UINT:
+            case VK_FORMAT_D32_SFLOAT_S8_UINT:
+                return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+            default:
+                return VK_IMAGE_ASPECT_COLOR_BIT;
+        }
+    }
+
+    bool LVERenderGraph::isDepthLayout(VkImageLayout layout) {
+        return layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL ||
+               layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    }
+}  // namespace lve
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "lve_device.hpp"
+#include "lve_pass_profiler.hpp"
+
+namespace lve {
+    // Index of an image in a LVERenderGraph. Only valid for the frame it was created in.
+    using RenderGraphResource = uint32_t;
+
+    // What a pass gets to record its commands.
+    struct RenderGraphPassContext {
+        VkCommandBuffer commandBuffer;
+        // The render pass and framebuffer the graph began for the pass. VK_NULL_HANDLE for passes
+        // without attachments, which are recorded outside of a render pass, and for all passes
+        // of a graph that uses dynamic rendering.
+        VkRenderPass renderPass;
+        VkFramebuffer framebuffer;
+        VkExtent2D extent;
+    };
+
+    /**
+     * @brief A frame graph. Every frame the application declares its passes and which images
+     * each of them reads and writes, and the graph takes care of the rest when it is executed:
+     * 1. Passes whose results are never used are culled.
+     * 2. The images the graph owns (transient images) are created for the frame. Transient
+     *    images whose lifetimes do not overlap share the same memory.
+     * 3. Before each pass, all the layout transitions and memory dependencies it needs are
+     *    issued as a single pipeline barrier.
+     * 4. Passes with attachments get a render pass and framebuffer with load and store ops
+     *    derived from how the attachments are used before and after them.
+     *
+     * Render passes only depend on the attachment formats, so pipelines created for another
+     * render pass with the same attachments (colors in declaration order, then depth) are
+     * compatible with them. With dynamic rendering, passes begin rendering with the same ops
+     * and layouts instead, and pipelines only need matching attachment formats.
+     *
+     * A frame looks like
+     * beginFrame, importImage / createImage, addPass..., execute.
+     */
+    class LVERenderGraph {
+       public:
+        struct ImageDesc {
+            VkFormat format;
+            VkExtent2D extent;
+        };
+
+        // An image that lives outside of the graph, e.g. a swap chain image.
+        struct ImportedImage {
+            VkImage image;
+            VkImageView view;
+            VkFormat format;
+            VkExtent2D extent;
+            // Layout the image is in when the frame starts. UNDEFINED discards its contents.
+            VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            // Stages that must wait for the image to be ready, e.g. the stage a semaphore wait is
+            // tied to.
+            VkPipelineStageFlags initialStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            // Layout the image is transitioned to at the end of the frame. Anything but UNDEFINED
+            // marks the image as an output of the frame, which keeps the passes writing it alive.
+            VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        };
+
+        struct Stats {
+            uint32_t passCount = 0;
+            uint32_t culledPassCount = 0;
+            // Pipeline barrier commands and the image barriers batched into them.
+            uint32_t barrierBatchCount = 0;
+            uint32_t imageBarrierCount = 0;
+            uint32_t transientImageCount = 0;
+            // Memory the transient images use, with and without aliasing.
+            VkDeviceSize transientMemorySize = 0;
+            VkDeviceSize unaliasedMemorySize = 0;
+        };
+
+        class PassBuilder {
+           public:
+            // Color attachments are bound in the order they are declared. Without a clear value
+            // the previous contents are kept.
+            PassBuilder &writeColor(RenderGraphResource resource,
+                                    const VkClearColorValue *clearValue = nullptr);
+            PassBuilder &writeDepth(RenderGraphResource resource,
+                                    const VkClearDepthStencilValue *clearValue = nullptr);
+            // Depth attachment that is tested against but not written.
+            PassBuilder &readDepth(RenderGraphResource resource);
+            PassBuilder &sample(RenderGraphResource resource, VkPipelineStageFlags stages);
+            PassBuilder &readStorage(RenderGraphResource resource, VkPipelineStageFlags stages);
+            PassBuilder &writeStorage(RenderGraphResource resource, VkPipelineStageFlags stages);
+            // Source and destination of transfer commands like copies and blits. The destination
+            // is assumed to be overwritten completely.
+            PassBuilder &readTransfer(RenderGraphResource resource);
+            PassBuilder &writeTransfer(RenderGraphResource resource);
+            // The render pass is begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+            PassBuilder &useSecondaryCommandBuffers();
+            // The pass is never culled, e.g. because it writes to buffers the graph does not
+            // know about.
+            PassBuilder &setSideEffects();
+            PassBuilder &record(std::function<void(const RenderGraphPassContext &)> callback);
+
+           private:
+            friend class LVERenderGraph;
+            PassBuilder(LVERenderGraph &graph, uint32_t passIndex)
+                : graph{graph}, passIndex{passIndex} {}
+
+            LVERenderGraph &graph;
+            uint32_t passIndex;
+        };
+
+        // dynamicRendering needs the dynamicRendering feature of the device.
+        explicit LVERenderGraph(LVEDevice &device, bool dynamicRendering = false);
+        ~LVERenderGraph();
+
+        LVERenderGraph(const LVERenderGraph &) = delete;
+        LVERenderGraph &operator=(const LVERenderGraph &) = delete;
+
+        // Starts declaring the graph of a frame. The GPU must be done with the previous frame
+        // that used the same frame index, since its transient images and framebuffers are reused
+        // or destroyed.
+        void beginFrame(int frameIndex);
+        RenderGraphResource importImage(const std::string &name, const ImportedImage &image);
+        // An image owned by the graph. Its contents do not survive the frame.
+        RenderGraphResource createImage(const std::string &name, const ImageDesc &desc);
+        PassBuilder addPass(const std::string &name);
+        // A pass that blits all of source onto all of destination, scaling it if their sizes
+        // differ. The formats must support blits, and linear filtering for VK_FILTER_LINEAR.
+        void addBlitPass(const std::string &name,
+                         RenderGraphResource source,
+                         RenderGraphResource destination,
+                         VkFilter filter = VK_FILTER_LINEAR);
+        // Compiles the graph and records all passes that were not culled into commandBuffer. If a
+        // profiler is given, it measures every pass under its name, including its barriers.
+        void execute(VkCommandBuffer commandBuffer, LVEPassProfiler *profiler = nullptr);
+
+        // Valid while the graph executes, e.g. to write descriptors in a record callback.
+        VkImage getImage(RenderGraphResource resource) const;
+        VkImageView getImageView(RenderGraphResource resource) const;
+        const Stats &getStats() const { return stats; }
+
+       private:
+        enum class AccessType {
+            ColorAttachment,
+            DepthAttachment,
+            DepthReadOnly,
+            Sampled,
+            StorageRead,
+            StorageWrite,
+            TransferRead,
+            TransferWrite
+        };
+
+        struct Access {
+            RenderGraphResource resource;
+            AccessType type;
+            VkPipelineStageFlags stages;
+            bool clear;
+            VkClearValue clearValue;
+        };
+
+        struct Pass {
+            std::string name;
+            std::vector<Access> accesses;
+            std::function<void(const RenderGraphPassContext &)> callback;
+            VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE;
+            bool sideEffects = false;
+            // Filled in by compile.
+            bool culled = false;
+            // Per access: whether the contents are needed after the pass.
+            std::vector<bool> storeAccess;
+        };
+
+        struct Resource {
+            std::string name;
+            VkFormat format;
+            VkExtent2D extent;
+            bool imported;
+            ImportedImage importedImage;
+            // Filled in by compile, for transient images.
+            VkImageUsageFlags usage = 0;
+            uint32_t firstPass = UINT32_MAX;
+            uint32_t lastPass = 0;
+            uint32_t physicalIndex = UINT32_MAX;
+        };
+
+        // The layout and pending accesses of an image while the graph is recorded.
+        struct ResourceState {
+            VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            // The last write (or layout transition) and the stages it has been made visible to.
+            VkPipelineStageFlags writeStages = 0;
+            VkAccessFlags writeAccess = 0;
+            VkPipelineStageFlags visibleStages = 0;
+            // Reads since the last write. A following write has to wait for them.
+            VkPipelineStageFlags readStages = 0;
+            // Whether the image holds contents a later pass may load.
+            bool hasContents = false;
+        };
+
+        struct TransientImage {
+            VkImage image = VK_NULL_HANDLE;
+            VkImageView view = VK_NULL_HANDLE;
+            uint32_t block = 0;
+        };
+
+        // The transient images of one frame index and the memory they are bound to.
+        struct FrameResources {
+            // Identifies the transient images and their lifetimes. They are only recreated when
+            // it changes.
+            std::vector<uint64_t> layoutKey;
+            std::vector<TransientImage> images;
+            std::vector<VkDeviceMemory> blocks;
+            VkDeviceSize memorySize = 0;
+            VkDeviceSize unaliasedMemorySize = 0;
+            // Created every frame, since they reference image views the graph does not own.
+            std::vector<VkFramebuffer> framebuffers;
+        };
+
+        static bool isWrite(AccessType type);
+        static bool isAttachment(AccessType type);
+        static VkImageLayout layoutFor(AccessType type);
+        static VkAccessFlags accessFlagsFor(AccessType type);
+        static VkPipelineStageFlags stagesFor(const Access &access);
+        static VkImageUsageFlags usageFor(AccessType type);
+        static VkImageAspectFlags aspectFor(VkFormat format);
+        static bool isDepthLayout(VkImageLayout layout);
+
+        PassBuilder &addAccess(PassBuilder &builder, const Access &access);
+        void cullPasses();
+        void computeLifetimes();
+        void createTransientImages();
+        void destroyTransientImages(FrameResources &frame);
+        void recordPass(VkCommandBuffer commandBuffer, uint32_t passIndex);
+        void beginRenderPass(VkCommandBuffer commandBuffer,
+                             const Pass &pass,
+                             const std::vector<uint32_t> &attachmentOrder,
+                             const std::vector<uint32_t> &renderPassKey,
+                             RenderGraphPassContext &context);
+        void beginRendering(VkCommandBuffer commandBuffer,
+                            const Pass &pass,
+                            const std::vector<uint32_t> &attachmentOrder,
+                            const std::vector<uint32_t> &renderPassKey,
+                            VkExtent2D extent);
+        void addBarrier(const Access &access,
+                        ResourceState &state,
+                        VkPipelineStageFlags &srcStages,
+                        VkPipelineStageFlags &dstStages,
+                        std::vector<VkImageMemoryBarrier> &barriers);
+        // The key holds format, load op, store op and layout of every attachment.
+        VkRenderPass getRenderPass(const std::vector<uint32_t> &key);
+
+        LVEDevice &lveDevice;
+        bool dynamicRendering;
+
+        std::vector<Pass> passes;
+        std::vector<Resource> resources;
+        int currentFrameIndex = 0;
+        std::vector<FrameResources> frames;
+        // Used while recording. Transient images that share a memory block inherit the pending
+        // accesses of the previous image in the block.
+        std::vector<ResourceState> states;
+        std::vector<ResourceState> blockStates;
+        // Render passes only depend on formats, ops and layouts, so they are kept across frames.
+        std::map<std::vector<uint32_t>, VkRenderPass> renderPasses;
+        Stats stats{};
+    };
+}  // namespace lve
@@ -1,17 +1,40 @@
 #include "lve_renderer.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <stdexcept>
+#include <string>
 
 namespace lve {
+    namespace {
+        bool hasStencilComponent(VkFormat format) {
+            return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
+        }
+    }  // namespace
 
-    LVERenderer::LVERenderer(LVEWindow& window, LVEDevice& device)
-        : lveWindow{window}, lveDevice{device} {
+    LVERenderer::LVERenderer(LVEWindow& window,
+                             LVEDevice& device,
+                             const SwapChainOptions& options)
+        : lveWindow{window}, lveDevice{device}, swapChainOptions{options} {
+        // Falls back to render passes on devices without dynamic rendering.
+        swapChainOptions.dynamicRendering =
+            options.dynamicRendering && device.enabledFeatures13.dynamicRendering == VK_TRUE;
+        // Also creates the command buffers.
         recreateSwapChain();
-        createCommandBuffers();
+        // Sized for the largest frame count, so it survives changes of it.
+        latencyTracker =
+            std::make_unique<LVELatencyTracker>(lveDevice, LVESwapChain::MAX_FRAMES_IN_FLIGHT);
+        passProfiler =
+            std::make_unique<LVEPassProfiler>(lveDevice, LVESwapChain::MAX_FRAMES_IN_FLIGHT);
+    }
+    LVERenderer::~LVERenderer() {
+        // The query pools of the latency tracker and pass profiler may still be written by frames
+        // in flight.
+        vkDeviceWaitIdle(lveDevice.device());
+        freeSecondaryCommandBuffers();
+        freeCommandBuffers();
     }
-    LVERenderer::~LVERenderer() { freeCommandBuffers(); }
 
     void LVERenderer::recreateSwapChain() {
         auto extent = lveWindow.getExtent();
@@ -22,26 +45,69 @@ namespace lve {
             glfwWaitEvents();
         }
 
-        // Wait until the current swap chain is no longer being used before we create the new swap
-        // chain.
-        vkDeviceWaitIdle(lveDevice.device());
-
         if (lveSwapChain == nullptr) {
-            lveSwapChain = std::make_unique<LVESwapChain>(lveDevice, extent);
+            lveSwapChain = std::make_unique<LVESwapChain>(lveDevice, extent, swapChainOptions);
         } else {
+            // The GPU is not drained. The new swap chain is created while frames of the old one
+            // are still in flight, and the old one is destroyed once they are done.
+            if (lveSwapChain->framesInFlight() != swapChainOptions.framesInFlight) {
+                // Except if the per-frame resources are replaced below.
+                lveSwapChain->waitForAllFrames();
+            }
             std::shared_ptr<LVESwapChain> oldSwapChain = std::move(lveSwapChain);
-            lveSwapChain = std::make_unique<LVESwapChain>(lveDevice, extent, oldSwapChain);
+            lveSwapChain =
+                std::make_unique<LVESwapChain>(lveDevice, extent, oldSwapChain, swapChainOptions);
 
             if (!oldSwapChain->compareSwapFormats(*lveSwapChain.get())) {
                 throw std::runtime_error("Swap chain image format has changed!");
             }
+
+            // Frames in flight may still render to and present its images. The last of them is
+            // done once the first frame of the new swap chain is, and by then its last
+            // presentation has been queued before the new acquire.
+            lveDevice.deferDestruction([oldSwapChain]() mutable { oldSwapChain.reset(); });
+        }
+
+        if (commandBuffers.size() != static_cast<size_t>(swapChainOptions.framesInFlight)) {
+            if (!commandBuffers.empty()) {
+                freeCommandBuffers();
+            }
+            // Recreated on demand for the new count.
+            freeSecondaryCommandBuffers();
+            createCommandBuffers();
+            currentFrameIndex = 0;
+        }
+    }
+
+    void LVERenderer::setPresentModes(const std::vector<VkPresentModeKHR> &presentModes) {
+        if (presentModes != swapChainOptions.presentModes) {
+            swapChainOptions.presentModes = presentModes;
+            swapChainOutdated = true;
+        }
+    }
+
+    void LVERenderer::setFramesInFlight(int framesInFlight) {
+        if (framesInFlight < 1 || framesInFlight > LVESwapChain::MAX_FRAMES_IN_FLIGHT) {
+            throw std::runtime_error("Frames in flight must be between 1 and " +
+                                     std::to_string(LVESwapChain::MAX_FRAMES_IN_FLIGHT));
+        }
+        if (framesInFlight != swapChainOptions.framesInFlight) {
+            swapChainOptions.framesInFlight = framesInFlight;
+            swapChainOutdated = true;
+        }
+    }
+
+    void LVERenderer::setImageCount(uint32_t imageCount) {
+        if (imageCount != swapChainOptions.imageCount) {
+            swapChainOptions.imageCount = imageCount;
+            swapChainOutdated = true;
         }
     }
 
     void LVERenderer::createCommandBuffers() {
         // lveSwapChain->imageCount() will likely be either 2 or 3 depending on if the device
         // supports double or triple buffering.
-        commandBuffers.resize(LVESwapChain::MAX_FRAMES_IN_FLIGHT);
+        commandBuffers.resize(swapChainOptions.framesInFlight);
 
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -64,13 +130,72 @@ namespace lve {
         commandBuffers.clear();
     }
 
+    void LVERenderer::createSecondaryCommandBuffers(size_t slotCount) {
+        secondaryCommandPools.resize(commandBuffers.size());
+        secondaryCommandBuffers.resize(commandBuffers.size());
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = lveDevice.findPhysicalQueueFamilies().graphicsFamily;
+        // The buffers are re-recorded every frame, and the whole pool is reset at once.
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+        for (size_t frame = 0; frame < secondaryCommandPools.size(); frame++) {
+            auto &pools = secondaryCommandPools[frame];
+            auto &buffers = secondaryCommandBuffers[frame];
+            while (pools.size() < slotCount) {
+                VkCommandPool pool;
+                if (vkCreateCommandPool(lveDevice.device(), &poolInfo, nullptr, &pool) !=
+                    VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create secondary command pool");
+                }
+                pools.push_back(pool);
+
+                VkCommandBufferAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                // Secondary command buffers cannot be submitted directly. They are executed from
+                // a primary command buffer.
+                allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+                allocInfo.commandPool = pool;
+                allocInfo.commandBufferCount = 1;
+
+                VkCommandBuffer buffer;
+                if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo, &buffer) !=
+                    VK_SUCCESS) {
+                    throw std::runtime_error("Failed to allocate secondary command buffer");
+                }
+                buffers.push_back(buffer);
+            }
+        }
+    }
+
+    void LVERenderer::freeSecondaryCommandBuffers() {
+        // Destroying a pool frees every command buffer allocated from it.
+        for (auto &pools : secondaryCommandPools) {
+            for (auto pool : pools) {
+                vkDestroyCommandPool(lveDevice.device(), pool, nullptr);
+            }
+        }
+        secondaryCommandPools.clear();
+        secondaryCommandBuffers.clear();
+    }
+
     VkCommandBuffer LVERenderer::beginFrame() {
         assert(!isFrameStarted && "Cannot call beginFrame while already in progress.");
+        lveDevice.collectDeferredDestructions();
+        if (swapChainOutdated || lveWindow.wasWindowResized()) {
+            swapChainOutdated = false;
+            lveWindow.resetWindowResizedFlag();
+            recreateSwapChain();
+        }
+        if (lowLatencyMode) {
+            lveSwapChain->waitForAllFrames();
+        }
         auto result = lveSwapChain->acquireNextImage(&currentImageIndex);
         // Here we can detect if the swap chain has been resized and decide whether or not it needs
         // to be recreated.
         if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-            recreateSwapChain();
+            swapChainOutdated = true;
             return nullptr;
         }
 
@@ -79,6 +204,8 @@ namespace lve {
         }
 
         isFrameStarted = true;
+        hasDepthPrepass = false;
+        needsPresentTransition = false;
         auto commandBuffer = getCurrentCommandBuffer();
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -86,6 +213,9 @@ namespace lve {
         if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
             throw std::runtime_error("Failed to begin recording command buffer");
         }
+        // The previous frame of this index is done, so its timestamps are available.
+        latencyTracker->beginFrame(commandBuffer, currentFrameIndex);
+        passProfiler->beginFrame(commandBuffer, currentFrameIndex);
 
         return commandBuffer;
     }
@@ -94,54 +224,349 @@ namespace lve {
         assert(isFrameStarted && "Cannot call endFrame while frame is not in progress");
         auto commandBuffer = getCurrentCommandBuffer();
 
+        if (needsPresentTransition) {
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            // Presentation is synchronized by the render finished semaphore.
+            barrier.dstAccessMask = 0;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = lveSwapChain->getImage(currentImageIndex);
+            barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            vkCmdPipelineBarrier(commandBuffer,
+                                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                 VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                 0,
+                                 0,
+                                 nullptr,
+                                 0,
+                                 nullptr,
+                                 1,
+                                 &barrier);
+        }
+
+        latencyTracker->endFrame(commandBuffer, currentFrameIndex);
         if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
             throw std::runtime_error("Failed to record command buffer");
         }
 
         auto result = lveSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
-        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
-            lveWindow.wasWindowResized()) {
-            lveWindow.resetWindowResizedFlag();
-            recreateSwapChain();
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+            swapChainOutdated = true;
         } else if (result != VK_SUCCESS) {
             throw std::runtime_error("Failed to present swap chain image");
         }
 
         isFrameStarted = false;
-        currentFrameIndex = (currentFrameIndex + 1) % LVESwapChain::MAX_FRAMES_IN_FLIGHT;
+        currentFrameIndex = (currentFrameIndex + 1) % swapChainOptions.framesInFlight;
+    }
+
+    PipelineRenderTarget LVERenderer::getSwapChainRenderTarget() const {
+        PipelineRenderTarget target{};
+        target.renderPass = lveSwapChain->getRenderPass();
+        if (swapChainOptions.dynamicRendering) {
+            target.colorAttachmentFormats = {lveSwapChain->getSwapChainImageFormat()};
+            target.depthAttachmentFormat = lveSwapChain->getSwapChainDepthFormat();
+        }
+        return target;
+    }
+
+    PipelineRenderTarget LVERenderer::getDepthPrepassRenderTarget() const {
+        PipelineRenderTarget target{};
+        target.renderPass = lveSwapChain->getDepthPrepassRenderPass();
+        if (swapChainOptions.dynamicRendering) {
+            target.depthAttachmentFormat = lveSwapChain->getSwapChainDepthFormat();
+        }
+        return target;
+    }
+
+    RenderGraphResource LVERenderer::importSwapChainImage(LVERenderGraph &renderGraph) const {
+        assert(isFrameStarted && "Cannot import swap chain image when frame not in progress");
+        LVERenderGraph::ImportedImage image{};
+        image.image = lveSwapChain->getImage(currentImageIndex);
+        image.view = lveSwapChain->getImageView(currentImageIndex);
+        image.format = lveSwapChain->getSwapChainImageFormat();
+        image.extent = lveSwapChain->getSwapChainExtent();
+        // The previous contents are not needed. The submission waits for the image to be
+        // acquired at the color attachment output stage, so nothing may touch it before that.
+        image.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        image.initialStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        image.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        return renderGraph.importImage("swap chain image", image);
+    }
+
+    RenderGraphResource LVERenderer::importDepthImage(LVERenderGraph &renderGraph,
+                                                      VkExtent2D extent) const {
+        assert(isFrameStarted && "Cannot import depth image when frame not in progress");
+        const VkExtent2D swapChainExtent = lveSwapChain->getSwapChainExtent();
+        assert(extent.width <= swapChainExtent.width && extent.height <= swapChainExtent.height &&
+               "Depth image is smaller than the requested extent");
+        LVERenderGraph::ImportedImage image{};
+        image.image = lveSwapChain->getDepthImage(currentFrameIndex);
+        image.view = lveSwapChain->getDepthImageView(currentFrameIndex);
+        image.format = lveSwapChain->getSwapChainDepthFormat();
+        image.extent = extent;
+        // beginFrame waited for the previous frame that used it, and its contents are discarded.
+        // It is not an output, so it does not keep any pass alive either.
+        image.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        image.finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        return renderGraph.importImage("depth", image);
     }
 
-    void LVERenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
+    void LVERenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer,
+                                               VkSubpassContents contents) {
         assert(isFrameStarted &&
                "Cannot call beginSwapChainRenderPass while frame is not in progress");
         assert(commandBuffer == getCurrentCommandBuffer() &&
                "Cannot begin render pass on command buffer from a different frame");
-        VkRenderPassBeginInfo renderPassInfo{};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = lveSwapChain->getRenderPass();
-        // Which frame buffer this render pass writes in
-        renderPassInfo.framebuffer = lveSwapChain->getFrameBuffer(currentImageIndex);
+        // After a depth pre-pass, the depth buffer is complete and must not be cleared again.
+        if (swapChainOptions.dynamicRendering) {
+            beginDynamicRendering(commandBuffer,
+                                  true,
+                                  VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                  hasDepthPrepass ? VK_ATTACHMENT_LOAD_OP_LOAD
+                                                  : VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                  contents);
+            return;
+        }
+        beginSwapChainRenderPass(commandBuffer,
+                                 hasDepthPrepass ? lveSwapChain->getAfterDepthPrepassRenderPass()
+                                                 : lveSwapChain->getRenderPass(),
+                                 contents);
+    }
 
-        // Setup render area
-        // The area where the shader loads and stores will take place.
-        renderPassInfo.renderArea.offset = {0, 0};
-        renderPassInfo.renderArea.extent = lveSwapChain->getSwapChainExtent();
+    void LVERenderer::beginDepthPrepass(VkCommandBuffer commandBuffer) {
+        assert(isFrameStarted && "Cannot call beginDepthPrepass while frame is not in progress");
+        assert(commandBuffer == getCurrentCommandBuffer() &&
+               "Cannot begin render pass on command buffer from a different frame");
+        assert(!hasDepthPrepass && "Depth pre-pass already rendered this frame");
+        assert(!lveSwapChain->hasTransientDepth() && "Depth pre-pass needs stored depth");
+
+        hasDepthPrepass = true;
+        if (swapChainOptions.dynamicRendering) {
+            beginDynamicRendering(commandBuffer,
+                                  false,
+                                  VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                                  VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                  VK_SUBPASS_CONTENTS_INLINE);
+            return;
+        }
 
+        // The depth attachment is the only attachment of the pre-pass.
+        VkClearValue clearValue{};
+        clearValue.depthStencil = {1.0f, 0};
+        beginRenderPass(commandBuffer,
+                        lveSwapChain->getDepthPrepassRenderPass(),
+                        lveSwapChain->getDepthPrepassFrameBuffer(currentFrameIndex),
+                        &clearValue,
+                        1,
+                        VK_SUBPASS_CONTENTS_INLINE);
+    }
+
+    void LVERenderer::endDepthPrepass(VkCommandBuffer commandBuffer) {
+        assert(isFrameStarted && "Cannot call endDepthPrepass while frame is not in progress");
+        assert(commandBuffer == getCurrentCommandBuffer() &&
+               "Cannot end render pass on command buffer from a different frame");
+        endRendering(commandBuffer);
+    }
+
+    void LVERenderer::continueSwapChainRenderPass(VkCommandBuffer commandBuffer,
+                                                  VkSubpassContents contents) {
+        assert(isFrameStarted &&
+               "Cannot call continueSwapChainRenderPass while frame is not in progress");
+        assert(commandBuffer == getCurrentCommandBuffer() &&
+               "Cannot begin render pass on command buffer from a different frame");
+        assert(!lveSwapChain->hasTransientDepth() && "Cannot continue with transient depth");
+        if (swapChainOptions.dynamicRendering) {
+            beginDynamicRendering(commandBuffer,
+                                  true,
+                                  VK_ATTACHMENT_LOAD_OP_LOAD,
+                                  VK_ATTACHMENT_LOAD_OP_LOAD,
+                                  contents);
+            return;
+        }
+        beginSwapChainRenderPass(commandBuffer, lveSwapChain->getLoadRenderPass(), contents);
+    }
+
+    void LVERenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer,
+                                               VkRenderPass renderPass,
+                                               VkSubpassContents contents) {
         // Set the clear values
         // This corresponds to what we want the initial values of the frame buffer attachments
         // cleared to.
         // Index 0 is the color attachment and index 1 is the depth attachment.
+        // They are ignored for attachments that are loaded.
         std::array<VkClearValue, 2> clearValues{};
         clearValues[0].color = {0.01f, 0.01f, 0.01f, 0.1f};
         clearValues[1].depthStencil = {1.0f, 0};
-        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-        renderPassInfo.pClearValues = clearValues.data();
+        beginRenderPass(commandBuffer,
+                        renderPass,
+                        lveSwapChain->getFrameBuffer(currentFrameIndex, currentImageIndex),
+                        clearValues.data(),
+                        static_cast<uint32_t>(clearValues.size()),
+                        contents);
+    }
+
+    void LVERenderer::beginRenderPass(VkCommandBuffer commandBuffer,
+                                      VkRenderPass renderPass,
+                                      VkFramebuffer framebuffer,
+                                      const VkClearValue *clearValues,
+                                      uint32_t clearValueCount,
+                                      VkSubpassContents contents) {
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = renderPass;
+        // Which frame buffer this render pass writes in
+        renderPassInfo.framebuffer = framebuffer;
+
+        // Setup render area
+        // The area where the shader loads and stores will take place.
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = lveSwapChain->getSwapChainExtent();
+
+        renderPassInfo.clearValueCount = clearValueCount;
+        renderPassInfo.pClearValues = clearValues;
 
         // VK_SUBPASS_CONTENTS_INLINE signals that the subsequent render pass commands will be
         // directly embedded in the primary command buffer itself and no secondary commands will
         // be used.
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        // VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS signals that the render pass commands will
+        // be executed from secondary command buffers.
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+        currentSubpassContents = contents;
+
+        // Dynamic state is not inherited by secondary command buffers, so they set it themselves.
+        if (contents == VK_SUBPASS_CONTENTS_INLINE) {
+            setViewportAndScissor(commandBuffer, lveSwapChain->getSwapChainExtent());
+        }
+    }
+
+    void LVERenderer::beginDynamicRendering(VkCommandBuffer commandBuffer,
+                                            bool renderColor,
+                                            VkAttachmentLoadOp colorLoadOp,
+                                            VkAttachmentLoadOp depthLoadOp,
+                                            VkSubpassContents contents) {
+        // Without a render pass there are no implicit layout transitions and external subpass
+        // dependencies, so they are one barrier here. Attachments that are cleared discard their
+        // contents, the others keep them and wait for the previous rendering to finish.
+        std::array<VkImageMemoryBarrier, 2> barriers{};
+        uint32_t barrierCount = 0;
+        VkPipelineStageFlags srcStages = 0;
+        VkPipelineStageFlags dstStages = 0;
+
+        if (renderColor) {
+            const bool load = colorLoadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+            auto &barrier = barriers[barrierCount++];
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = load ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : 0;
+            barrier.dstAccessMask =
+                VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            barrier.oldLayout =
+                load ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = lveSwapChain->getImage(currentImageIndex);
+            barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            // The submission waits for the image to be acquired at this stage.
+            srcStages |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            dstStages |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        }
+
+        const VkFormat depthFormat = lveSwapChain->getSwapChainDepthFormat();
+        VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+        if (hasStencilComponent(depthFormat)) {
+            depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+        }
+        {
+            const bool load = depthLoadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+            auto &barrier = barriers[barrierCount++];
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            // Within the frame, a clear still has to wait for the depth writes of an earlier
+            // render pass.
+            barrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            barrier.oldLayout =
+                load ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = lveSwapChain->getDepthImage(currentFrameIndex);
+            barrier.subresourceRange = {depthAspect, 0, 1, 0, 1};
+            srcStages |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                         VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            dstStages |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                         VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        }
 
+        vkCmdPipelineBarrier(commandBuffer,
+                             srcStages,
+                             dstStages,
+                             0,
+                             0,
+                             nullptr,
+                             0,
+                             nullptr,
+                             barrierCount,
+                             barriers.data());
+
+        // Same clear values as the swap chain render passes.
+        VkRenderingAttachmentInfo colorAttachment{};
+        colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        colorAttachment.imageView = lveSwapChain->getImageView(currentImageIndex);
+        colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.loadOp = colorLoadOp;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.clearValue.color = {{0.01f, 0.01f, 0.01f, 0.1f}};
+
+        VkRenderingAttachmentInfo depthAttachment{};
+        depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        depthAttachment.imageView = lveSwapChain->getDepthImageView(currentFrameIndex);
+        depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.loadOp = depthLoadOp;
+        // Kept for later rendering in the frame and for reading it back, e.g. into a Hi-Z
+        // pyramid, unless it is transient.
+        depthAttachment.storeOp = lveSwapChain->hasTransientDepth()
+                                      ? VK_ATTACHMENT_STORE_OP_DONT_CARE
+                                      : VK_ATTACHMENT_STORE_OP_STORE;
+        depthAttachment.clearValue.depthStencil = {1.0f, 0};
+
+        VkRenderingInfo renderingInfo{};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        if (contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) {
+            renderingInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+        }
+        renderingInfo.renderArea = {{0, 0}, lveSwapChain->getSwapChainExtent()};
+        renderingInfo.layerCount = 1;
+        renderingInfo.colorAttachmentCount = renderColor ? 1 : 0;
+        renderingInfo.pColorAttachments = renderColor ? &colorAttachment : nullptr;
+        // Pipelines are created without a stencil format, so the stencil aspect of the depth
+        // image is not bound.
+        renderingInfo.pDepthAttachment = &depthAttachment;
+        vkCmdBeginRendering(commandBuffer, &renderingInfo);
+        currentSubpassContents = contents;
+        if (renderColor) {
+            needsPresentTransition = true;
+        }
+
+        if (contents == VK_SUBPASS_CONTENTS_INLINE) {
+            setViewportAndScissor(commandBuffer, lveSwapChain->getSwapChainExtent());
+        }
+    }
+
+    void LVERenderer::endRendering(VkCommandBuffer commandBuffer) {
+        if (swapChainOptions.dynamicRendering) {
+            vkCmdEndRendering(commandBuffer);
+        } else {
+            vkCmdEndRenderPass(commandBuffer);
+        }
+    }
+
+    void LVERenderer::setViewportAndScissor(VkCommandBuffer commandBuffer, VkExtent2D extent) {
         // Configure the dynamic viewport and scissor.
         // Viewport: Describes the transformation between the pipeline's output and the target
         // image.
@@ -170,10 +595,10 @@ namespace lve {
         VkViewport viewport{};
         viewport.x = 0.0f;
         viewport.y = 0.0f;
-        viewport.width = static_cast<float>(lveSwapChain->getSwapChainExtent().width);
+        viewport.width = static_cast<float>(extent.width);
         // For example, if we set the height to height*0.5f, the image would squashed into the top
         // half.
-        viewport.height = static_cast<float>(lveSwapChain->getSwapChainExtent().height);
+        viewport.height = static_cast<float>(extent.height);
         // Depth range for the viewport
         viewport.minDepth = 0.0f;
         viewport.maxDepth = 1.0f;
@@ -181,7 +606,7 @@ namespace lve {
         // Like viewport, but instead of squashing the triangle, it cuts it.
         // For example, if we set the height to height*0.5f, the bottom half of the image would be
         // cut.
-        VkRect2D scissor{{0, 0}, lveSwapChain->getSwapChainExtent()};
+        VkRect2D scissor{{0, 0}, extent};
         vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
         vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
     }
@@ -192,6 +617,108 @@ namespace lve {
         assert(commandBuffer == getCurrentCommandBuffer() &&
                "Cannot end render pass on command buffer from a different frame");
 
-        vkCmdEndRenderPass(commandBuffer);
+        endRendering(commandBuffer);
+    }
+
+    void LVERenderer::recordSecondaryCommandBuffers(
+        VkCommandBuffer primaryCommandBuffer,
+        LVEThreadPool &threadPool,
+        size_t drawCount,
+        const std::function<void(VkCommandBuffer, size_t, size_t)> &record) {
+        assert(isFrameStarted &&
+               "Cannot record secondary command buffers while frame is not in progress");
+        assert(primaryCommandBuffer == getCurrentCommandBuffer() &&
+               "Cannot execute secondary command buffers on a different frame");
+        assert(currentSubpassContents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS &&
+               "Render pass was not begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS");
+        recordSecondaryCommandBuffers(primaryCommandBuffer,
+                                      lveSwapChain->getRenderPass(),
+                                      lveSwapChain->getFrameBuffer(currentFrameIndex,
+                                                                   currentImageIndex),
+                                      lveSwapChain->getSwapChainExtent(),
+                                      threadPool,
+                                      drawCount,
+                                      record);
+    }
+
+    void LVERenderer::recordSecondaryCommandBuffers(
+        VkCommandBuffer primaryCommandBuffer,
+        VkRenderPass renderPass,
+        VkFramebuffer framebuffer,
+        VkExtent2D extent,
+        LVEThreadPool &threadPool,
+        size_t drawCount,
+        const std::function<void(VkCommandBuffer, size_t, size_t)> &record) {
+        assert(isFrameStarted &&
+               "Cannot record secondary command buffers while frame is not in progress");
+        assert(primaryCommandBuffer == getCurrentCommandBuffer() &&
+               "Cannot execute secondary command buffers on a different frame");
+        if (drawCount == 0) {
+            return;
+        }
+
+        // The calling thread records a chunk as well, hence the + 1.
+        const size_t slotCount =
+            std::min<size_t>(threadPool.threadCount() + 1,
+                             (drawCount + MIN_DRAWS_PER_SECONDARY - 1) / MIN_DRAWS_PER_SECONDARY);
+        if (secondaryCommandPools.empty() || secondaryCommandPools[0].size() < slotCount) {
+            createSecondaryCommandBuffers(slotCount);
+        }
+
+        auto &pools = secondaryCommandPools[currentFrameIndex];
+        auto &buffers = secondaryCommandBuffers[currentFrameIndex];
+        // beginFrame already waited for the previous frame of this index, so the GPU is done with
+        // everything previously recorded from these pools.
+        for (size_t slot = 0; slot < slotCount; slot++) {
+            vkResetCommandPool(lveDevice.device(), pools[slot], 0);
+        }
+
+        // Secondary command buffers that execute inside a render pass have to know which render
+        // pass, subpass and framebuffer they will be used with.
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = renderPass;
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = framebuffer;
+        // The pass may be measured by the pass profiler.
+        inheritanceInfo.pipelineStatistics = passProfiler->getInheritedStatistics();
+        // With dynamic rendering, they have to know the attachment formats instead.
+        const VkFormat colorFormat = lveSwapChain->getSwapChainImageFormat();
+        VkCommandBufferInheritanceRenderingInfo renderingInheritanceInfo{};
+        renderingInheritanceInfo.sType =
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+        renderingInheritanceInfo.colorAttachmentCount = 1;
+        renderingInheritanceInfo.pColorAttachmentFormats = &colorFormat;
+        renderingInheritanceInfo.depthAttachmentFormat = lveSwapChain->getSwapChainDepthFormat();
+        renderingInheritanceInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+        renderingInheritanceInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        if (renderPass == VK_NULL_HANDLE) {
+            inheritanceInfo.pNext = &renderingInheritanceInfo;
+        }
+
+        const uint32_t recordedCount = threadPool.parallelFor(
+            drawCount, slotCount, [&](uint32_t slot, size_t begin, size_t end) {
+                VkCommandBuffer secondary = buffers[slot];
+
+                VkCommandBufferBeginInfo beginInfo{};
+                beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
+                                  VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                beginInfo.pInheritanceInfo = &inheritanceInfo;
+                if (vkBeginCommandBuffer(secondary, &beginInfo) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to begin recording secondary command buffer");
+                }
+
+                setViewportAndScissor(secondary, extent);
+                record(secondary, begin, end);
+
+                if (vkEndCommandBuffer(secondary) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to record secondary command buffer");
+                }
+            });
+
+        // Secondary command buffers are executed in the order they are listed, which keeps the
+        // draw order identical to single threaded recording.
+        vkCmdExecuteCommands(primaryCommandBuffer, recordedCount, buffers.data());
     }
 }  // namespace lve
@@ -1,12 +1,18 @@
 #pragma once
 
 #include <cassert>
+#include <functional>
 #include <memory>
 #include <vector>
 
 #include "lve_device.hpp"
+#include "lve_latency_tracker.hpp"
+#include "lve_pass_profiler.hpp"
 #include "lve_model.hpp"
+#include "lve_pipeline.hpp"
+#include "lve_render_graph.hpp"
 #include "lve_swap_chain.hpp"
+#include "lve_thread_pool.hpp"
 #include "lve_window.hpp"
 
 namespace lve {
@@ -19,7 +25,15 @@ namespace lve {
      */
     class LVERenderer {
        public:
-        LVERenderer(LVEWindow &lveWindow, LVEDevice &lveDevice);
+        // Below this many draws per secondary command buffer, the overhead of spinning up a worker
+        // and executing an extra command buffer outweighs the gain from recording in parallel.
+        static constexpr size_t MIN_DRAWS_PER_SECONDARY = 1024;
+
+        // With options.dynamicRendering, the swap chain is rendered to with vkCmdBeginRendering
+        // instead of render passes and framebuffers if the device supports it (Vulkan 1.3).
+        LVERenderer(LVEWindow &lveWindow,
+                    LVEDevice &lveDevice,
+                    const SwapChainOptions &options = {});
         ~LVERenderer();
 
         LVERenderer(const LVERenderer &) = delete;
@@ -36,9 +50,76 @@ namespace lve {
             return commandBuffers[currentFrameIndex];
         }
 
+        bool usesDynamicRendering() const { return swapChainOptions.dynamicRendering; }
         // The application needs to access the swap chain render pass to configure pipelines.
+        // VK_NULL_HANDLE with dynamic rendering, use getSwapChainRenderTarget instead.
         VkRenderPass getSwapChainRenderPass() const { return lveSwapChain->getRenderPass(); }
+        // What pipelines drawing in the swap chain render pass are created for.
+        PipelineRenderTarget getSwapChainRenderTarget() const;
+        // What pipelines drawing in the depth pre-pass are created for.
+        PipelineRenderTarget getDepthPrepassRenderTarget() const;
+        // The present modes to try, in order of preference. Takes effect with the swap chain
+        // that is created at the next beginFrame.
+        void setPresentModes(const std::vector<VkPresentModeKHR> &presentModes);
+        // How many frames may be recorded while the GPU is still busy with earlier ones. Changing
+        // it waits for the device to go idle at the next beginFrame and starts over with frame
+        // index 0. Systems that keep per-frame resources must handle frame indices up to
+        // LVESwapChain::MAX_FRAMES_IN_FLIGHT.
+        void setFramesInFlight(int framesInFlight);
+        int getFramesInFlight() const { return swapChainOptions.framesInFlight; }
+        // The minimum number of swap chain images to ask for, 0 for the surface minimum + 1.
+        // Takes effect with the swap chain that is created at the next beginFrame.
+        void setImageCount(uint32_t imageCount);
+        uint32_t getImageCount() const {
+            return static_cast<uint32_t>(lveSwapChain->imageCount());
+        }
+        // The present mode that was actually picked.
+        VkPresentModeKHR getPresentMode() const { return lveSwapChain->getPresentMode(); }
+
+        // In low latency mode, beginFrame waits until the GPU has finished all earlier frames
+        // before acquiring the next image. The CPU then no longer runs ahead of the GPU, so the
+        // input that is sampled after beginFrame is as fresh as possible, at the cost of
+        // throughput.
+        void setLowLatencyMode(bool enabled) { lowLatencyMode = enabled; }
+        bool isLowLatencyMode() const { return lowLatencyMode; }
+
+        // Marks the moment the input for the next submitted frame was sampled. Frames without a
+        // mark count from the end of their recording.
+        void markInputSampled() { latencyTracker->markInputSampled(); }
+        LVELatencyTracker::Stats getLatencyStats() const { return latencyTracker->getStats(); }
+        void resetLatencyStats() { latencyTracker->resetStats(); }
+        // GPU time of the most recent frame that finished, 0 if unknown. Lags behind the current
+        // frame by the number of frames in flight.
+        double getLastGpuTimeMs() const { return latencyTracker->getLastGpuTimeMs(); }
+        // Measures the passes the application brackets with it, from beginFrame on. Its stats
+        // lag behind like the GPU time above.
+        LVEPassProfiler &getPassProfiler() { return *passProfiler; }
+        // See LVESwapChain::supportsBlitUpscale.
+        bool supportsBlitUpscale() const { return lveSwapChain->supportsBlitUpscale(); }
+
         float getAspectRatio() const { return lveSwapChain->extentAspectRatio(); }
+        VkExtent2D getSwapChainExtent() const { return lveSwapChain->getSwapChainExtent(); }
+        VkFormat getSwapChainImageFormat() const { return lveSwapChain->getSwapChainImageFormat(); }
+        VkFormat getSwapChainDepthFormat() const { return lveSwapChain->getSwapChainDepthFormat(); }
+        // The depth attachment of the current frame. Not available with transient depth.
+        VkImage getCurrentDepthImage() const {
+            assert(isFrameStarted && "Cannot get depth image when frame not in progress");
+            assert(!lveSwapChain->hasTransientDepth() && "Transient depth cannot be read");
+            return lveSwapChain->getDepthImage(currentFrameIndex);
+        }
+        VkImageView getCurrentDepthImageView() const {
+            assert(isFrameStarted && "Cannot get depth image view when frame not in progress");
+            assert(!lveSwapChain->hasTransientDepth() && "Transient depth cannot be read");
+            return lveSwapChain->getDepthImageView(currentFrameIndex);
+        }
+
+        // Adds the swap chain image of the current frame to the graph, as an output that is ready
+        // to be presented at the end of the frame.
+        RenderGraphResource importSwapChainImage(LVERenderGraph &renderGraph) const;
+        // Adds the depth image of the current frame to the graph, so the graph does not need one
+        // of its own. Only the top left extent of it is used, which may be less than the swap
+        // chain extent. Its contents do not survive the frame.
+        RenderGraphResource importDepthImage(LVERenderGraph &renderGraph, VkExtent2D extent) const;
 
         // The reason beginFrame and beginSwapChainRenderPass or the endFrame and
         // endSwapChainRenderPass are not combined:
@@ -46,21 +127,95 @@ namespace lve {
 
         VkCommandBuffer beginFrame();
         void endFrame();
-        void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+        // Optional. Renders only the depth of the swap chain image, so the main pass shades each
+        // pixel once. Must come before beginSwapChainRenderPass, which then keeps the depth
+        // instead of clearing it. Pipelines drawing in the main pass need
+        // LVEPipeline::enableDepthPrepassTest.
+        void beginDepthPrepass(VkCommandBuffer commandBuffer);
+        void endDepthPrepass(VkCommandBuffer commandBuffer);
+        void beginSwapChainRenderPass(VkCommandBuffer commandBuffer,
+                                      VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+        // Like beginSwapChainRenderPass, but keeps what earlier render passes of this frame drew
+        // instead of clearing it. The depth attachment must be in
+        // DEPTH_STENCIL_ATTACHMENT_OPTIMAL layout.
+        void continueSwapChainRenderPass(VkCommandBuffer commandBuffer,
+                                         VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
         void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
+        /**
+         * @brief Splits drawCount draws across the thread pool. Every chunk is recorded into its
+         * own secondary command buffer, which is then executed by the primary command buffer.
+         * The swap chain render pass must have been begun with
+         * VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+         * record(secondary, begin, end) is called concurrently for disjoint ranges.
+         */
+        void recordSecondaryCommandBuffers(
+            VkCommandBuffer primaryCommandBuffer,
+            LVEThreadPool &threadPool,
+            size_t drawCount,
+            const std::function<void(VkCommandBuffer, size_t, size_t)> &record);
+        // Same, for a render pass that was begun by someone else, e.g. a render graph pass, with
+        // a render area of the given extent. A VK_NULL_HANDLE render pass stands for dynamic
+        // rendering with the swap chain color and depth formats.
+        void recordSecondaryCommandBuffers(
+            VkCommandBuffer primaryCommandBuffer,
+            VkRenderPass renderPass,
+            VkFramebuffer framebuffer,
+            VkExtent2D extent,
+            LVEThreadPool &threadPool,
+            size_t drawCount,
+            const std::function<void(VkCommandBuffer, size_t, size_t)> &record);
+
        private:
         void createCommandBuffers();
         void freeCommandBuffers();
         void recreateSwapChain();
+        void createSecondaryCommandBuffers(size_t slotCount);
+        void freeSecondaryCommandBuffers();
+        void setViewportAndScissor(VkCommandBuffer commandBuffer, VkExtent2D extent);
+        void beginRenderPass(VkCommandBuffer commandBuffer,
+                             VkRenderPass renderPass,
+                             VkFramebuffer framebuffer,
+                             const VkClearValue *clearValues,
+                             uint32_t clearValueCount,
+                             VkSubpassContents contents);
+        void beginSwapChainRenderPass(VkCommandBuffer commandBuffer,
+                                      VkRenderPass renderPass,
+                                      VkSubpassContents contents);
+        // Dynamic rendering counterpart of the swap chain render passes. Attachments that are
+        // loaded must still be in their attachment layout, as they are at the end of rendering.
+        void beginDynamicRendering(VkCommandBuffer commandBuffer,
+                                   bool renderColor,
+                                   VkAttachmentLoadOp colorLoadOp,
+                                   VkAttachmentLoadOp depthLoadOp,
+                                   VkSubpassContents contents);
+        void endRendering(VkCommandBuffer commandBuffer);
 
         LVEWindow &lveWindow;
         LVEDevice &lveDevice;
+        SwapChainOptions swapChainOptions;
         std::unique_ptr<LVESwapChain> lveSwapChain;
+        std::unique_ptr<LVELatencyTracker> latencyTracker;
+        std::unique_ptr<LVEPassProfiler> passProfiler;
         std::vector<VkCommandBuffer> commandBuffers;
+        // Indexed by [frame index][slot]. Each slot has its own pool, because a command pool must
+        // only be used by one thread at a time. One secondary command buffer per pool.
+        std::vector<std::vector<VkCommandPool>> secondaryCommandPools;
+        std::vector<std::vector<VkCommandBuffer>> secondaryCommandBuffers;
 
         uint32_t currentImageIndex;
-        int currentFrameIndex{0};  // [0, MAX_FRAMES_IN_FLIGHT]
+        int currentFrameIndex{0};  // [0, swapChainOptions.framesInFlight)
         bool isFrameStarted{false};
+        bool lowLatencyMode{false};
+        // Set when the window was resized, presentation reported the swap chain as out of date
+        // or its options have changed. It is recreated at the next beginFrame, so any number of
+        // resize events lead to one recreation per frame.
+        bool swapChainOutdated{false};
+        // Whether the current frame has rendered a depth pre-pass.
+        bool hasDepthPrepass{false};
+        // Whether the swap chain image was rendered to with dynamic rendering this frame. Render
+        // passes transition it for presentation themselves, dynamic rendering does not.
+        bool needsPresentTransition{false};
+        VkSubpassContents currentSubpassContents{VK_SUBPASS_CONTENTS_INLINE};
     };
 }  // namespace lve
@@ -0,0 +1,74 @@
+#include "lve_resolution_scaler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace lve {
+
+    namespace {
+        // Weights of a new sample when the GPU time rises and when it falls.
+        constexpr double RISE_WEIGHT = 0.5;
+        constexpr double FALL_WEIGHT = 0.1;
+    }  // namespace
+
+    LVEResolutionScaler::LVEResolutionScaler(const Settings &settings)
+        : settings{settings}, scale{settings.maxScale} {}
+
+    void LVEResolutionScaler::update(double gpuTimeMs) {
+        if (!isEnabled() || gpuTimeMs <= 0.0) {
+            return;
+        }
+
+        // Times from before a change say nothing about the new scale, so the average starts
+        // over once they are through.
+        if (cooldown > 0) {
+            cooldown--;
+            return;
+        }
+
+        if (smoothedGpuTimeMs == 0.0) {
+            smoothedGpuTimeMs = gpuTimeMs;
+        } else {
+            const double weight = gpuTimeMs > smoothedGpuTimeMs ? RISE_WEIGHT : FALL_WEIGHT;
+            smoothedGpuTimeMs += weight * (gpuTimeMs - smoothedGpuTimeMs);
+        }
+
+        const double budget = settings.targetGpuTimeMs;
+        float newScale = scale;
+        if (smoothedGpuTimeMs > budget) {
+            framesBelowThreshold = 0;
+            // The GPU time is roughly proportional to the pixel count, which goes with the square
+            // of the scale. Rounded down, so a single drop is enough most of the time.
+            const float target =
+                scale * static_cast<float>(std::sqrt(budget / smoothedGpuTimeMs));
+            newScale = std::min(quantize(std::floor(target / settings.step) * settings.step),
+                                scale - settings.step);
+        } else if (smoothedGpuTimeMs < budget * settings.raiseThreshold) {
+            if (++framesBelowThreshold >= settings.raiseDelayFrames) {
+                framesBelowThreshold = 0;
+                newScale = scale + settings.step;
+            }
+        } else {
+            framesBelowThreshold = 0;
+        }
+
+        newScale = quantize(std::clamp(newScale, settings.minScale, settings.maxScale));
+        if (newScale != scale) {
+            scale = newScale;
+            cooldown = settings.cooldownFrames;
+            smoothedGpuTimeMs = 0.0;
+        }
+    }
+
+    VkExtent2D LVEResolutionScaler::getRenderExtent(VkExtent2D fullExtent) const {
+        return {std::max(1u, static_cast<uint32_t>(std::lround(fullExtent.width * scale))),
+                std::max(1u, static_cast<uint32_t>(std::lround(fullExtent.height * scale)))};
+    }
+
+    float LVEResolutionScaler::quantize(float value) const {
+        // Keeps the scale exactly on the grid of steps despite rounding errors, except for the
+        // bounds themselves.
+        const float steps = std::round(value / settings.step);
+        return std::clamp(steps * settings.step, settings.minScale, settings.maxScale);
+    }
+}  // namespace lve
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+namespace lve {
+    /**
+     * @brief Picks the resolution to render at from the measured GPU frame time, so heavy scenes
+     * keep the frame rate and give up sharpness instead. The scene is rendered at the scaled
+     * extent and then upscaled to the swap chain.
+     *
+     * The GPU time is smoothed so that it follows increases quickly and decreases slowly. Above
+     * the budget the scale drops right away, by as much as the pixel count has to shrink. Below
+     * the budget minus some headroom it rises one step at a time, and only after staying there
+     * for a while. In between it holds, which keeps the scale from oscillating around the
+     * budget. Scales are multiples of the step, so the render targets are only recreated when it
+     * actually changes.
+     */
+    class LVEResolutionScaler {
+       public:
+        struct Settings {
+            // GPU time per frame to stay within. 0 disables scaling.
+            double targetGpuTimeMs = 0.0;
+            // Per axis.
+            float minScale = 0.5f;
+            float maxScale = 1.0f;
+            float step = 0.05f;
+            // Fraction of the budget the GPU time has to stay below before the scale rises.
+            double raiseThreshold = 0.85;
+            int raiseDelayFrames = 30;
+            // Frames after a change during which the scale holds. The GPU times of these frames
+            // are still from the previous scale, since they lag behind by the frames in flight.
+            int cooldownFrames = 4;
+        };
+
+        explicit LVEResolutionScaler(const Settings &settings);
+
+        bool isEnabled() const { return settings.targetGpuTimeMs > 0.0; }
+
+        // Once per frame with the GPU time of the last finished frame. Times <= 0 are ignored.
+        void update(double gpuTimeMs);
+
+        float getScale() const { return scale; }
+        double getSmoothedGpuTimeMs() const { return smoothedGpuTimeMs; }
+        // fullExtent scaled, at least one pixel per axis.
+        VkExtent2D getRenderExtent(VkExtent2D fullExtent) const;
+
+       private:
+        float quantize(float value) const;
+
+        Settings settings;
+        float scale;
+        double smoothedGpuTimeMs = 0.0;
+        int framesBelowThreshold = 0;
+        int cooldown = 0;
+    };
+}  // namespace lve
@@ -0,0 +1,43 @@
+#include "lve_scene.hpp"
+
+namespace lve {
+    Entity LVEScene::create() {
+        std::lock_guard<std::mutex> lock{entityMutex};
+        if (!freeIndices.empty()) {
+            const uint32_t index = freeIndices.back();
+            freeIndices.pop_back();
+            return {index, generations[index]};
+        }
+        generations.push_back(0);
+        return {static_cast<uint32_t>(generations.size() - 1), 0};
+    }
+
+    void LVEScene::destroy(Entity entity) {
+        std::lock_guard<std::mutex> lock{entityMutex};
+        if (entity.index >= generations.size() || generations[entity.index] != entity.generation) {
+            return;
+        }
+        // The index is only reused after the flush, so a new entity never finds the components
+        // of the old one.
+        generations[entity.index]++;
+        destroyedIndices.push_back(entity.index);
+    }
+
+    bool LVEScene::isAlive(Entity entity) const {
+        std::lock_guard<std::mutex> lock{entityMutex};
+        return entity.index < generations.size() && generations[entity.index] == entity.generation;
+    }
+
+    void LVEScene::flushDestroyed() {
+        std::lock_guard<std::mutex> lock{entityMutex};
+        for (uint32_t index : destroyedIndices) {
+            for (auto &pool : pools) {
+                if (pool != nullptr) {
+                    pool->removeIndex(index);
+                }
+            }
+            freeIndices.push_back(index);
+        }
+        destroyedIndices.clear();
+    }
+}  // namespace lve
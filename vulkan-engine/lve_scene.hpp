@@ -0,0 +1,251 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace lve {
+    /**
+     * @brief A handle to an entity of an LVEScene. Indices are reused after an entity is
+     * destroyed, but with the next generation, so handles to the destroyed entity stay invalid.
+     */
+    struct Entity {
+        static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+        uint32_t index = INVALID_INDEX;
+        uint32_t generation = 0;
+
+        bool isNull() const { return index == INVALID_INDEX; }
+        bool operator==(const Entity &other) const = default;
+    };
+
+    class LVEComponentPoolBase {
+       public:
+        virtual ~LVEComponentPoolBase() = default;
+        // Removes the component of whatever entity has this index, if there is one.
+        virtual void removeIndex(uint32_t entityIndex) = 0;
+    };
+
+    /**
+     * @brief The components of one type as a sparse set: The components and their entities are
+     * packed into dense arrays, and a sparse array maps entity indices to positions in them.
+     * Iterating the dense arrays touches nothing but components. Removing moves the last
+     * component into the gap, so positions change on removal.
+     */
+    template <typename T>
+    class LVEComponentPool : public LVEComponentPoolBase {
+       public:
+        static constexpr uint32_t NO_COMPONENT = UINT32_MAX;
+
+        size_t size() const { return components.size(); }
+        bool empty() const { return components.empty(); }
+
+        // Dense access, for positions in [0, size()).
+        T &at(size_t position) { return components[position]; }
+        const T &at(size_t position) const { return components[position]; }
+        Entity entityAt(size_t position) const { return entities[position]; }
+        typename std::vector<T>::iterator begin() { return components.begin(); }
+        typename std::vector<T>::iterator end() { return components.end(); }
+        // All components at once, e.g. for batch processing.
+        std::span<T> span() { return components; }
+
+        bool contains(Entity entity) const { return find(entity) != NO_COMPONENT; }
+        // nullptr if the entity has no such component. If the pools are sorted alike, the
+        // position of the entity in another pool is a good hint, which skips the sparse array.
+        T *tryGet(Entity entity, size_t positionHint = SIZE_MAX) {
+            if (positionHint < entities.size() && entities[positionHint] == entity) {
+                return &components[positionHint];
+            }
+            const uint32_t position = find(entity);
+            return position == NO_COMPONENT ? nullptr : &components[position];
+        }
+        T &get(Entity entity) {
+            T *component = tryGet(entity);
+            assert(component != nullptr && "Entity does not have the component");
+            return *component;
+        }
+
+        // Replaces the component if the entity already has one.
+        template <typename... Args>
+        T &emplace(Entity entity, Args &&...args) {
+            const uint32_t position = find(entity);
+            if (position != NO_COMPONENT) {
+                components[position] = T{std::forward<Args>(args)...};
+                return components[position];
+            }
+            if (entity.index >= sparse.size()) {
+                sparse.resize(entity.index + 1, NO_COMPONENT);
+            }
+            sparse[entity.index] = static_cast<uint32_t>(components.size());
+            entities.push_back(entity);
+            components.push_back(T{std::forward<Args>(args)...});
+            return components.back();
+        }
+
+        void remove(Entity entity) {
+            if (contains(entity)) {
+                removeIndex(entity.index);
+            }
+        }
+
+        void removeIndex(uint32_t entityIndex) override {
+            if (entityIndex >= sparse.size() || sparse[entityIndex] == NO_COMPONENT) {
+                return;
+            }
+            const uint32_t position = sparse[entityIndex];
+            const uint32_t last = static_cast<uint32_t>(components.size() - 1);
+            if (position != last) {
+                components[position] = std::move(components[last]);
+                entities[position] = entities[last];
+                sparse[entities[position].index] = position;
+            }
+            components.pop_back();
+            entities.pop_back();
+            sparse[entityIndex] = NO_COMPONENT;
+        }
+
+        // Moves the components of entities that are also in other to the front, in the order of
+        // other. Afterwards, walking both pools by position visits the same entities.
+        template <typename U>
+        void sortLike(const LVEComponentPool<U> &other) {
+            uint32_t next = 0;
+            for (size_t i = 0; i < other.size(); i++) {
+                const uint32_t position = find(other.entityAt(i));
+                if (position != NO_COMPONENT) {
+                    swapPositions(position, next++);
+                }
+            }
+        }
+
+       private:
+        uint32_t find(Entity entity) const {
+            if (entity.index >= sparse.size()) {
+                return NO_COMPONENT;
+            }
+            const uint32_t position = sparse[entity.index];
+            // A component of an earlier entity with the same index is not this entity's.
+            return position != NO_COMPONENT && entities[position] == entity ? position
+                                                                             : NO_COMPONENT;
+        }
+
+        void swapPositions(uint32_t a, uint32_t b) {
+            if (a == b) {
+                return;
+            }
+            std::swap(components[a], components[b]);
+            std::swap(entities[a], entities[b]);
+            sparse[entities[a].index] = a;
+            sparse[entities[b].index] = b;
+        }
+
+        std::vector<uint32_t> sparse;
+        std::vector<Entity> entities;
+        std::vector<T> components;
+    };
+
+    /**
+     * @brief Entities and their components, with one sparse set pool per component type. Systems
+     * iterate the dense arrays of the pools they need instead of a list of whole objects.
+     *
+     * Creating and destroying entities is thread safe. Destroyed entities are invalid right
+     * away, but their components stay in the pools until flushDestroyed, so that destroying does
+     * not pull components out from under systems that are iterating them on other threads.
+     * Everything else, like adding components, must not run concurrently with anything that
+     * accesses the same pools.
+     */
+    class LVEScene {
+       public:
+        LVEScene() = default;
+
+        LVEScene(const LVEScene &) = delete;
+        LVEScene &operator=(const LVEScene &) = delete;
+
+        Entity create();
+        void destroy(Entity entity);
+        bool isAlive(Entity entity) const;
+        // Removes the components of destroyed entities and lets their indices be reused. Call it
+        // when nothing else uses the scene, e.g. at the start of a frame.
+        void flushDestroyed();
+
+        template <typename T, typename... Args>
+        T &add(Entity entity, Args &&...args) {
+            assert(isAlive(entity) && "Component added to a destroyed entity");
+            return pool<T>().emplace(entity, std::forward<Args>(args)...);
+        }
+        template <typename T>
+        void remove(Entity entity) {
+            pool<T>().remove(entity);
+        }
+        template <typename T>
+        bool has(Entity entity) {
+            return pool<T>().contains(entity);
+        }
+        template <typename T>
+        T &get(Entity entity) {
+            return pool<T>().get(entity);
+        }
+        template <typename T>
+        T *tryGet(Entity entity) {
+            return pool<T>().tryGet(entity);
+        }
+
+        template <typename T>
+        LVEComponentPool<T> &pool() {
+            const uint32_t type = componentType<T>();
+            if (type >= pools.size()) {
+                pools.resize(type + 1);
+            }
+            if (pools[type] == nullptr) {
+                pools[type] = std::make_unique<LVEComponentPool<T>>();
+            }
+            return static_cast<LVEComponentPool<T> &>(*pools[type]);
+        }
+
+        // Orders the pool of T like the pool of U, see LVEComponentPool::sortLike.
+        template <typename T, typename U>
+        void sortLike() {
+            pool<T>().sortLike(pool<U>());
+        }
+
+        // Calls f(entity, first, others...) for every entity that has all of the components, in
+        // the order of First's pool. Sorting the other pools like it keeps the whole walk linear.
+        template <typename First, typename... Others, typename F>
+        void each(F &&f) {
+            eachIn(f, pool<First>(), pool<Others>()...);
+        }
+
+       private:
+        template <typename T>
+        static uint32_t componentType() {
+            static const uint32_t type = nextComponentType++;
+            return type;
+        }
+
+        template <typename F, typename First, typename... Others>
+        static void eachIn(F &f,
+                           LVEComponentPool<First> &first,
+                           LVEComponentPool<Others> &...others) {
+            for (size_t i = 0; i < first.size(); i++) {
+                const Entity entity = first.entityAt(i);
+                if ((others.contains(entity) && ...)) {
+                    f(entity, first.at(i), *others.tryGet(entity, i)...);
+                }
+            }
+        }
+
+        inline static std::atomic<uint32_t> nextComponentType{0};
+
+        mutable std::mutex entityMutex;
+        std::vector<uint32_t> generations;
+        std::vector<uint32_t> freeIndices;
+        std::vector<uint32_t> destroyedIndices;
+
+        std::vector<std::unique_ptr<LVEComponentPoolBase>> pools;
+    };
+}  // namespace lve
@@ -1,6 +1,7 @@
 
 #include "lve_swap_chain.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cstdlib>
 #include <cstring>
@@ -11,26 +12,53 @@
 
 namespace lve {
 
-    LVESwapChain::LVESwapChain(LVEDevice &deviceRef, VkExtent2D extent)
-        : device{deviceRef}, windowExtent{extent} {
+    LVESwapChain::LVESwapChain(LVEDevice &deviceRef,
+                               VkExtent2D extent,
+                               const SwapChainOptions &options)
+        : options{options}, device{deviceRef}, windowExtent{extent} {
+        validateOptions();
         init();
     }
 
     LVESwapChain::LVESwapChain(LVEDevice &deviceRef,
                                VkExtent2D extent,
-                               std::shared_ptr<LVESwapChain> previous)
-        : device{deviceRef}, windowExtent{extent}, oldSwapChain{previous} {
+                               std::shared_ptr<LVESwapChain> previous,
+                               const SwapChainOptions &options)
+        : options{options},
+          device{deviceRef},
+          windowExtent{extent},
+          oldSwapChain{previous} {
+        validateOptions();
         init();
-        // Clean up old swap chain since it's no longer needed.
+        // Carry on where the previous swap chain left off, so the frame slots keep waiting for
+        // the frames that were submitted with it and stay in step with the renderer.
+        if (previous->framesInFlight() == options.framesInFlight) {
+            submittedFrames = previous->submittedFrames;
+            currentFrame = previous->currentFrame;
+        }
+        // The owner keeps the old swap chain alive until its frames are done, so this reference
+        // is no longer needed. Its swap chain was retired by passing it to createSwapChain.
         oldSwapChain = nullptr;
     }
 
+    void LVESwapChain::validateOptions() {
+        if (options.framesInFlight < 1 || options.framesInFlight > MAX_FRAMES_IN_FLIGHT) {
+            throw std::runtime_error("Frames in flight must be between 1 and " +
+                                     std::to_string(MAX_FRAMES_IN_FLIGHT));
+        }
+    }
+
     void LVESwapChain::init() {
         createSwapChain();
         createImageViews();
-        createRenderPass();
+        // Dynamic rendering begins rendering directly with the image views.
+        if (!options.dynamicRendering) {
+            createRenderPass();
+        }
         createDepthResources();
-        createFramebuffers();
+        if (!options.dynamicRendering) {
+            createFramebuffers();
+        }
         createSyncObjects();
     }
 
@@ -54,29 +82,35 @@ namespace lve {
         for (auto framebuffer : swapChainFramebuffers) {
             vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
         }
+        for (auto framebuffer : depthPrepassFramebuffers) {
+            vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
+        }
 
         vkDestroyRenderPass(device.device(), renderPass, nullptr);
+        vkDestroyRenderPass(device.device(), loadRenderPass, nullptr);
+        vkDestroyRenderPass(device.device(), afterDepthPrepassRenderPass, nullptr);
+        vkDestroyRenderPass(device.device(), depthPrepassRenderPass, nullptr);
 
         // cleanup synchronization objects
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (size_t i = 0; i < submittedFrames.size(); i++) {
             vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
             vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
-            vkDestroyFence(device.device(), inFlightFences[i], nullptr);
         }
     }
 
+    void LVESwapChain::waitForAllFrames() {
+        // Frames finish in submission order, so waiting for the newest one is enough.
+        device.waitForFrame(*std::max_element(submittedFrames.begin(), submittedFrames.end()));
+    }
+
     VkResult LVESwapChain::acquireNextImage(uint32_t *imageIndex) {
         /**
          * @brief Returns the index of the frame we should render to next. It also handles the CPU
          * and GPU synchronization surrounding double or triple buffering.
-         * After two command buffers have been submitted, the CPU will block on the next call to
-         * acquireNextImage.
+         * After framesInFlight command buffers have been submitted, the CPU will block on the
+         * next call to acquireNextImage, until the GPU has finished the oldest of them.
          */
-        vkWaitForFences(device.device(),
-                        1,
-                        &inFlightFences[currentFrame],
-                        VK_TRUE,
-                        std::numeric_limits<uint64_t>::max());
+        device.waitForFrame(submittedFrames[currentFrame]);
 
         VkResult result = vkAcquireNextImageKHR(
             device.device(),
@@ -97,10 +131,10 @@ namespace lve {
         // synchronization. The command buffer will then be executed and then the swap chain will
         // present the associated color attachment image to the display at the appropriate time
         // based on the present mode selected.
-        if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
-            vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
-        }
-        imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
+        // There is no need to wait for the previous frame that rendered to this image. Its
+        // presentation waited for it, and the image was only acquired after the presentation.
+        const uint64_t frame = device.beginFrameSubmission();
+        submittedFrames[currentFrame] = frame;
 
         VkSubmitInfo submitInfo = {};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -114,12 +148,25 @@ namespace lve {
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = buffers;
 
-        VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-        submitInfo.signalSemaphoreCount = 1;
+        // The binary semaphore is for the presentation. The frame timeline tells everyone else
+        // when the frame is done.
+        VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame],
+                                          device.getFrameTimeline()};
+        submitInfo.signalSemaphoreCount = 2;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
-        vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
-        if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
+        // The values of binary semaphores are ignored.
+        const uint64_t waitValues[] = {0};
+        const uint64_t signalValues[] = {0, frame};
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = 1;
+        timelineInfo.pWaitSemaphoreValues = waitValues;
+        timelineInfo.signalSemaphoreValueCount = 2;
+        timelineInfo.pSignalSemaphoreValues = signalValues;
+        submitInfo.pNext = &timelineInfo;
+
+        if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE) !=
             VK_SUCCESS) {
             throw std::runtime_error("failed to submit draw command buffer!");
         }
@@ -127,6 +174,7 @@ namespace lve {
         VkPresentInfoKHR presentInfo = {};
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
+        // Only the binary semaphore, presentation cannot wait for timeline semaphores.
         presentInfo.waitSemaphoreCount = 1;
         // The semaphore that was signaled during draw is set here to be waited on. As soon as the
         // signal arrives, the references swap chain image is ready for being presented.
@@ -140,7 +188,7 @@ namespace lve {
 
         auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
 
-        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        currentFrame = (currentFrame + 1) % submittedFrames.size();
 
         return result;
     }
@@ -149,10 +197,14 @@ namespace lve {
         SwapChainSupportDetails swapChainSupport = device.getSwapChainSupport();
 
         VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-        VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+        presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
         VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
         uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+        if (options.imageCount > 0) {
+            imageCount = std::max(options.imageCount, swapChainSupport.capabilities.minImageCount);
+        }
+        // 0 means there is no maximum.
         if (swapChainSupport.capabilities.maxImageCount > 0 &&
             imageCount > swapChainSupport.capabilities.maxImageCount) {
             imageCount = swapChainSupport.capabilities.maxImageCount;
@@ -168,6 +220,15 @@ namespace lve {
         createInfo.imageExtent = extent;
         createInfo.imageArrayLayers = 1;
         createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+                                                  VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                                  VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        blitUpscale = (swapChainSupport.capabilities.supportedUsageFlags &
+                       VK_IMAGE_USAGE_TRANSFER_DST_BIT) != 0 &&
+                      device.hasFormatFeatures(surfaceFormat.format, blitFeatures);
+        if (blitUpscale) {
+            createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        }
 
         QueueFamilyIndices indices = device.findPhysicalQueueFamilies();
         uint32_t queueFamilyIndices[] = {indices.graphicsFamily, indices.presentFamily};
@@ -229,14 +290,32 @@ namespace lve {
     }
 
     void LVESwapChain::createRenderPass() {
+        renderPass = createRenderPass(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_LOAD_OP_CLEAR);
+        loadRenderPass = createRenderPass(VK_ATTACHMENT_LOAD_OP_LOAD, VK_ATTACHMENT_LOAD_OP_LOAD);
+        afterDepthPrepassRenderPass =
+            createRenderPass(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_LOAD_OP_LOAD);
+        depthPrepassRenderPass = createDepthPrepassRenderPass();
+    }
+
+    VkRenderPass LVESwapChain::createRenderPass(VkAttachmentLoadOp colorLoadOp,
+                                                VkAttachmentLoadOp depthLoadOp) {
+        // Render passes that only differ in load and store operations and layouts are compatible,
+        // so all variants can use the same framebuffers and pipelines.
+        const bool loadColor = colorLoadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+        const bool loadDepth = depthLoadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+
         VkAttachmentDescription depthAttachment{};
         depthAttachment.format = findDepthFormat();
         depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.loadOp = depthLoadOp;
+        // The depth is kept for the depth pyramid and for render passes that continue drawing,
+        // unless it is transient.
+        depthAttachment.storeOp = options.transientDepth ? VK_ATTACHMENT_STORE_OP_DONT_CARE
+                                                         : VK_ATTACHMENT_STORE_OP_STORE;
         depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        depthAttachment.initialLayout = loadDepth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+                                                  : VK_IMAGE_LAYOUT_UNDEFINED;
         depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
         VkAttachmentReference depthAttachmentRef{};
@@ -246,11 +325,12 @@ namespace lve {
         VkAttachmentDescription colorAttachment = {};
         colorAttachment.format = getSwapChainImageFormat();
         colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.loadOp = colorLoadOp;
         colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        colorAttachment.initialLayout =
+            loadColor ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_UNDEFINED;
         colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
         VkAttachmentReference colorAttachmentRef = {};
@@ -273,6 +353,16 @@ namespace lve {
                                   VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
         dependency.dstAccessMask =
             VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        // Loading reads what an earlier render pass wrote.
+        if (loadColor) {
+            dependency.srcAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            dependency.dstAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+        }
+        if (loadDepth) {
+            dependency.srcStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            dependency.srcAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            dependency.dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+        }
 
         std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
         VkRenderPassCreateInfo renderPassInfo = {};
@@ -284,16 +374,70 @@ namespace lve {
         renderPassInfo.dependencyCount = 1;
         renderPassInfo.pDependencies = &dependency;
 
-        if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &renderPass) !=
+        VkRenderPass newRenderPass;
+        if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &newRenderPass) !=
             VK_SUCCESS) {
             throw std::runtime_error("failed to create render pass!");
         }
+        return newRenderPass;
+    }
+
+    VkRenderPass LVESwapChain::createDepthPrepassRenderPass() {
+        VkAttachmentDescription depthAttachment{};
+        depthAttachment.format = findDepthFormat();
+        depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        // Kept for the main pass, which loads it.
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference depthAttachmentRef{};
+        depthAttachmentRef.attachment = 0;
+        depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkSubpassDescription subpass = {};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 0;
+        subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+        // The depth image may still be written by an earlier frame that used the same frame index.
+        VkSubpassDependency dependency = {};
+        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependency.srcStageMask =
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependency.dstSubpass = 0;
+        dependency.dstStageMask =
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                   VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+        VkRenderPassCreateInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments = &depthAttachment;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = 1;
+        renderPassInfo.pDependencies = &dependency;
+
+        VkRenderPass newRenderPass;
+        if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &newRenderPass) !=
+            VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pre-pass render pass!");
+        }
+        return newRenderPass;
     }
 
     void LVESwapChain::createFramebuffers() {
-        swapChainFramebuffers.resize(imageCount());
-        for (size_t i = 0; i < imageCount(); i++) {
-            std::array<VkImageView, 2> attachments = {swapChainImageViews[i], depthImageViews[i]};
+        // Every frame in flight can render to every swap chain image.
+        swapChainFramebuffers.resize(depthImages.size() * imageCount());
+        for (size_t i = 0; i < swapChainFramebuffers.size(); i++) {
+            std::array<VkImageView, 2> attachments = {swapChainImageViews[i % imageCount()],
+                                                      depthImageViews[i / imageCount()]};
 
             VkExtent2D swapChainExtent = getSwapChainExtent();
             VkFramebufferCreateInfo framebufferInfo = {};
@@ -311,6 +455,25 @@ namespace lve {
                 throw std::runtime_error("failed to create framebuffer!");
             }
         }
+
+        depthPrepassFramebuffers.resize(depthImages.size());
+        for (size_t i = 0; i < depthPrepassFramebuffers.size(); i++) {
+            VkExtent2D swapChainExtent = getSwapChainExtent();
+            VkFramebufferCreateInfo framebufferInfo = {};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = depthPrepassRenderPass;
+            framebufferInfo.attachmentCount = 1;
+            framebufferInfo.pAttachments = &depthImageViews[i];
+            framebufferInfo.width = swapChainExtent.width;
+            framebufferInfo.height = swapChainExtent.height;
+            framebufferInfo.layers = 1;
+
+            if (vkCreateFramebuffer(
+                    device.device(), &framebufferInfo, nullptr, &depthPrepassFramebuffers[i]) !=
+                VK_SUCCESS) {
+                throw std::runtime_error("failed to create framebuffer!");
+            }
+        }
     }
 
     void LVESwapChain::createDepthResources() {
@@ -318,9 +481,10 @@ namespace lve {
         swapChainDepthFormat = depthFormat;
         VkExtent2D swapChainExtent = getSwapChainExtent();
 
-        depthImages.resize(imageCount());
-        depthImageMemorys.resize(imageCount());
-        depthImageViews.resize(imageCount());
+        // A frame in flight only reuses its depth image after its previous frame is done.
+        depthImages.resize(options.framesInFlight);
+        depthImageMemorys.resize(options.framesInFlight);
+        depthImageViews.resize(options.framesInFlight);
 
         for (int i = 0; i < depthImages.size(); i++) {
             VkImageCreateInfo imageInfo{};
@@ -334,15 +498,23 @@ namespace lve {
             imageInfo.format = depthFormat;
             imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
             imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            // Sampled to build the depth pyramid for occlusion culling. Transient attachments
+            // cannot have other usages.
             imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            imageInfo.usage |= options.transientDepth ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT
+                                                      : VK_IMAGE_USAGE_SAMPLED_BIT;
             imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
             imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
             imageInfo.flags = 0;
 
-            device.createImageWithInfo(imageInfo,
-                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                                       depthImages[i],
-                                       depthImageMemorys[i]);
+            // Lazily allocated memory is only backed when a tile has to spill, which transient
+            // depth never does.
+            device.createImageWithInfo(
+                imageInfo,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                depthImages[i],
+                depthImageMemorys[i],
+                options.transientDepth ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : 0);
 
             VkImageViewCreateInfo viewInfo{};
             viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -363,26 +535,19 @@ namespace lve {
     }
 
     void LVESwapChain::createSyncObjects() {
-        imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-        imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+        imageAvailableSemaphores.resize(options.framesInFlight);
+        renderFinishedSemaphores.resize(options.framesInFlight);
+        submittedFrames.assign(options.framesInFlight, 0);
 
         VkSemaphoreCreateInfo semaphoreInfo = {};
         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-        VkFenceCreateInfo fenceInfo = {};
-        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (size_t i = 0; i < submittedFrames.size(); i++) {
             if (vkCreateSemaphore(
                     device.device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) !=
                     VK_SUCCESS ||
                 vkCreateSemaphore(
                     device.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) !=
-                    VK_SUCCESS ||
-                vkCreateFence(device.device(), &fenceInfo, nullptr, &inFlightFences[i]) !=
                     VK_SUCCESS) {
                 throw std::runtime_error("failed to create synchronization objects for a frame!");
             }
@@ -404,26 +569,37 @@ namespace lve {
     VkPresentModeKHR LVESwapChain::chooseSwapPresentMode(
         const std::vector<VkPresentModeKHR> &availablePresentModes) {
         // The present mode configures how our swap chain handles synchronization with the display.
-        // We prefer to use V-Sync for now.
-
-        // for (const auto &availablePresentMode : availablePresentModes) {
-        //     if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-        //         std::cout << "Present mode: Mailbox" << std::endl;
-        //         return availablePresentMode;
-        //     }
-        // }
-
-        // for (const auto &availablePresentMode : availablePresentModes) {
-        //   if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-        //     std::cout << "Present mode: Immediate" << std::endl;
-        //     return availablePresentMode;
-        //   }
-        // }
-
-        std::cout << "Present mode: V-Sync" << std::endl;
+        // FIFO: V-Sync. The queue of images blocks the application when it is full.
+        // MAILBOX: V-Sync, but newer images replace queued ones. Low latency, renders uncapped.
+        // IMMEDIATE: No V-Sync. Lowest latency, but may tear.
+        for (auto preferred : options.presentModes) {
+            for (const auto &availablePresentMode : availablePresentModes) {
+                if (availablePresentMode == preferred) {
+                    std::cout << "Present mode: " << presentModeName(preferred) << std::endl;
+                    return preferred;
+                }
+            }
+        }
+
+        std::cout << "Present mode: " << presentModeName(VK_PRESENT_MODE_FIFO_KHR) << std::endl;
         return VK_PRESENT_MODE_FIFO_KHR;
     }
 
+    const char *LVESwapChain::presentModeName(VkPresentModeKHR presentMode) {
+        switch (presentMode) {
+            case VK_PRESENT_MODE_IMMEDIATE_KHR:
+                return "Immediate";
+            case VK_PRESENT_MODE_MAILBOX_KHR:
+                return "Mailbox";
+            case VK_PRESENT_MODE_FIFO_KHR:
+                return "V-Sync";
+            case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+                return "Relaxed V-Sync";
+            default:
+                return "Unknown";
+        }
+    }
+
     VkExtent2D LVESwapChain::chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities) {
         if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
             return capabilities.currentExtent;
@@ -441,10 +617,17 @@ namespace lve {
     }
 
     VkFormat LVESwapChain::findDepthFormat() {
-        return device.findSupportedFormat(
-            {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
-            VK_IMAGE_TILING_OPTIMAL,
-            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+        std::vector<VkFormat> candidates{
+            VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT};
+        // D16 is supported everywhere, so it is always picked if it comes first.
+        if (options.compactDepth) {
+            candidates.insert(candidates.begin(), VK_FORMAT_D16_UNORM);
+        }
+        VkFormatFeatureFlags features = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        if (!options.transientDepth) {
+            features |= VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+        }
+        return device.findSupportedFormat(candidates, VK_IMAGE_TILING_OPTIMAL, features);
     }
 
 }  // namespace lve
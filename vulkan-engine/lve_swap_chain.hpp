@@ -10,29 +10,82 @@
 
 namespace lve {
 
+    struct SwapChainOptions {
+        // No render passes and framebuffers are created and all their getters return
+        // VK_NULL_HANDLE. Only the images are. Needs the dynamicRendering device feature.
+        bool dynamicRendering = false;
+        // Present modes in order of preference. The first one the surface supports is used.
+        // FIFO (V-Sync) is always supported and used if none of them is.
+        std::vector<VkPresentModeKHR> presentModes{VK_PRESENT_MODE_FIFO_KHR};
+        // How many frames the CPU may record ahead of the GPU, in [1, MAX_FRAMES_IN_FLIGHT].
+        // One keeps the latency low, three keeps the GPU busy when the CPU time fluctuates.
+        int framesInFlight = 2;
+        // The minimum number of swap chain images to ask for. 0 asks for one more than the
+        // surface minimum. Clamped to what the surface supports.
+        uint32_t imageCount = 0;
+        // Prefer 16 bit depth, which halves the depth memory. Enough for the short depth ranges
+        // of the scenes here.
+        bool compactDepth = false;
+        // The depth is only used inside single render passes: it is cleared, never stored,
+        // loaded or sampled. Rules out the depth pre-pass and continuing render passes of the
+        // swap chain, and the depth pyramid. Where the device has lazily allocated memory, like
+        // tile based GPUs, the depth then never takes up memory at all. Render graph passes may
+        // still keep it from one pass to the next, which commits its memory.
+        bool transientDepth = false;
+    };
+
     // Handles the synchronization and setup for double or triple buffering based on device's
     // capabilities
     class LVESwapChain {
        public:
-        // We limit ourselves to submit at most two command buffers to the device's command queue at
-        // once.
-        static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+        // The upper bound of SwapChainOptions::framesInFlight. Systems that keep resources per
+        // frame in flight without following the configured count size them for this many.
+        static constexpr int MAX_FRAMES_IN_FLIGHT = 3;
 
-        LVESwapChain(LVEDevice &deviceRef, VkExtent2D extent);
         LVESwapChain(LVEDevice &deviceRef,
                      VkExtent2D extent,
-                     std::shared_ptr<LVESwapChain> previous);
+                     const SwapChainOptions &options = {});
+        LVESwapChain(LVEDevice &deviceRef,
+                     VkExtent2D extent,
+                     std::shared_ptr<LVESwapChain> previous,
+                     const SwapChainOptions &options = {});
         ~LVESwapChain();
 
         LVESwapChain(const LVESwapChain &) = delete;
         LVESwapChain &operator=(const LVESwapChain &) = delete;
 
-        VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
+        // Framebuffers pair the swap chain image with the depth image of the frame in flight.
+        VkFramebuffer getFrameBuffer(int frameIndex, int imageIndex) {
+            return swapChainFramebuffers[frameIndex * imageCount() + imageIndex];
+        }
         VkRenderPass getRenderPass() { return renderPass; }
+        // Compatible with getRenderPass, but keeps the color and depth contents instead of
+        // clearing them. Used to continue drawing after work outside of the render pass.
+        VkRenderPass getLoadRenderPass() { return loadRenderPass; }
+        // Compatible with getRenderPass, but only clears the color. The depth written by the
+        // depth pre-pass is kept.
+        VkRenderPass getAfterDepthPrepassRenderPass() { return afterDepthPrepassRenderPass; }
+        // A render pass with only the depth attachment, which it clears and keeps.
+        VkRenderPass getDepthPrepassRenderPass() { return depthPrepassRenderPass; }
+        VkFramebuffer getDepthPrepassFrameBuffer(int frameIndex) {
+            return depthPrepassFramebuffers[frameIndex];
+        }
+        VkImage getImage(int index) { return swapChainImages[index]; }
         VkImageView getImageView(int index) { return swapChainImageViews[index]; }
+        // One depth image per frame in flight, not per swap chain image. Only a frame that is
+        // being recorded or executed needs one.
+        VkImage getDepthImage(int frameIndex) { return depthImages[frameIndex]; }
+        VkImageView getDepthImageView(int frameIndex) { return depthImageViews[frameIndex]; }
+        VkFormat getSwapChainDepthFormat() { return swapChainDepthFormat; }
         size_t imageCount() { return swapChainImages.size(); }
+        int framesInFlight() const { return options.framesInFlight; }
+        bool hasTransientDepth() const { return options.transientDepth; }
         VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
         VkExtent2D getSwapChainExtent() { return swapChainExtent; }
+        VkPresentModeKHR getPresentMode() const { return presentMode; }
+        // Whether an image in the swap chain format can be blitted onto the swap chain images
+        // with linear filtering, e.g. to upscale what was rendered at a lower resolution.
+        bool supportsBlitUpscale() const { return blitUpscale; }
         uint32_t width() { return swapChainExtent.width; }
         uint32_t height() { return swapChainExtent.height; }
 
@@ -40,10 +93,17 @@ namespace lve {
             return static_cast<float>(swapChainExtent.width) /
                    static_cast<float>(swapChainExtent.height);
         }
+        // D32 if supported, or D16 first with options.compactDepth.
         VkFormat findDepthFormat();
 
         VkResult acquireNextImage(uint32_t *imageIndex);
         VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex);
+        // Blocks until every submitted frame has finished on the GPU. Unlike vkDeviceWaitIdle,
+        // this leaves work submitted by others alone.
+        void waitForAllFrames();
+
+        // The name of a present mode, e.g. for printing.
+        static const char *presentModeName(VkPresentModeKHR presentMode);
 
         bool compareSwapFormats(const LVESwapChain &swapChain) const {
             return swapChain.swapChainDepthFormat == swapChainDepthFormat &&
@@ -51,11 +111,15 @@ namespace lve {
         }
 
        private:
+        void validateOptions();
         void init();
         void createSwapChain();
         void createImageViews();
         void createDepthResources();
         void createRenderPass();
+        VkRenderPass createRenderPass(VkAttachmentLoadOp colorLoadOp,
+                                      VkAttachmentLoadOp depthLoadOp);
+        VkRenderPass createDepthPrepassRenderPass();
         void createFramebuffers();
         void createSyncObjects();
 
@@ -69,9 +133,16 @@ namespace lve {
         VkFormat swapChainImageFormat;
         VkFormat swapChainDepthFormat;
         VkExtent2D swapChainExtent;
+        VkPresentModeKHR presentMode;
+        bool blitUpscale = false;
 
+        SwapChainOptions options;
         std::vector<VkFramebuffer> swapChainFramebuffers;
-        VkRenderPass renderPass;
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        VkRenderPass loadRenderPass = VK_NULL_HANDLE;
+        VkRenderPass afterDepthPrepassRenderPass = VK_NULL_HANDLE;
+        std::vector<VkFramebuffer> depthPrepassFramebuffers;
+        VkRenderPass depthPrepassRenderPass = VK_NULL_HANDLE;
 
         std::vector<VkImage> depthImages;
         std::vector<VkDeviceMemory> depthImageMemorys;
@@ -87,8 +158,9 @@ namespace lve {
 
         std::vector<VkSemaphore> imageAvailableSemaphores;
         std::vector<VkSemaphore> renderFinishedSemaphores;
-        std::vector<VkFence> inFlightFences;
-        std::vector<VkFence> imagesInFlight;
+        // Per frame in flight, the number of the frame that last used its semaphores, on the
+        // device's frame timeline. 0 if none did.
+        std::vector<uint64_t> submittedFrames;
         size_t currentFrame = 0;
     };
 
@@ -0,0 +1,115 @@
+#include "lve_thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+
+namespace lve {
+
+    LVEThreadPool::LVEThreadPool(uint32_t threadCount) {
+        workers.reserve(threadCount);
+        for (uint32_t i = 0; i < threadCount; i++) {
+            workers.emplace_back([this]() { workerLoop(); });
+        }
+    }
+
+    LVEThreadPool::~LVEThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock{queueMutex};
+            stopping = true;
+        }
+        queueCondition.notify_all();
+        for (auto &worker : workers) {
+            worker.join();
+        }
+    }
+
+    uint32_t LVEThreadPool::defaultThreadCount() {
+        // hardware_concurrency may return 0 if the value is not computable.
+        const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+
+    void LVEThreadPool::workerLoop() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock{queueMutex};
+                queueCondition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                // Drain the queue before stopping so that no submitted future is left dangling.
+                if (stopping && tasks.empty()) {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+    bool LVEThreadPool::runPendingTask() {
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock{queueMutex};
+            if (tasks.empty()) {
+                return false;
+            }
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+        return true;
+    }
+
+    uint32_t LVEThreadPool::parallelFor(
+        size_t count,
+        size_t maxChunks,
+        const std::function<void(uint32_t chunk, size_t begin, size_t end)> &body) {
+        if (count == 0) {
+            return 0;
+        }
+        const size_t requestedChunks = std::clamp<size_t>(maxChunks, 1, count);
+        const size_t chunkSize = (count + requestedChunks - 1) / requestedChunks;
+        // Recomputed from the rounded up chunk size so that no chunk is left empty.
+        const size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+
+        std::vector<std::future<void>> pending;
+        pending.reserve(chunkCount - 1);
+        for (size_t chunk = 1; chunk < chunkCount; chunk++) {
+            const size_t begin = chunk * chunkSize;
+            const size_t end = std::min(count, begin + chunkSize);
+            pending.push_back(submit([&body, chunk, begin, end]() {
+                body(static_cast<uint32_t>(chunk), begin, end);
+            }));
+        }
+
+        // The calling thread takes the first chunk instead of idling. Every chunk has to finish
+        // before we leave, even on error, because the tasks reference body.
+        std::exception_ptr firstError;
+        try {
+            body(0, 0, std::min(count, chunkSize));
+        } catch (...) {
+            firstError = std::current_exception();
+        }
+        for (auto &future : pending) {
+            // Help out instead of blocking. Once the queue is empty, our chunk has already been
+            // picked up by some thread, so it is safe to block on it.
+            while (future.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+                if (!runPendingTask()) {
+                    future.wait();
+                }
+            }
+            try {
+                future.get();
+            } catch (...) {
+                if (!firstError) {
+                    firstError = std::current_exception();
+                }
+            }
+        }
+        if (firstError) {
+            std::rethrow_exception(firstError);
+        }
+        return static_cast<uint32_t>(chunkCount);
+    }
+}  // namespace lve
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace lve {
+    /**
+     * @brief A fixed set of worker threads that pull tasks from a shared queue. Used to spread CPU
+     * side frame work (command recording, culling, ...) across the available cores.
+     */
+    class LVEThreadPool {
+       public:
+        explicit LVEThreadPool(uint32_t threadCount = defaultThreadCount());
+        ~LVEThreadPool();
+
+        LVEThreadPool(const LVEThreadPool &) = delete;
+        LVEThreadPool &operator=(const LVEThreadPool &) = delete;
+
+        // One thread less than the number of hardware threads, since the caller usually works too.
+        static uint32_t defaultThreadCount();
+        uint32_t threadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+        template <typename F>
+        auto submit(F &&task) -> std::future<std::invoke_result_t<F>> {
+            using Result = std::invoke_result_t<F>;
+            // std::function requires a copyable callable, so the packaged task is shared.
+            auto packagedTask =
+                std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+            std::future<Result> future = packagedTask->get_future();
+            {
+                std::lock_guard<std::mutex> lock{queueMutex};
+                tasks.emplace([packagedTask]() { (*packagedTask)(); });
+            }
+            queueCondition.notify_one();
+            return future;
+        }
+
+        /**
+         * @brief Splits [0, count) into at most maxChunks contiguous ranges and runs them in
+         * parallel. The calling thread runs the first chunk itself and blocks until all chunks are
+         * done. The chunk index is stable, so callers can use it to pick per-chunk resources.
+         * Returns the number of chunks that were run, none of which is empty.
+         * While waiting, the caller runs queued tasks itself, so this can also be called from a
+         * task running on the pool without deadlocking.
+         */
+        uint32_t parallelFor(
+            size_t count,
+            size_t maxChunks,
+            const std::function<void(uint32_t chunk, size_t begin, size_t end)> &body);
+
+       private:
+        void workerLoop();
+        // Runs one queued task on the calling thread. Returns false if the queue was empty.
+        bool runPendingTask();
+
+        std::vector<std::thread> workers;
+        std::queue<std::function<void()>> tasks;
+        std::mutex queueMutex;
+        std::condition_variable queueCondition;
+        bool stopping = false;
+    };
+}  // namespace lve
@@ -0,0 +1,286 @@
+#include "lve_transform_batch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include "lve_transform_kernels.hpp"
+
+#if defined(LVE_TRANSFORM_KERNELS_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace lve {
+
+    namespace {
+        static_assert(sizeof(glm::mat4) == 16 * sizeof(float) &&
+                          sizeof(glm::mat3) == 9 * sizeof(float),
+                      "The kernels write matrices as plain floats");
+
+        struct Scalar {
+            using Float = float;
+            static constexpr size_t WIDTH = 1;
+
+            static Float broadcast(float value) { return value; }
+            static Float load(const float *source) { return *source; }
+            static void store(float *destination, Float value) { *destination = value; }
+            static Float sub(Float a, Float b) { return a - b; }
+            static Float mul(Float a, Float b) { return a * b; }
+            static Float div(Float a, Float b) { return a / b; }
+            static Float mulAdd(Float a, Float b, Float c) { return a * b + c; }
+            static Float mulSub(Float a, Float b, Float c) { return a * b - c; }
+            static void sinCos(Float x, Float &sin, Float &cos) {
+                sin = std::sin(x);
+                cos = std::cos(x);
+            }
+        };
+
+        // The Tait-Bryan angles Y(1), X(2), Z(3) of a rotation, the inverse of the matrix in
+        // TransformComponent.
+        glm::vec3 eulerAngles(const glm::quat &orientation) {
+            const glm::mat3 rotation = glm::mat3_cast(orientation);
+            const float s2 = -rotation[2][1];
+            const float x = std::asin(std::clamp(s2, -1.0f, 1.0f));
+            if (std::abs(s2) < 0.9999f) {
+                return {x,
+                        std::atan2(rotation[2][0], rotation[2][2]),
+                        std::atan2(rotation[0][1], rotation[1][1])};
+            }
+            // Gimbal lock: Y and Z rotate around the same axis, so Y takes all of it.
+            return {x, std::atan2(-rotation[0][2], rotation[0][0]), 0.0f};
+        }
+
+        struct CpuFeatures {
+            bool avx2 = false;
+            bool avx512 = false;
+        };
+
+#if defined(LVE_TRANSFORM_KERNELS_X86)
+        void cpuid(uint32_t leaf, uint32_t registers[4]) {
+#if defined(_MSC_VER)
+            int values[4];
+            __cpuidex(values, static_cast<int>(leaf), 0);
+            for (int i = 0; i < 4; i++) {
+                registers[i] = static_cast<uint32_t>(values[i]);
+            }
+#else
+            __cpuid_count(leaf, 0, registers[0], registers[1], registers[2], registers[3]);
+#endif
+        }
+
+        // Which register states the OS saves on context switches.
+        uint64_t enabledRegisterStates() {
+#if defined(_MSC_VER)
+            return _xgetbv(0);
+#else
+            uint32_t low, high;
+            __asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+            return (static_cast<uint64_t>(high) << 32) | low;
+#endif
+        }
+#endif
+
+        CpuFeatures detectCpuFeatures() {
+            CpuFeatures features{};
+#if defined(LVE_TRANSFORM_KERNELS_X86)
+            uint32_t registers[4];
+            cpuid(0, registers);
+            if (registers[0] < 7) {
+                return features;
+            }
+            cpuid(1, registers);
+            const bool fma = (registers[2] & (1u << 12)) != 0;
+            const bool osxsave = (registers[2] & (1u << 27)) != 0;
+            if (!fma || !osxsave) {
+                return features;
+            }
+            // The CPU may support AVX while the OS does not save the wider registers.
+            const uint64_t states = enabledRegisterStates();
+            const bool ymmStates = (states & 0x6) == 0x6;
+            const bool zmmStates = (states & 0xe6) == 0xe6;
+
+            cpuid(7, registers);
+            features.avx2 = ymmStates && (registers[1] & (1u << 5)) != 0;
+            features.avx512 = features.avx2 && zmmStates && (registers[1] & (1u << 16)) != 0;
+#endif
+            return features;
+        }
+    }  // namespace
+
+    LVETransformBatch::Kernel LVETransformBatch::bestKernel() {
+        if (isSupported(Kernel::Avx512)) {
+            return Kernel::Avx512;
+        }
+        if (isSupported(Kernel::Avx2)) {
+            return Kernel::Avx2;
+        }
+        return Kernel::Scalar;
+    }
+
+    bool LVETransformBatch::isSupported(Kernel kernel) {
+        static const CpuFeatures features = detectCpuFeatures();
+        switch (kernel) {
+            case Kernel::Avx2:
+                return features.avx2;
+            case Kernel::Avx512:
+                return features.avx512;
+            default:
+                return true;
+        }
+    }
+
+    const char *LVETransformBatch::kernelName(Kernel kernel) {
+        switch (kernel) {
+            case Kernel::Avx2:
+                return "AVX2";
+            case Kernel::Avx512:
+                return "AVX-512";
+            default:
+                return "scalar";
+        }
+    }
+
+    LVETransformBatch::LVETransformBatch(Kernel kernel) : kernel{kernel} {
+        if (!isSupported(kernel)) {
+            throw std::runtime_error(std::string{"Transform kernel not supported: "} +
+                                     kernelName(kernel));
+        }
+    }
+
+    void LVETransformBatch::reserve(size_t count) {
+        for (auto *component : components()) {
+            component->reserve(count);
+        }
+        modelMatrices.reserve(count);
+        normalMatrices.reserve(count);
+    }
+
+    void LVETransformBatch::clear() {
+        for (auto *component : components()) {
+            component->clear();
+        }
+        modelMatrices.clear();
+        normalMatrices.clear();
+    }
+
+    size_t LVETransformBatch::add(const TransformComponent &transform) {
+        const size_t index = size();
+        for (auto *component : components()) {
+            component->push_back(0.0f);
+        }
+        modelMatrices.emplace_back(1.0f);
+        normalMatrices.emplace_back(1.0f);
+        set(index, transform);
+        return index;
+    }
+
+    void LVETransformBatch::set(size_t index, const TransformComponent &transform) {
+        setTranslation(index, transform.getTranslation());
+        setRotation(index,
+                    transform.hasQuaternionRotation() ? eulerAngles(transform.getOrientation())
+                                                      : transform.getRotation());
+        setScale(index, transform.getScale());
+    }
+
+    void LVETransformBatch::setTranslation(size_t index, const glm::vec3 &translation) {
+        translationX[index] = translation.x;
+        translationY[index] = translation.y;
+        translationZ[index] = translation.z;
+    }
+
+    void LVETransformBatch::setRotation(size_t index, const glm::vec3 &rotation) {
+        rotationX[index] = rotation.x;
+        rotationY[index] = rotation.y;
+        rotationZ[index] = rotation.z;
+    }
+
+    void LVETransformBatch::setScale(size_t index, const glm::vec3 &scale) {
+        scaleX[index] = scale.x;
+        scaleY[index] = scale.y;
+        scaleZ[index] = scale.z;
+    }
+
+    glm::vec3 LVETransformBatch::getTranslation(size_t index) const {
+        return {translationX[index], translationY[index], translationZ[index]};
+    }
+
+    glm::vec3 LVETransformBatch::getRotation(size_t index) const {
+        return {rotationX[index], rotationY[index], rotationZ[index]};
+    }
+
+    glm::vec3 LVETransformBatch::getScale(size_t index) const {
+        return {scaleX[index], scaleY[index], scaleZ[index]};
+    }
+
+    void LVETransformBatch::updateMatrices(std::span<TransformComponent> transforms) {
+        clear();
+        updatedTransforms.clear();
+        for (auto &transform : transforms) {
+            const glm::vec3 &rotation = transform.rotation;
+            if (!transform.basisDirty || transform.quaternionRotation ||
+                std::max({std::abs(rotation.x), std::abs(rotation.y), std::abs(rotation.z)}) >
+                    MAX_ANGLE) {
+                continue;
+            }
+            updatedTransforms.push_back(&transform);
+            add(transform);
+        }
+        if (updatedTransforms.empty()) {
+            return;
+        }
+        computeMatrices();
+        for (size_t i = 0; i < updatedTransforms.size(); i++) {
+            TransformComponent &transform = *updatedTransforms[i];
+            transform.modelMatrix = modelMatrices[i];
+            transform.normalMatrix = normalMatrices[i];
+            transform.basisDirty = false;
+            transform.translationDirty = false;
+        }
+    }
+
+    std::array<std::vector<float> *, 9> LVETransformBatch::components() {
+        return {&translationX,
+                &translationY,
+                &translationZ,
+                &rotationX,
+                &rotationY,
+                &rotationZ,
+                &scaleX,
+                &scaleY,
+                &scaleZ};
+    }
+
+    void LVETransformBatch::computeMatrices() {
+        const transform_kernels::TransformArrays arrays{
+            translationX.data(),
+            translationY.data(),
+            translationZ.data(),
+            rotationX.data(),
+            rotationY.data(),
+            rotationZ.data(),
+            scaleX.data(),
+            scaleY.data(),
+            scaleZ.data(),
+            reinterpret_cast<float *>(modelMatrices.data()),
+            reinterpret_cast<float *>(normalMatrices.data())};
+        const size_t count = size();
+        // The SIMD kernels take whole groups, the scalar one the rest.
+        size_t vectorized = 0;
+#if defined(LVE_TRANSFORM_KERNELS_X86)
+        if (kernel == Kernel::Avx512) {
+            vectorized = count - count % 16;
+            transform_kernels::computeAvx512(arrays, 0, vectorized);
+        } else if (kernel == Kernel::Avx2) {
+            vectorized = count - count % 8;
+            transform_kernels::computeAvx2(arrays, 0, vectorized);
+        }
+#endif
+        transform_kernels::compute<Scalar>(arrays, vectorized, count);
+    }
+}  // namespace lve
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include "lve_components.hpp"
+
+namespace lve {
+    /**
+     * @brief Transforms of many objects in SoA form, one array per component, whose matrices are
+     * built in one go. The kernels work on 8 (AVX2) or 16 (AVX-512) objects at a time, with the
+     * same math as TransformComponent. Which one runs is picked at run time from what the CPU
+     * supports, with a scalar kernel as the fallback and for the objects left over.
+     *
+     * Rotations are Euler angles. Quaternion rotations are converted when they are set.
+     */
+    class LVETransformBatch {
+       public:
+        enum class Kernel { Scalar, Avx2, Avx512 };
+
+        // The widest kernel the CPU and the build support.
+        static Kernel bestKernel();
+        static bool isSupported(Kernel kernel);
+        static const char *kernelName(Kernel kernel);
+
+        // Throws if the kernel is not supported.
+        explicit LVETransformBatch(Kernel kernel = bestKernel());
+
+        Kernel getKernel() const { return kernel; }
+
+        size_t size() const { return translationX.size(); }
+        void reserve(size_t count);
+        void clear();
+        // Returns the index of the new transform.
+        size_t add(const TransformComponent &transform);
+        void set(size_t index, const TransformComponent &transform);
+        void setTranslation(size_t index, const glm::vec3 &translation);
+        void setRotation(size_t index, const glm::vec3 &rotation);
+        void setScale(size_t index, const glm::vec3 &scale);
+
+        glm::vec3 getTranslation(size_t index) const;
+        glm::vec3 getRotation(size_t index) const;
+        glm::vec3 getScale(size_t index) const;
+
+        // Builds the matrices of all transforms. Unlike TransformComponent, there is no dirty
+        // tracking: Batches pay off when most of the transforms change every frame anyway.
+        void computeMatrices();
+        // As of the last computeMatrices.
+        const glm::mat4 &modelMatrix(size_t index) const { return modelMatrices[index]; }
+        const glm::mat3 &normalMatrix(size_t index) const { return normalMatrices[index]; }
+
+        // Rebuilds the matrices of the transforms whose rotation or scale changed since their
+        // matrices were last read, all in one batch, and stores them in the transforms' caches.
+        // Quaternion rotations need no trigonometry and angles beyond MAX_ANGLE are too large for
+        // the kernels, so those are left to TransformComponent. Replaces the batch's contents.
+        void updateMatrices(std::span<TransformComponent> transforms);
+
+        // In radians. The kernels' sine and cosine lose precision beyond a few thousand.
+        static constexpr float MAX_ANGLE = 1024.0f;
+
+       private:
+        std::array<std::vector<float> *, 9> components();
+
+        Kernel kernel;
+
+        std::vector<float> translationX;
+        std::vector<float> translationY;
+        std::vector<float> translationZ;
+        std::vector<float> rotationX;
+        std::vector<float> rotationY;
+        std::vector<float> rotationZ;
+        std::vector<float> scaleX;
+        std::vector<float> scaleY;
+        std::vector<float> scaleZ;
+
+        std::vector<glm::mat4> modelMatrices;
+        std::vector<glm::mat3> normalMatrices;
+        // The transforms of the last updateMatrices, by index.
+        std::vector<TransformComponent *> updatedTransforms;
+    };
+}  // namespace lve
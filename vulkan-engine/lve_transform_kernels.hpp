@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+
+// Shared by the transform batch and the SIMD kernels, which are compiled for their own instruction
+// sets. Nothing in here may pull in inline functions that other translation units also use, since
+// the linker could pick the AVX build of such a function for a CPU without AVX. Hence no GLM.
+
+namespace lve::transform_kernels {
+    // Transforms in SoA form, and where their matrices go. Matrices are column major like GLM's,
+    // 16 floats per model matrix and 9 per normal matrix.
+    struct TransformArrays {
+        const float *translationX;
+        const float *translationY;
+        const float *translationZ;
+        const float *rotationX;
+        const float *rotationY;
+        const float *rotationZ;
+        const float *scaleX;
+        const float *scaleY;
+        const float *scaleZ;
+        float *modelMatrices;
+        float *normalMatrices;
+    };
+
+    // sinf and cosf of the Cephes library, for the SIMD kernels: The angle is reduced by the octant
+    // it is in to [-pi/4, pi/4], where both have a short polynomial. Even octants are rounded up,
+    // and those whose second bit is set swap the polynomials. Accurate to a few ulp for angles up
+    // to a few thousand radians.
+    namespace cephes {
+        constexpr float FOUR_OVER_PI = 1.27323954473516f;
+        // pi / 4 split into three parts, the first two of which are exact in a float.
+        constexpr float PI_OVER_FOUR_1 = 0.78515625f;
+        constexpr float PI_OVER_FOUR_2 = 2.4187564849853515625e-4f;
+        constexpr float PI_OVER_FOUR_3 = 3.77489497744594108e-8f;
+        constexpr float COS_0 = 2.443315711809948e-5f;
+        constexpr float COS_1 = -1.388731625493765e-3f;
+        constexpr float COS_2 = 4.166664568298827e-2f;
+        constexpr float SIN_0 = -1.9515295891e-4f;
+        constexpr float SIN_1 = 8.3321608736e-3f;
+        constexpr float SIN_2 = -1.6666654611e-1f;
+    }  // namespace cephes
+
+    // end - begin has to be a multiple of the width, 8 and 16 respectively. Only call them if
+    // the CPU supports the instruction set.
+    void computeAvx2(const TransformArrays &arrays, size_t begin, size_t end);
+    void computeAvx512(const TransformArrays &arrays, size_t begin, size_t end);
+
+    /**
+     * @brief Builds the matrices of Isa::WIDTH transforms at a time, with the same math as
+     * TransformComponent. Isa wraps one instruction set: Float, WIDTH, broadcast, load, store, sub,
+     * mul, div, mulAdd (a * b + c), mulSub (a * b - c) and sinCos.
+     */
+    template <typename Isa>
+    void compute(const TransformArrays &arrays, size_t begin, size_t end) {
+        using Float = typename Isa::Float;
+        constexpr size_t WIDTH = Isa::WIDTH;
+        for (size_t i = begin; i < end; i += WIDTH) {
+            // Tait-Bryan angles Y(1), X(2), Z(3), so the rotation is Ry * Rx * Rz.
+            Float s1, c1, s2, c2, s3, c3;
+            Isa::sinCos(Isa::load(arrays.rotationY + i), s1, c1);
+            Isa::sinCos(Isa::load(arrays.rotationX + i), s2, c2);
+            Isa::sinCos(Isa::load(arrays.rotationZ + i), s3, c3);
+            const Float s1s2 = Isa::mul(s1, s2);
+            const Float c1s2 = Isa::mul(c1, s2);
+
+            // rotation[column][row]
+            Float rotation[3][3];
+            rotation[0][0] = Isa::mulAdd(s1s2, s3, Isa::mul(c1, c3));
+            rotation[0][1] = Isa::mul(c2, s3);
+            rotation[0][2] = Isa::mulSub(c1s2, s3, Isa::mul(c3, s1));
+            rotation[1][0] = Isa::mulSub(s1s2, c3, Isa::mul(c1, s3));
+            rotation[1][1] = Isa::mul(c2, c3);
+            rotation[1][2] = Isa::mulAdd(c1s2, c3, Isa::mul(s1, s3));
+            rotation[2][0] = Isa::mul(c2, s1);
+            rotation[2][1] = Isa::sub(Isa::broadcast(0.0f), s2);
+            rotation[2][2] = Isa::mul(c1, c2);
+
+            const Float scale[3] = {Isa::load(arrays.scaleX + i),
+                                    Isa::load(arrays.scaleY + i),
+                                    Isa::load(arrays.scaleZ + i)};
+            const Float one = Isa::broadcast(1.0f);
+
+            // The results are computed per component across objects, but stored per object. The
+            // lanes go through the stack, which is cheaper than shuffling 18 registers around.
+            alignas(64) float model[9][WIDTH];
+            alignas(64) float normal[9][WIDTH];
+            for (int column = 0; column < 3; column++) {
+                const Float inverseScale = Isa::div(one, scale[column]);
+                for (int row = 0; row < 3; row++) {
+                    Isa::store(model[column * 3 + row],
+                               Isa::mul(rotation[column][row], scale[column]));
+                    Isa::store(normal[column * 3 + row],
+                               Isa::mul(rotation[column][row], inverseScale));
+                }
+            }
+
+            for (size_t lane = 0; lane < WIDTH; lane++) {
+                float *modelMatrix = arrays.modelMatrices + (i + lane) * 16;
+                float *normalMatrix = arrays.normalMatrices + (i + lane) * 9;
+                for (int column = 0; column < 3; column++) {
+                    modelMatrix[column * 4 + 0] = model[column * 3 + 0][lane];
+                    modelMatrix[column * 4 + 1] = model[column * 3 + 1][lane];
+                    modelMatrix[column * 4 + 2] = model[column * 3 + 2][lane];
+                    modelMatrix[column * 4 + 3] = 0.0f;
+                }
+                modelMatrix[12] = arrays.translationX[i + lane];
+                modelMatrix[13] = arrays.translationY[i + lane];
+                modelMatrix[14] = arrays.translationZ[i + lane];
+                modelMatrix[15] = 1.0f;
+                for (int element = 0; element < 9; element++) {
+                    normalMatrix[element] = normal[element][lane];
+                }
+            }
+        }
+    }
+}  // namespace lve::transform_kernels
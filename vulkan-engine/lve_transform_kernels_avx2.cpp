@@ -0,0 +1,73 @@
+// Compiled with AVX2 and FMA enabled, see CMakeLists.txt.
+#include <immintrin.h>
+
+#include "lve_transform_kernels.hpp"
+
+namespace lve::transform_kernels {
+
+    namespace {
+        struct Avx2 {
+            using Float = __m256;
+            static constexpr size_t WIDTH = 8;
+
+            static Float broadcast(float value) { return _mm256_set1_ps(value); }
+            static Float load(const float *source) { return _mm256_loadu_ps(source); }
+            // Only ever stores to the aligned lanes on the stack.
+            static void store(float *destination, Float value) {
+                _mm256_store_ps(destination, value);
+            }
+            static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+            static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+            static Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+            static Float mulAdd(Float a, Float b, Float c) { return _mm256_fmadd_ps(a, b, c); }
+            static Float mulSub(Float a, Float b, Float c) { return _mm256_fmsub_ps(a, b, c); }
+
+            static void sinCos(Float x, Float &sin, Float &cos) {
+                using namespace cephes;
+                const __m256 signMask = _mm256_set1_ps(-0.0f);
+                __m256 sinSign = _mm256_and_ps(x, signMask);
+                x = _mm256_andnot_ps(signMask, x);
+
+                __m256i octant = _mm256_cvttps_epi32(_mm256_mul_ps(x, broadcast(FOUR_OVER_PI)));
+                octant = _mm256_add_epi32(octant, _mm256_set1_epi32(1));
+                octant = _mm256_and_si256(octant, _mm256_set1_epi32(~1));
+                const __m256 y = _mm256_cvtepi32_ps(octant);
+
+                // Bit 2 of the octant flips the sign of the sine, and bit 2 of octant - 2 clears
+                // the one of the cosine.
+                const __m256i four = _mm256_set1_epi32(4);
+                const __m256i octantSign = _mm256_and_si256(octant, four);
+                sinSign = _mm256_xor_ps(sinSign,
+                                        _mm256_castsi256_ps(_mm256_slli_epi32(octantSign, 29)));
+                const __m256i cosSignBit =
+                    _mm256_andnot_si256(_mm256_sub_epi32(octant, _mm256_set1_epi32(2)), four);
+                const __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(cosSignBit, 29));
+                const __m256i two = _mm256_set1_epi32(2);
+                const __m256 swap = _mm256_castsi256_ps(
+                    _mm256_cmpeq_epi32(_mm256_and_si256(octant, two), two));
+
+                x = _mm256_fnmadd_ps(y, broadcast(PI_OVER_FOUR_1), x);
+                x = _mm256_fnmadd_ps(y, broadcast(PI_OVER_FOUR_2), x);
+                x = _mm256_fnmadd_ps(y, broadcast(PI_OVER_FOUR_3), x);
+                const __m256 z = _mm256_mul_ps(x, x);
+
+                __m256 cosPolynomial = _mm256_fmadd_ps(broadcast(COS_0), z, broadcast(COS_1));
+                cosPolynomial = _mm256_fmadd_ps(cosPolynomial, z, broadcast(COS_2));
+                cosPolynomial = _mm256_mul_ps(_mm256_mul_ps(cosPolynomial, z), z);
+                cosPolynomial = _mm256_fnmadd_ps(broadcast(0.5f), z, cosPolynomial);
+                cosPolynomial = _mm256_add_ps(cosPolynomial, broadcast(1.0f));
+
+                __m256 sinPolynomial = _mm256_fmadd_ps(broadcast(SIN_0), z, broadcast(SIN_1));
+                sinPolynomial = _mm256_fmadd_ps(sinPolynomial, z, broadcast(SIN_2));
+                sinPolynomial = _mm256_fmadd_ps(_mm256_mul_ps(sinPolynomial, z), x, x);
+
+                sin = _mm256_xor_ps(_mm256_blendv_ps(sinPolynomial, cosPolynomial, swap), sinSign);
+                cos = _mm256_xor_ps(_mm256_blendv_ps(cosPolynomial, sinPolynomial, swap), cosSign);
+            }
+        };
+    }  // namespace
+
+    void computeAvx2(const TransformArrays &arrays, size_t begin, size_t end) {
+        compute<Avx2>(arrays, begin, end);
+    }
+}  // namespace lve::transform_kernels
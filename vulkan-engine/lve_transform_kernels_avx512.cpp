@@ -0,0 +1,74 @@
+// Compiled with AVX-512F and FMA enabled, see CMakeLists.txt.
+#include <immintrin.h>
+
+#include "lve_transform_kernels.hpp"
+
+namespace lve::transform_kernels {
+
+    namespace {
+        // Only uses AVX-512F. Floating point logic needs DQ, so signs are flipped with integers.
+        struct Avx512 {
+            using Float = __m512;
+            static constexpr size_t WIDTH = 16;
+
+            static Float broadcast(float value) { return _mm512_set1_ps(value); }
+            static Float load(const float *source) { return _mm512_loadu_ps(source); }
+            // Only ever stores to the aligned lanes on the stack.
+            static void store(float *destination, Float value) {
+                _mm512_store_ps(destination, value);
+            }
+            static Float sub(Float a, Float b) { return _mm512_sub_ps(a, b); }
+            static Float mul(Float a, Float b) { return _mm512_mul_ps(a, b); }
+            static Float div(Float a, Float b) { return _mm512_div_ps(a, b); }
+            static Float mulAdd(Float a, Float b, Float c) { return _mm512_fmadd_ps(a, b, c); }
+            static Float mulSub(Float a, Float b, Float c) { return _mm512_fmsub_ps(a, b, c); }
+
+            static void sinCos(Float x, Float &sin, Float &cos) {
+                using namespace cephes;
+                const __m512i signMask = _mm512_set1_epi32(static_cast<int>(0x80000000u));
+                const __m512i bits = _mm512_castps_si512(x);
+                __m512i sinSign = _mm512_and_si512(bits, signMask);
+                x = _mm512_castsi512_ps(_mm512_andnot_si512(signMask, bits));
+
+                __m512i octant = _mm512_cvttps_epi32(_mm512_mul_ps(x, broadcast(FOUR_OVER_PI)));
+                octant = _mm512_add_epi32(octant, _mm512_set1_epi32(1));
+                octant = _mm512_and_si512(octant, _mm512_set1_epi32(~1));
+                const __m512 y = _mm512_cvtepi32_ps(octant);
+
+                // Same as in the AVX2 kernel.
+                const __m512i four = _mm512_set1_epi32(4);
+                sinSign = _mm512_xor_si512(
+                    sinSign, _mm512_slli_epi32(_mm512_and_si512(octant, four), 29));
+                const __m512i cosSignBit =
+                    _mm512_andnot_si512(_mm512_sub_epi32(octant, _mm512_set1_epi32(2)), four);
+                const __m512i cosSign = _mm512_slli_epi32(cosSignBit, 29);
+                const __m512i two = _mm512_set1_epi32(2);
+                const __mmask16 swap = _mm512_test_epi32_mask(octant, two);
+
+                x = _mm512_fnmadd_ps(y, broadcast(PI_OVER_FOUR_1), x);
+                x = _mm512_fnmadd_ps(y, broadcast(PI_OVER_FOUR_2), x);
+                x = _mm512_fnmadd_ps(y, broadcast(PI_OVER_FOUR_3), x);
+                const __m512 z = _mm512_mul_ps(x, x);
+
+                __m512 cosPolynomial = _mm512_fmadd_ps(broadcast(COS_0), z, broadcast(COS_1));
+                cosPolynomial = _mm512_fmadd_ps(cosPolynomial, z, broadcast(COS_2));
+                cosPolynomial = _mm512_mul_ps(_mm512_mul_ps(cosPolynomial, z), z);
+                cosPolynomial = _mm512_fnmadd_ps(broadcast(0.5f), z, cosPolynomial);
+                cosPolynomial = _mm512_add_ps(cosPolynomial, broadcast(1.0f));
+
+                __m512 sinPolynomial = _mm512_fmadd_ps(broadcast(SIN_0), z, broadcast(SIN_1));
+                sinPolynomial = _mm512_fmadd_ps(sinPolynomial, z, broadcast(SIN_2));
+                sinPolynomial = _mm512_fmadd_ps(_mm512_mul_ps(sinPolynomial, z), x, x);
+
+                const __m512 sinValue = _mm512_mask_blend_ps(swap, sinPolynomial, cosPolynomial);
+                const __m512 cosValue = _mm512_mask_blend_ps(swap, cosPolynomial, sinPolynomial);
+                sin = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(sinValue), sinSign));
+                cos = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(cosValue), cosSign));
+            }
+        };
+    }  // namespace
+
+    void computeAvx512(const TransformArrays &arrays, size_t begin, size_t end) {
+        compute<Avx512>(arrays, begin, end);
+    }
+}  // namespace lve::transform_kernels
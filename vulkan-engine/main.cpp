@@ -1,10 +1,113 @@
 #include "first_app.hpp"
+#include "headless_app.hpp"
+#include "transform_benchmark.hpp"
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
-int main() {
-    lve::FirstApp app{};
+namespace {
+    // A comma separated list of present modes, e.g. "mailbox,fifo".
+    std::vector<VkPresentModeKHR> parsePresentModes(const std::string &list) {
+        std::vector<VkPresentModeKHR> presentModes;
+        size_t begin = 0;
+        while (begin <= list.size()) {
+            size_t end = list.find(',', begin);
+            if (end == std::string::npos) {
+                end = list.size();
+            }
+            const std::string name = list.substr(begin, end - begin);
+            if (name == "immediate") {
+                presentModes.push_back(VK_PRESENT_MODE_IMMEDIATE_KHR);
+            } else if (name == "mailbox") {
+                presentModes.push_back(VK_PRESENT_MODE_MAILBOX_KHR);
+            } else if (name == "fifo") {
+                presentModes.push_back(VK_PRESENT_MODE_FIFO_KHR);
+            } else if (name == "fifo-relaxed") {
+                presentModes.push_back(VK_PRESENT_MODE_FIFO_RELAXED_KHR);
+            } else {
+                throw std::runtime_error("Unknown present mode: " + name);
+            }
+            begin = end + 1;
+        }
+        return presentModes;
+    }
+}  // namespace
+
+int main(int argc, char **argv) {
+    // vulkan-engine --headless [frame count] [output.ppm]
+    // Renders without a window, e.g. on a server with lavapipe.
+    if (argc > 1 && std::strcmp(argv[1], "--headless") == 0) {
+        try {
+            const uint32_t frameCount =
+                argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 1000;
+            const std::string outputPath = argc > 3 ? argv[3] : "";
+            lve::HeadlessApp app{};
+            app.run(frameCount, outputPath);
+        } catch (const std::exception &e) {
+            std::cout << e.what() << "\n";
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // vulkan-engine --transform-benchmark [object count] [iterations]
+    // Times the transform batch kernels against TransformComponent. Needs no GPU.
+    if (argc > 1 && std::strcmp(argv[1], "--transform-benchmark") == 0) {
+        try {
+            const uint32_t objectCount =
+                argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 100000;
+            const uint32_t iterations = argc > 3 ? static_cast<uint32_t>(std::stoul(argv[3])) : 100;
+            lve::runTransformBenchmark(objectCount, iterations);
+        } catch (const std::exception &e) {
+            std::cout << e.what() << "\n";
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // vulkan-engine [--present-modes mailbox,immediate,fifo,fifo-relaxed] [--fps-limit N]
+    //               [--low-latency] [--frames-in-flight 1-3] [--image-count N] [--depth16]
+    //               [--gpu-budget MS] [--depth-prepass] [--alternate-depth-prepass]
+    //               [--depth-complexity N]
+    // Comparing frames with and without a depth pre-pass on a scene with a lot of overdraw:
+    // vulkan-engine --depth-complexity 16 --alternate-depth-prepass
+    lve::FirstApp::Settings settings{};
+    try {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (arg == "--present-modes" && i + 1 < argc) {
+                settings.presentModes = parsePresentModes(argv[++i]);
+            } else if (arg == "--fps-limit" && i + 1 < argc) {
+                settings.frameRateLimit = std::stod(argv[++i]);
+            } else if (arg == "--low-latency") {
+                settings.lowLatency = true;
+            } else if (arg == "--frames-in-flight" && i + 1 < argc) {
+                settings.framesInFlight = std::stoi(argv[++i]);
+            } else if (arg == "--image-count" && i + 1 < argc) {
+                settings.imageCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (arg == "--depth16") {
+                settings.compactDepth = true;
+            } else if (arg == "--gpu-budget" && i + 1 < argc) {
+                settings.gpuTimeBudgetMs = std::stod(argv[++i]);
+            } else if (arg == "--depth-prepass") {
+                settings.depthPrepass = true;
+            } else if (arg == "--alternate-depth-prepass") {
+                settings.alternateDepthPrepass = true;
+            } else if (arg == "--depth-complexity" && i + 1 < argc) {
+                settings.depthComplexity = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else {
+                throw std::runtime_error("Unknown argument: " + arg);
+            }
+        }
+    } catch (const std::exception &e) {
+        std::cout << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    lve::FirstApp app{settings};
     try {
         app.run();
     } catch (const std::exception &e) {
@@ -0,0 +1,428 @@
+#include "occlusion_culling_render_system.hpp"
+
+// Signal GLM to expect angles to be specified in radians
+#define GLM_FORCE_RADIANS
+// Signal GLM to expect the depth buffer values to range from 0 to 1. OpenGL is -1 to 1.
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <glm/glm.hpp>
+#include <stdexcept>
+
+#include "lve_swap_chain.hpp"
+#include "shaders/indirect_shader.frag.spv.hpp"
+#include "shaders/indirect_shader.vert.spv.hpp"
+#include "shaders/occlusion_cull.comp.spv.hpp"
+
+namespace lve {
+
+    namespace {
+        // Must match the local size of occlusion_cull.comp.
+        constexpr uint32_t CULL_WORKGROUP_SIZE = 64;
+        // Five uints, which fit both VkDrawIndexedIndirectCommand and VkDrawIndirectCommand.
+        constexpr uint32_t COMMAND_STRIDE = sizeof(VkDrawIndexedIndirectCommand);
+        constexpr uint32_t MIN_OBJECT_CAPACITY = 1024;
+
+        // Matches ObjectData in the shaders, with std430 layout.
+        struct ObjectData {
+            glm::mat4 modelMatrix{1.f};
+            glm::mat4 normalMatrix{1.f};
+            glm::vec4 boundsMin{0.f};
+            glm::vec4 boundsMax{0.f};
+            // x: vertex or index count, y: 1 if the model is indexed.
+            glm::uvec4 drawInfo{0};
+        };
+
+        struct DrawPushConstantData {
+            glm::mat4 projectionView{1.f};
+        };
+
+        struct CullPushConstantData {
+            glm::mat4 projectionView{1.f};
+            uint32_t depthWidth;
+            uint32_t depthHeight;
+            uint32_t objectCount;
+            uint32_t pyramidLevelCount;
+            uint32_t phase;
+        };
+    }  // namespace
+
+    OcclusionCullingRenderSystem::OcclusionCullingRenderSystem(
+        LVEDevice &device,
+        LVEPipelineManager &pipelineManager,
+        const PipelineRenderTarget &renderTarget,
+        const SimpleRenderSystem::Lighting &lighting)
+        : lveDevice{device}, depthPyramid{device} {
+        createDescriptorSetLayouts();
+        createPipelineLayouts();
+        createPipelines(pipelineManager, renderTarget, lighting);
+    }
+
+    OcclusionCullingRenderSystem::~OcclusionCullingRenderSystem() {
+        vkDestroyPipelineLayout(lveDevice.device(), pipelineLayout, nullptr);
+        vkDestroyPipelineLayout(lveDevice.device(), cullPipelineLayout, nullptr);
+    }
+
+    void OcclusionCullingRenderSystem::createDescriptorSetLayouts() {
+        objectSetLayout =
+            LVEDescriptorSetLayout::Builder{lveDevice}
+                .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+                .build();
+        cullSetLayout =
+            LVEDescriptorSetLayout::Builder{lveDevice}
+                .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                .addBinding(
+                    4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+                .build();
+    }
+
+    void OcclusionCullingRenderSystem::createPipelineLayouts() {
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(DrawPushConstantData);
+
+        VkDescriptorSetLayout setLayout = objectSetLayout->getDescriptorSetLayout();
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &setLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        if (vkCreatePipelineLayout(
+                lveDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create pipeline layout");
+        }
+
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.size = sizeof(CullPushConstantData);
+        setLayout = cullSetLayout->getDescriptorSetLayout();
+        if (vkCreatePipelineLayout(lveDevice.device(),
+                                   &pipelineLayoutInfo,
+                                   nullptr,
+                                   &cullPipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create pipeline layout");
+        }
+    }
+
+    void OcclusionCullingRenderSystem::createPipelines(
+        LVEPipelineManager &pipelineManager,
+        const PipelineRenderTarget &renderTarget,
+        const SimpleRenderSystem::Lighting &lighting) {
+        auto pipelineConfig = std::make_unique<PipelineConfigInfo>();
+        LVEPipeline::defaultPipelineConfigInfo(*pipelineConfig);
+        renderTarget.applyTo(*pipelineConfig);
+        pipelineConfig->pipelineLayout = pipelineLayout;
+        pipelineConfig->vertexSpecialization = lighting.specialization();
+        drawState = DrawState::fromConfig(*pipelineConfig);
+        LVEPipeline::makeDrawStateDynamic(*pipelineConfig, lveDevice);
+        auto pipelineHandle = pipelineManager.request("indirect",
+                                                      shaders::INDIRECT_SHADER_VERT,
+                                                      shaders::INDIRECT_SHADER_FRAG,
+                                                      std::move(pipelineConfig));
+
+        cullPipeline = std::make_unique<LVEComputePipeline>(
+            lveDevice, shaders::OCCLUSION_CULL_COMP, cullPipelineLayout);
+        lvePipeline = pipelineHandle.get();
+    }
+
+    void OcclusionCullingRenderSystem::createBuffers(uint32_t objectCapacity) {
+        // Frames in flight may still use the old buffers and bind their sets. The buffers retire
+        // on their own, and so does the pool the sets came from.
+        if (descriptorPool != nullptr) {
+            std::shared_ptr<LVEDescriptorPool> oldPool = std::move(descriptorPool);
+            lveDevice.deferDestruction([oldPool]() mutable { oldPool.reset(); });
+        }
+        capacity = objectCapacity;
+
+        objectBuffers.clear();
+        for (int i = 0; i < LVESwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+            auto buffer = std::make_unique<LVEBuffer>(
+                lveDevice,
+                sizeof(ObjectData),
+                capacity,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            // Stays mapped for the lifetime of the buffer.
+            buffer->map();
+            objectBuffers.push_back(std::move(buffer));
+        }
+        visibilityBuffer =
+            std::make_unique<LVEBuffer>(lveDevice,
+                                        sizeof(uint32_t),
+                                        capacity,
+                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        earlyCommandsBuffer = std::make_unique<LVEBuffer>(
+            lveDevice,
+            COMMAND_STRIDE,
+            capacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        lateCommandsBuffer = std::make_unique<LVEBuffer>(
+            lveDevice,
+            COMMAND_STRIDE,
+            capacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        // Nothing counts as visible last frame. Phase 2 then tests and draws everything.
+        clearVisibility = true;
+
+        const uint32_t setCount = 2 * LVESwapChain::MAX_FRAMES_IN_FLIGHT;
+        descriptorPool =
+            LVEDescriptorPool::Builder{lveDevice}
+                .setMaxSets(setCount)
+                .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 * setCount)
+                .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount)
+                .build();
+        objectSets.resize(LVESwapChain::MAX_FRAMES_IN_FLIGHT);
+        cullSets.resize(LVESwapChain::MAX_FRAMES_IN_FLIGHT);
+        for (int i = 0; i < LVESwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+            auto objectInfo = objectBuffers[i]->descriptorInfo();
+            if (!LVEDescriptorWriter{*objectSetLayout, *descriptorPool}
+                     .writeBuffer(0, &objectInfo)
+                     .build(objectSets[i])) {
+                throw std::runtime_error("Failed to allocate object descriptor set");
+            }
+            // Written every frame in prepareFrame.
+            if (!descriptorPool->allocateDescriptor(cullSetLayout->getDescriptorSetLayout(),
+                                                    cullSets[i])) {
+                throw std::runtime_error("Failed to allocate culling descriptor set");
+            }
+        }
+    }
+
+    void OcclusionCullingRenderSystem::prepareFrame(int frameIndex,
+                                                    LVEScene &scene,
+                                                    const LVECamera &camera,
+                                                    VkExtent2D depthExtent) {
+        currentFrameIndex = frameIndex;
+        projectionView = camera.getProjection() * camera.getView();
+
+        // Group objects by model. The sort is stable, so an object keeps its slot, and with it
+        // its visibility from last frame, as long as the scene does not change.
+        auto &renderables = scene.pool<RenderComponent>();
+        auto &transforms = scene.pool<TransformComponent>();
+        drawList.clear();
+        drawList.reserve(renderables.size());
+        for (uint32_t i = 0; i < static_cast<uint32_t>(renderables.size()); i++) {
+            const auto &renderable = renderables.at(i);
+            if (renderable.model != nullptr && transforms.contains(renderables.entityAt(i))) {
+                drawList.add(DrawKey::make(0, 0, renderable.model->getId(), 0.f), i);
+            }
+        }
+        drawList.sort();
+        objectCount = static_cast<uint32_t>(drawList.size());
+
+        if (objectCount > capacity) {
+            uint32_t newCapacity = std::max(capacity, MIN_OBJECT_CAPACITY);
+            while (newCapacity < objectCount) {
+                newCapacity *= 2;
+            }
+            createBuffers(newCapacity);
+        }
+        if (capacity == 0) {
+            return;
+        }
+        depthPyramid.resize(depthExtent);
+
+        // beginFrame waited for the last frame that used this buffer.
+        auto *objects = static_cast<ObjectData *>(objectBuffers[frameIndex]->getMappedMemory());
+        batches.clear();
+        for (uint32_t slot = 0; slot < objectCount; slot++) {
+            const uint32_t position = drawList[slot].objectIndex;
+            LVEModel *model = renderables.at(position).model.get();
+            const auto &transform = *transforms.tryGet(renderables.entityAt(position), position);
+            const auto &bounds = model->getBoundingBox();
+
+            ObjectData &data = objects[slot];
+            data.modelMatrix = transform.modelToWorldMatrix();
+            data.normalMatrix = transform.normalToWorldMatrix();
+            data.boundsMin = glm::vec4{bounds.min, 0.f};
+            data.boundsMax = glm::vec4{bounds.max, 0.f};
+            data.drawInfo = glm::uvec4{model->hasIndices() ? model->getIndexCount()
+                                                           : model->getVertexCount(),
+                                       model->hasIndices() ? 1u : 0u,
+                                       0u,
+                                       0u};
+
+            if (batches.empty() || batches.back().model != model) {
+                batches.push_back({model, slot, 0});
+            }
+            batches.back().objectCount++;
+        }
+
+        // The set of this frame index is not in use anymore, so it can be rewritten. The pyramid
+        // may have been recreated since it was last used.
+        auto objectInfo = objectBuffers[frameIndex]->descriptorInfo();
+        auto visibilityInfo = visibilityBuffer->descriptorInfo();
+        auto earlyCommandsInfo = earlyCommandsBuffer->descriptorInfo();
+        auto lateCommandsInfo = lateCommandsBuffer->descriptorInfo();
+        auto pyramidInfo = depthPyramid.descriptorInfo();
+        LVEDescriptorWriter{*cullSetLayout, *descriptorPool}
+            .writeBuffer(0, &objectInfo)
+            .writeBuffer(1, &visibilityInfo)
+            .writeBuffer(2, &earlyCommandsInfo)
+            .writeBuffer(3, &lateCommandsInfo)
+            .writeImage(4, &pyramidInfo)
+            .overwrite(cullSets[frameIndex]);
+    }
+
+    void OcclusionCullingRenderSystem::cullVisibleLastFrame(VkCommandBuffer commandBuffer) {
+        if (objectCount == 0) {
+            return;
+        }
+
+        if (clearVisibility) {
+            vkCmdFillBuffer(commandBuffer, visibilityBuffer->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+            clearVisibility = false;
+        }
+        depthPyramid.recordInitialization(commandBuffer);
+
+        // The previous frame's culling wrote the visibility, and its draws read the commands we
+        // are about to overwrite.
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                                 VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0,
+                             1,
+                             &barrier,
+                             0,
+                             nullptr,
+                             0,
+                             nullptr);
+
+        dispatchCulling(commandBuffer, 0);
+    }
+
+    void OcclusionCullingRenderSystem::cullRemaining(VkCommandBuffer commandBuffer,
+                                                     VkImage depthImage,
+                                                     VkImageView depthImageView,
+                                                     VkFormat depthFormat) {
+        if (objectCount == 0) {
+            return;
+        }
+        // Ends with the barriers the culling needs to read the pyramid. They also order this
+        // dispatch after the one of phase 1.
+        depthPyramid.build(
+            commandBuffer, currentFrameIndex, depthImage, depthImageView, depthFormat);
+        dispatchCulling(commandBuffer, 1);
+    }
+
+    void OcclusionCullingRenderSystem::dispatchCulling(VkCommandBuffer commandBuffer,
+                                                       uint32_t phase) {
+        cullPipeline->bind(commandBuffer);
+        vkCmdBindDescriptorSets(commandBuffer,
+                                VK_PIPELINE_BIND_POINT_COMPUTE,
+                                cullPipelineLayout,
+                                0,
+                                1,
+                                &cullSets[currentFrameIndex],
+                                0,
+                                nullptr);
+
+        const VkExtent2D depthExtent = depthPyramid.getDepthExtent();
+        CullPushConstantData push{};
+        push.projectionView = projectionView;
+        push.depthWidth = depthExtent.width;
+        push.depthHeight = depthExtent.height;
+        push.objectCount = objectCount;
+        push.pyramidLevelCount = depthPyramid.getLevelCount();
+        push.phase = phase;
+        vkCmdPushConstants(commandBuffer,
+                           cullPipelineLayout,
+                           VK_SHADER_STAGE_COMPUTE_BIT,
+                           0,
+                           sizeof(CullPushConstantData),
+                           &push);
+        vkCmdDispatch(
+            commandBuffer, (objectCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+
+        // The draws read the commands, and the vertex shader reads nothing the culling wrote.
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                             0,
+                             1,
+                             &barrier,
+                             0,
+                             nullptr,
+                             0,
+                             nullptr);
+    }
+
+    void OcclusionCullingRenderSystem::renderVisibleLastFrame(VkCommandBuffer commandBuffer) {
+        drawBatches(commandBuffer, *earlyCommandsBuffer);
+    }
+
+    void OcclusionCullingRenderSystem::renderNewlyVisible(VkCommandBuffer commandBuffer) {
+        drawBatches(commandBuffer, *lateCommandsBuffer);
+    }
+
+    void OcclusionCullingRenderSystem::drawBatches(VkCommandBuffer commandBuffer,
+                                                   const LVEBuffer &commandsBuffer) {
+        if (objectCount == 0) {
+            return;
+        }
+
+        lvePipeline->bind(commandBuffer);
+        lvePipeline->setDrawState(commandBuffer, drawState);
+        vkCmdBindDescriptorSets(commandBuffer,
+                                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                pipelineLayout,
+                                0,
+                                1,
+                                &objectSets[currentFrameIndex],
+                                0,
+                                nullptr);
+        DrawPushConstantData push{};
+        push.projectionView = projectionView;
+        vkCmdPushConstants(commandBuffer,
+                           pipelineLayout,
+                           VK_SHADER_STAGE_VERTEX_BIT,
+                           0,
+                           sizeof(DrawPushConstantData),
+                           &push);
+
+        // Without multiDrawIndirect every indirect call draws a single command.
+        const uint32_t maxDrawCount = lveDevice.enabledFeatures.multiDrawIndirect
+                                          ? lveDevice.properties.limits.maxDrawIndirectCount
+                                          : 1;
+        for (const auto &batch : batches) {
+            batch.model->bind(commandBuffer);
+            for (uint32_t first = 0; first < batch.objectCount; first += maxDrawCount) {
+                const uint32_t drawCount = std::min(maxDrawCount, batch.objectCount - first);
+                const VkDeviceSize offset =
+                    static_cast<VkDeviceSize>(batch.firstObject + first) * COMMAND_STRIDE;
+                if (batch.model->hasIndices()) {
+                    vkCmdDrawIndexedIndirect(commandBuffer,
+                                             commandsBuffer.getBuffer(),
+                                             offset,
+                                             drawCount,
+                                             COMMAND_STRIDE);
+                } else {
+                    vkCmdDrawIndirect(commandBuffer,
+                                      commandsBuffer.getBuffer(),
+                                      offset,
+                                      drawCount,
+                                      COMMAND_STRIDE);
+                }
+            }
+        }
+    }
+}  // namespace lve
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "lve_buffer.hpp"
+#include "lve_camera.hpp"
+#include "lve_components.hpp"
+#include "lve_compute_pipeline.hpp"
+#include "lve_descriptors.hpp"
+#include "lve_device.hpp"
+#include "lve_draw_list.hpp"
+#include "lve_hiz_pyramid.hpp"
+#include "lve_model.hpp"
+#include "lve_pipeline.hpp"
+#include "lve_scene.hpp"
+#include "simple_render_system.hpp"
+
+namespace lve {
+    /**
+     * @brief Renders the entities of a scene with indirect draws that are culled on the GPU, in
+     * two phases.
+     * 1. Draw the objects that were visible last frame, as long as they are inside the view
+     *    frustum. They are very likely visible again and make good occluders.
+     * 2. Build a depth pyramid from what was drawn, test every object against it and draw the
+     *    objects that turned out visible but were not drawn yet. The results become the visible
+     *    set of the next frame.
+     * The CPU only uploads the object transforms. Which objects are drawn never travels back to
+     * the CPU, so the cost on the CPU stays flat no matter how many objects are hidden.
+     *
+     * A frame is recorded as
+     * prepareFrame, cullVisibleLastFrame, [render pass] renderVisibleLastFrame [end],
+     * cullRemaining, [continued render pass] renderNewlyVisible [end].
+     */
+    class OcclusionCullingRenderSystem {
+       public:
+        OcclusionCullingRenderSystem(LVEDevice &device,
+                                     LVEPipelineManager &pipelineManager,
+                                     const PipelineRenderTarget &renderTarget,
+                                     const SimpleRenderSystem::Lighting &lighting = {});
+        ~OcclusionCullingRenderSystem();
+
+        OcclusionCullingRenderSystem(const OcclusionCullingRenderSystem &) = delete;
+        OcclusionCullingRenderSystem &operator=(const OcclusionCullingRenderSystem &) = delete;
+
+        // The culling selects the object of an indirect draw through its first instance.
+        static bool isSupported(LVEDevice &device) {
+            return device.enabledFeatures.drawIndirectFirstInstance == VK_TRUE;
+        }
+
+        // Uploads the objects for this frame. Must be called before anything else is recorded for
+        // the frame. depthExtent is the size of the swap chain depth attachment.
+        void prepareFrame(int frameIndex,
+                          LVEScene &scene,
+                          const LVECamera &camera,
+                          VkExtent2D depthExtent);
+        // Phase 1. Recorded outside of a render pass.
+        void cullVisibleLastFrame(VkCommandBuffer commandBuffer);
+        // Phase 1. Recorded inside the swap chain render pass.
+        void renderVisibleLastFrame(VkCommandBuffer commandBuffer);
+        // Phase 2. Recorded outside of a render pass, after phase 1 has ended its render pass.
+        void cullRemaining(VkCommandBuffer commandBuffer,
+                           VkImage depthImage,
+                           VkImageView depthImageView,
+                           VkFormat depthFormat);
+        // Phase 2. Recorded inside the continued swap chain render pass.
+        void renderNewlyVisible(VkCommandBuffer commandBuffer);
+
+       private:
+        // Objects of the same model occupy consecutive command slots, so they can be drawn with a
+        // single multi draw.
+        struct Batch {
+            LVEModel *model;
+            uint32_t firstObject;
+            uint32_t objectCount;
+        };
+
+        void createDescriptorSetLayouts();
+        void createPipelineLayouts();
+        void createPipelines(LVEPipelineManager &pipelineManager,
+                             const PipelineRenderTarget &renderTarget,
+                             const SimpleRenderSystem::Lighting &lighting);
+        void createBuffers(uint32_t objectCapacity);
+        void dispatchCulling(VkCommandBuffer commandBuffer, uint32_t phase);
+        void drawBatches(VkCommandBuffer commandBuffer, const LVEBuffer &commandsBuffer);
+
+        LVEDevice &lveDevice;
+
+        std::unique_ptr<LVEDescriptorSetLayout> objectSetLayout;
+        std::unique_ptr<LVEDescriptorSetLayout> cullSetLayout;
+        // Recreated with the buffers in createBuffers.
+        std::unique_ptr<LVEDescriptorPool> descriptorPool;
+        VkPipelineLayout pipelineLayout;
+        VkPipelineLayout cullPipelineLayout;
+        std::shared_ptr<LVEPipeline> lvePipeline;
+        DrawState drawState{};
+        std::unique_ptr<LVEComputePipeline> cullPipeline;
+        LVEHiZPyramid depthPyramid;
+
+        uint32_t capacity = 0;
+        // One per frame in flight, since the CPU writes them while the GPU may still read the
+        // previous frame's.
+        std::vector<std::unique_ptr<LVEBuffer>> objectBuffers;
+        std::vector<VkDescriptorSet> objectSets;
+        std::vector<VkDescriptorSet> cullSets;
+        // Only touched by the GPU, so a single copy is enough.
+        std::unique_ptr<LVEBuffer> visibilityBuffer;
+        std::unique_ptr<LVEBuffer> earlyCommandsBuffer;
+        std::unique_ptr<LVEBuffer> lateCommandsBuffer;
+        bool clearVisibility = false;
+
+        LVEDrawList drawList;
+        std::vector<Batch> batches;
+        int currentFrameIndex = 0;
+        uint32_t objectCount = 0;
+        glm::mat4 projectionView{1.f};
+    };
+}  // namespace lve
@@ -0,0 +1,17 @@
+#version 450
+
+// Only the position is fetched. The other attributes of the vertex buffer are skipped.
+layout(location = 0) in vec3 position;
+
+// Same as simple_shader.vert, so both pipelines can share a pipeline layout.
+layout(push_constant) uniform Push {
+    mat4 transform; // projection * view * model
+    mat4 normalMatrix; // normal to world
+} push;
+
+// Must match simple_shader.vert bit for bit, so the main pass finds the same depth values.
+invariant gl_Position;
+
+void main() {
+    gl_Position = push.transform * vec4(position, 1.0);
+}
@@ -0,0 +1,11 @@
+#version 450
+
+layout(location = 0) in vec3 fragColor;
+
+// Declare output variable
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    // RGBA
+    outColor = vec4(fragColor, 1.0);
+}
@@ -0,0 +1,49 @@
+#version 450
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec3 normal;
+layout(location = 3) in vec2 uv;
+
+layout(location = 0) out vec3 fragColor;
+
+struct ObjectData {
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+    vec4 boundsMin;
+    vec4 boundsMax;
+    uvec4 drawInfo;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Objects {
+    ObjectData objects[];
+};
+
+layout(push_constant) uniform Push {
+    mat4 projectionView;
+} push;
+
+// Specialization constants, see SimpleRenderSystem::Lighting. The direction is in world space and
+// not normalized.
+layout(constant_id = 0) const float DIRECTION_TO_LIGHT_X = 1.0;
+layout(constant_id = 1) const float DIRECTION_TO_LIGHT_Y = -3.0;
+layout(constant_id = 2) const float DIRECTION_TO_LIGHT_Z = -1.0;
+layout(constant_id = 3) const float AMBIENT = 0.02;
+const vec3 DIRECTION_TO_LIGHT =
+    vec3(DIRECTION_TO_LIGHT_X, DIRECTION_TO_LIGHT_Y, DIRECTION_TO_LIGHT_Z);
+
+// Same as simple_shader.vert, except that the per object data comes from a storage buffer.
+// Indirect draws cannot push constants per draw, so the culling shader stores the object index in
+// firstInstance, which is included in gl_InstanceIndex.
+void main() {
+    ObjectData object = objects[gl_InstanceIndex];
+    gl_Position = push.projectionView * object.modelMatrix * vec4(position, 1.0);
+
+    vec3 normalWorldSpace = normalize(mat3(object.normalMatrix) * normal);
+
+    // Folded into a constant once the pipeline is specialized.
+    vec3 directionToLight = normalize(DIRECTION_TO_LIGHT);
+    float lightIntensity = AMBIENT + max(dot(normalWorldSpace, directionToLight), 0);
+
+    fragColor = lightIntensity * color;
+}
@@ -7,14 +7,22 @@ layout(location = 3) in vec2 uv;
 
 layout(location = 0) out vec3 fragColor;
 
+// Must match depth_prepass.vert bit for bit, so the main pass finds the depth of the pre-pass.
+invariant gl_Position;
+
 layout(push_constant) uniform Push {
     mat4 transform; // projection * view * model
     mat4 normalMatrix; // normal to world
 } push;
 
-// In world space
-const vec3 DIRECTION_TO_LIGHT = normalize(vec3(1.0, -3.0, -1.0));
-const float AMBIENT = 0.02;
+// Specialization constants, see SimpleRenderSystem::Lighting. The direction is in world space and
+// not normalized.
+layout(constant_id = 0) const float DIRECTION_TO_LIGHT_X = 1.0;
+layout(constant_id = 1) const float DIRECTION_TO_LIGHT_Y = -3.0;
+layout(constant_id = 2) const float DIRECTION_TO_LIGHT_Z = -1.0;
+layout(constant_id = 3) const float AMBIENT = 0.02;
+const vec3 DIRECTION_TO_LIGHT =
+    vec3(DIRECTION_TO_LIGHT_X, DIRECTION_TO_LIGHT_Y, DIRECTION_TO_LIGHT_Z);
 
 // Executed once for each vertex we provide
 void main() {
@@ -25,7 +33,9 @@ void main() {
 
     vec3 normalWorldSpace = normalize(mat3(push.normalMatrix) * normal);
 
-    float lightIntensity = AMBIENT + max(dot(normalWorldSpace, DIRECTION_TO_LIGHT), 0);
+    // Folded into a constant once the pipeline is specialized.
+    vec3 directionToLight = normalize(DIRECTION_TO_LIGHT);
+    float lightIntensity = AMBIENT + max(dot(normalWorldSpace, directionToLight), 0);
 
     fragColor = lightIntensity * color;
 }
@@ -8,8 +8,13 @@
 #include <cassert>
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
+#include <iostream>
 #include <stdexcept>
 
+#include "shaders/depth_prepass.vert.spv.hpp"
+#include "shaders/simple_shader.frag.spv.hpp"
+#include "shaders/simple_shader.vert.spv.hpp"
+
 namespace lve {
 
     struct SimplePushConstantData {
@@ -20,10 +25,14 @@ namespace lve {
         // alignas(16) glm::vec3 color;  // Pay attention to alignment requirements
     };
 
-    SimpleRenderSystem::SimpleRenderSystem(LVEDevice& device, VkRenderPass renderPass)
+    SimpleRenderSystem::SimpleRenderSystem(LVEDevice& device,
+                                           LVEPipelineManager& pipelineManager,
+                                           const PipelineRenderTarget& renderTarget,
+                                           const PipelineRenderTarget* depthPrepassTarget,
+                                           const Lighting& lighting)
         : lveDevice{device} {
         createPipelineLayout();
-        createPipeline(renderPass);
+        createPipeline(pipelineManager, renderTarget, depthPrepassTarget, lighting);
     }
 
     SimpleRenderSystem::~SimpleRenderSystem() {
@@ -53,33 +62,189 @@ namespace lve {
         }
     }
 
-    void SimpleRenderSystem::createPipeline(VkRenderPass renderPass) {
+    void SimpleRenderSystem::createPipeline(LVEPipelineManager& pipelineManager,
+                                            const PipelineRenderTarget& renderTarget,
+                                            const PipelineRenderTarget* depthPrepassTarget,
+                                            const Lighting& lighting) {
         assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
-        PipelineConfigInfo pipelineConfig{};
-        LVEPipeline::defaultPipelineConfigInfo(pipelineConfig);
-        // A render pass describes the structure and format of frame buffer objects and their
-        // attachments.
-        pipelineConfig.renderPass = renderPass;
-        pipelineConfig.pipelineLayout = pipelineLayout;
-        lvePipeline = std::make_unique<LVEPipeline>(
-            lveDevice,
-            "..\\..\\..\\..\\vulkan-engine\\shaders\\simple_shader.vert.spv",
-            "..\\..\\..\\..\\vulkan-engine\\shaders\\simple_shader.frag.spv",
-            pipelineConfig);
+        auto mainConfig = [&]() {
+            auto pipelineConfig = std::make_unique<PipelineConfigInfo>();
+            LVEPipeline::defaultPipelineConfigInfo(*pipelineConfig);
+            // A render pass describes the structure and format of frame buffer objects and their
+            // attachments. With dynamic rendering, only the attachment formats are given.
+            renderTarget.applyTo(*pipelineConfig);
+            pipelineConfig->pipelineLayout = pipelineLayout;
+            pipelineConfig->vertexSpecialization = lighting.specialization();
+            return pipelineConfig;
+        };
+        // With the draw state dynamic, the pipeline matches any other with the same shaders and
+        // outputs, including the one after the pre-pass.
+        auto pipelineConfig = mainConfig();
+        drawState = DrawState::fromConfig(*pipelineConfig);
+        LVEPipeline::makeDrawStateDynamic(*pipelineConfig, lveDevice);
+        // All are requested before waiting for any, so they can compile in parallel.
+        auto pipelineHandle = pipelineManager.request("simple",
+                                                      shaders::SIMPLE_SHADER_VERT,
+                                                      shaders::SIMPLE_SHADER_FRAG,
+                                                      std::move(pipelineConfig));
+        if (depthPrepassTarget != nullptr) {
+            auto prepassConfig = std::make_unique<PipelineConfigInfo>();
+            LVEPipeline::depthPrepassPipelineConfigInfo(*prepassConfig);
+            depthPrepassTarget->applyTo(*prepassConfig);
+            prepassConfig->pipelineLayout = pipelineLayout;
+            depthPrepassDrawState = DrawState::fromConfig(*prepassConfig);
+            LVEPipeline::makeDrawStateDynamic(*prepassConfig, lveDevice);
+            // No fragment shader. The pre-pass only writes depth.
+            depthPrepassHandle = pipelineManager.request("simple depth prepass",
+                                                         shaders::DEPTH_PREPASS_VERT,
+                                                         ShaderCode{},
+                                                         std::move(prepassConfig));
+
+            auto afterPrepassConfig = mainConfig();
+            LVEPipeline::enableDepthPrepassTest(*afterPrepassConfig);
+            afterDepthPrepassDrawState = DrawState::fromConfig(*afterPrepassConfig);
+            LVEPipeline::makeDrawStateDynamic(*afterPrepassConfig, lveDevice);
+            afterDepthPrepassHandle = pipelineManager.request("simple after depth prepass",
+                                                              shaders::SIMPLE_SHADER_VERT,
+                                                              shaders::SIMPLE_SHADER_FRAG,
+                                                              std::move(afterPrepassConfig));
+        }
+
+        // Nothing can be drawn without it. The pre-pass is optional and picked up later.
+        lvePipeline = pipelineHandle.get();
+    }
+
+    void SimpleRenderSystem::prepareDrawList(LVEScene& scene,
+                                             const LVECamera& camera,
+                                             const std::vector<uint8_t>* visibility) {
+        // Decided once per frame, so that all passes of the frame agree. Frames go without the
+        // pre-pass until its pipelines are compiled, instead of waiting for them.
+        if (depthPrepassPipeline == nullptr && depthPrepassHandle.valid()) {
+            try {
+                auto prepass = LVEPipelineManager::getIfReady(depthPrepassHandle);
+                auto afterPrepass = LVEPipelineManager::getIfReady(afterDepthPrepassHandle);
+                if (prepass != nullptr && afterPrepass != nullptr) {
+                    depthPrepassPipeline = std::move(prepass);
+                    afterDepthPrepassPipeline = std::move(afterPrepass);
+                }
+            } catch (const std::exception& e) {
+                // The pre-pass is optional, so frames go on without it for good.
+                std::cout << "Depth pre-pass disabled, its pipelines failed to compile: "
+                          << e.what() << std::endl;
+                depthPrepassHandle = {};
+                afterDepthPrepassHandle = {};
+            }
+        }
+        useDepthPrepass = depthPrepassEnabled && depthPrepassPipeline != nullptr;
+
+        auto& renderables = scene.pool<RenderComponent>();
+        auto& transforms = scene.pool<TransformComponent>();
+        drawList.clear();
+        drawList.reserve(renderables.size());
+        auto projectionView = camera.getProjection() * camera.getView();
+        // Draws refer to their entity by its position in the RenderComponent pool.
+        for (uint32_t i = 0; i < static_cast<uint32_t>(renderables.size()); i++) {
+            const auto& renderable = renderables.at(i);
+            if (renderable.model == nullptr) {
+                continue;
+            }
+            if (visibility != nullptr && !(*visibility)[i]) {
+                continue;
+            }
+            const TransformComponent* transform = transforms.tryGet(renderables.entityAt(i), i);
+            if (transform == nullptr) {
+                continue;
+            }
+            // The depth of the object's origin is enough to order draws roughly front to back.
+            const glm::vec4 clipPosition =
+                projectionView * glm::vec4{transform->getTranslation(), 1.f};
+            const float depth = clipPosition.w > 0.f ? clipPosition.z / clipPosition.w : 0.f;
+            // There are no materials yet. The field is kept at zero so that the key layout does
+            // not change once they are added.
+            drawList.add(DrawKey::make(lvePipeline->getId(), 0, renderable.model->getId(), depth),
+                         i);
+        }
+        drawList.sort();
+
+        std::lock_guard<std::mutex> lock{bindStatsMutex};
+        bindStats = {};
     }
 
-    void SimpleRenderSystem::renderGameObjects(VkCommandBuffer commandBuffer,
-                                               std::vector<LVEGameObject>& gameObjects,
-                                               const LVECamera& camera) {
+    void SimpleRenderSystem::renderEntities(VkCommandBuffer commandBuffer,
+                                            LVEScene& scene,
+                                            const LVECamera& camera) {
+        prepareDrawList(scene, camera);
+        // Nothing records a pre-pass here.
+        useDepthPrepass = false;
+        renderEntities(commandBuffer, scene, camera, 0, drawList.size());
+    }
+
+    void SimpleRenderSystem::renderEntities(VkCommandBuffer commandBuffer,
+                                            LVEScene& scene,
+                                            const LVECamera& camera,
+                                            size_t begin,
+                                            size_t end) {
+        if (useDepthPrepass) {
+            recordDraws(commandBuffer,
+                        *afterDepthPrepassPipeline,
+                        afterDepthPrepassDrawState,
+                        scene,
+                        camera,
+                        begin,
+                        end);
+        } else {
+            recordDraws(commandBuffer, *lvePipeline, drawState, scene, camera, begin, end);
+        }
+    }
+
+    void SimpleRenderSystem::renderDepthPrepass(VkCommandBuffer commandBuffer,
+                                                LVEScene& scene,
+                                                const LVECamera& camera,
+                                                size_t begin,
+                                                size_t end) {
+        assert(useDepthPrepass && "No depth pre-pass in this frame");
+        // The draw list is sorted front to back within each state, which is also the best order
+        // for the pre-pass.
+        recordDraws(commandBuffer,
+                    *depthPrepassPipeline,
+                    depthPrepassDrawState,
+                    scene,
+                    camera,
+                    begin,
+                    end);
+    }
+
+    void SimpleRenderSystem::recordDraws(VkCommandBuffer commandBuffer,
+                                         LVEPipeline& pipeline,
+                                         const DrawState& pipelineDrawState,
+                                         LVEScene& scene,
+                                         const LVECamera& camera,
+                                         size_t begin,
+                                         size_t end) {
         // Render
-        lvePipeline->bind(commandBuffer);
+        // Every command buffer starts without any bound state, including secondary ones, so each
+        // gets its own tracker.
+        LVECommandStateTracker stateTracker{commandBuffer};
         auto projectionView = camera.getProjection() * camera.getView();
-        for (auto& obj : gameObjects) {
+        // Both pools exist since prepareDrawList, so this is safe on several threads.
+        auto& renderables = scene.pool<RenderComponent>();
+        auto& transforms = scene.pool<TransformComponent>();
+        for (size_t i = begin; i < end; i++) {
+            const uint32_t position = drawList[i].objectIndex;
+            const auto& renderable = renderables.at(position);
+            const auto& transform = *transforms.tryGet(renderables.entityAt(position), position);
+            // Asked for on every draw, as a renderer with several pipelines would. The tracker
+            // turns all but the first into no-ops.
+            stateTracker.bindPipeline(pipeline);
+            // Only records anything after a pipeline bind, since the state is the same for all
+            // objects so far.
+            stateTracker.setDrawState(pipelineDrawState);
+
             SimplePushConstantData push{};
-            auto modelMatrix = obj.transform.modelToWorldMatrix();
+            auto modelMatrix = transform.modelToWorldMatrix();
             push.transform = projectionView * modelMatrix;
-            push.normalMatrix = obj.transform.normalToWorldMatrix();
+            push.normalMatrix = transform.normalToWorldMatrix();
 
             vkCmdPushConstants(commandBuffer,
                                pipelineLayout,
@@ -87,8 +252,16 @@ namespace lve {
                                0,
                                sizeof(SimplePushConstantData),
                                &push);
-            obj.model->bind(commandBuffer);
-            obj.model->draw(commandBuffer);
+            stateTracker.bindModel(*renderable.model);
+            renderable.model->draw(commandBuffer);
         }
+
+        std::lock_guard<std::mutex> lock{bindStatsMutex};
+        bindStats += stateTracker.getStats();
+    }
+
+    BindStats SimpleRenderSystem::getBindStats() const {
+        std::lock_guard<std::mutex> lock{bindStatsMutex};
+        return bindStats;
     }
 }  // namespace lve
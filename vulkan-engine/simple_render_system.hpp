@@ -1,38 +1,131 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include "lve_camera.hpp"
+#include "lve_command_state_tracker.hpp"
+#include "lve_components.hpp"
 #include "lve_device.hpp"
-#include "lve_game_object.hpp"
+#include "lve_draw_list.hpp"
 #include "lve_model.hpp"
 #include "lve_pipeline.hpp"
+#include "lve_pipeline_manager.hpp"
+#include "lve_scene.hpp"
 
 namespace lve {
     /**
      * @brief The SimpleRenderSystem manages a pipeline and its layout, and provides the
-     * functionality necessary to render a list of game objects.
+     * functionality necessary to render the entities of a scene that have a RenderComponent and a
+     * TransformComponent.
      */
     class SimpleRenderSystem {
        public:
-        SimpleRenderSystem(LVEDevice &device, VkRenderPass renderPass);
+        // Baked into simple_shader.vert and indirect_shader.vert as specialization constants, in
+        // the order of the members.
+        struct Lighting {
+            // In world space, does not need to be normalized.
+            float directionToLightX = 1.0f;
+            float directionToLightY = -3.0f;
+            float directionToLightZ = -1.0f;
+            float ambient = 0.02f;
+
+            ShaderSpecialization specialization() const {
+                return ShaderSpecialization::fromStruct(*this,
+                                                        &Lighting::directionToLightX,
+                                                        &Lighting::directionToLightY,
+                                                        &Lighting::directionToLightZ,
+                                                        &Lighting::ambient);
+            }
+        };
+
+        // If depthPrepassTarget is given, a depth pre-pass pipeline is requested as well, with a
+        // main pipeline that only draws what the pre-pass found to be nearest. Only the plain main
+        // pipeline is waited for. The pipelines come from pipelineManager, and are shared with
+        // other systems that use the same state.
+        SimpleRenderSystem(LVEDevice &device,
+                           LVEPipelineManager &pipelineManager,
+                           const PipelineRenderTarget &renderTarget,
+                           const PipelineRenderTarget *depthPrepassTarget = nullptr,
+                           const Lighting &lighting = {});
         ~SimpleRenderSystem();
 
         SimpleRenderSystem(const SimpleRenderSystem &) = delete;
         SimpleRenderSystem &operator=(const SimpleRenderSystem &) = delete;
 
-        void renderGameObjects(VkCommandBuffer commandBuffer,
-                               std::vector<LVEGameObject> &gameObjects,
-                               const LVECamera &camera);
+        // Builds this frame's draw list from the scene and sorts it by state and depth. If
+        // visibility is given, entities whose entry is 0 are left out. Entries are in the order
+        // of the RenderComponent pool. Also decides whether this frame has a depth pre-pass.
+        void prepareDrawList(LVEScene &scene,
+                             const LVECamera &camera,
+                             const std::vector<uint8_t> *visibility = nullptr);
+        size_t getDrawCount() const { return drawList.size(); }
+
+        // Prepares the draw list and records all of it, without a depth pre-pass.
+        void renderEntities(VkCommandBuffer commandBuffer,
+                            LVEScene &scene,
+                            const LVECamera &camera);
+        // Records the entries [begin, end) of the prepared draw list. Safe to call concurrently
+        // for disjoint ranges as long as every call records into its own command buffer.
+        void renderEntities(VkCommandBuffer commandBuffer,
+                            LVEScene &scene,
+                            const LVECamera &camera,
+                            size_t begin,
+                            size_t end);
+
+        // Records the depth of the entries [begin, end) of the prepared draw list. Recorded inside
+        // the depth pre-pass, before the same entries are rendered in the main pass.
+        void renderDepthPrepass(VkCommandBuffer commandBuffer,
+                                LVEScene &scene,
+                                const LVECamera &camera,
+                                size_t begin,
+                                size_t end);
+        // Whether the frame of the last prepareDrawList has a depth pre-pass. Not until its
+        // pipelines are compiled, which is not waited for.
+        bool hasDepthPrepass() const { return useDepthPrepass; }
+        // Turns the depth pre-pass on or off from the next prepareDrawList on, e.g. to compare
+        // frames with and without it. On by default, if there is a depth pre-pass target.
+        void setDepthPrepassEnabled(bool enabled) { depthPrepassEnabled = enabled; }
+        bool isDepthPrepassEnabled() const { return depthPrepassEnabled; }
+
+        // Binds issued and elided while recording the current draw list.
+        BindStats getBindStats() const;
 
        private:
         void createPipelineLayout();
-        void createPipeline(VkRenderPass renderPass);
+        void createPipeline(LVEPipelineManager &pipelineManager,
+                            const PipelineRenderTarget &renderTarget,
+                            const PipelineRenderTarget *depthPrepassTarget,
+                            const Lighting &lighting);
+        void recordDraws(VkCommandBuffer commandBuffer,
+                         LVEPipeline &pipeline,
+                         const DrawState &pipelineDrawState,
+                         LVEScene &scene,
+                         const LVECamera &camera,
+                         size_t begin,
+                         size_t end);
 
         LVEDevice &lveDevice;
 
-        std::unique_ptr<LVEPipeline> lvePipeline;
+        std::shared_ptr<LVEPipeline> lvePipeline;
+        // Share the pipeline layout, since they use the same push constants. Taken from their
+        // handles once both are ready.
+        LVEPipelineManager::PipelineHandle depthPrepassHandle;
+        LVEPipelineManager::PipelineHandle afterDepthPrepassHandle;
+        std::shared_ptr<LVEPipeline> depthPrepassPipeline;
+        std::shared_ptr<LVEPipeline> afterDepthPrepassPipeline;
+        bool depthPrepassEnabled = true;
+        bool useDepthPrepass = false;
+        // What the pipelines leave to be set while recording, if the device supports that.
+        DrawState drawState{};
+        DrawState depthPrepassDrawState{};
+        DrawState afterDepthPrepassDrawState{};
         VkPipelineLayout pipelineLayout;
+
+        LVEDrawList drawList;
+        // Ranges may be recorded on several threads, which all add to the same counters.
+        mutable std::mutex bindStatsMutex;
+        BindStats bindStats{};
     };
 }  // namespace lve
@@ -0,0 +1,120 @@
+#include "transform_benchmark.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/constants.hpp>
+
+#include "lve_components.hpp"
+#include "lve_transform_batch.hpp"
+
+namespace lve {
+
+    namespace {
+        // Per iteration, small enough to keep the angles in the range the kernels are made for.
+        const glm::vec3 ROTATION_STEP{0.001f, 0.002f, 0.003f};
+
+        using Clock = std::chrono::high_resolution_clock;
+
+        double nanosecondsPerObject(Clock::duration duration,
+                                    uint32_t objectCount,
+                                    uint32_t iterations) {
+            return std::chrono::duration<double, std::nano>(duration).count() /
+                   (static_cast<double>(objectCount) * iterations);
+        }
+
+        // The largest difference between any two elements.
+        float maxDifference(const std::vector<TransformComponent> &transforms,
+                            const LVETransformBatch &batch) {
+            float difference = 0.0f;
+            for (size_t i = 0; i < transforms.size(); i++) {
+                const glm::mat4 &model = transforms[i].modelToWorldMatrix();
+                const glm::mat3 &normal = transforms[i].normalToWorldMatrix();
+                for (int column = 0; column < 4; column++) {
+                    for (int row = 0; row < 4; row++) {
+                        difference = std::max(
+                            difference,
+                            std::abs(model[column][row] - batch.modelMatrix(i)[column][row]));
+                        if (column < 3 && row < 3) {
+                            difference = std::max(
+                                difference,
+                                std::abs(normal[column][row] - batch.normalMatrix(i)[column][row]));
+                        }
+                    }
+                }
+            }
+            return difference;
+        }
+    }  // namespace
+
+    void runTransformBenchmark(uint32_t objectCount, uint32_t iterations) {
+        std::mt19937 random{42};
+        std::uniform_real_distribution<float> position{-10.0f, 10.0f};
+        std::uniform_real_distribution<float> angle{-glm::pi<float>(), glm::pi<float>()};
+        std::uniform_real_distribution<float> size{0.1f, 3.0f};
+        std::vector<TransformComponent> initial(objectCount);
+        for (auto &transform : initial) {
+            transform.setTranslation({position(random), position(random), position(random)});
+            transform.setRotation({angle(random), angle(random), angle(random)});
+            transform.setScale({size(random), size(random), size(random)});
+        }
+
+        std::cout << "Building the matrices of " << objectCount << " transforms, " << iterations
+                  << " times:\n"
+                  << std::fixed << std::setprecision(2);
+
+        // Summed up and printed, so that the compiler cannot drop the work.
+        float checksum = 0.0f;
+        std::vector<TransformComponent> transforms = initial;
+        auto start = Clock::now();
+        for (uint32_t iteration = 0; iteration < iterations; iteration++) {
+            for (auto &transform : transforms) {
+                transform.rotate(ROTATION_STEP);
+                checksum += transform.modelToWorldMatrix()[0][0];
+                checksum += transform.normalToWorldMatrix()[0][0];
+            }
+        }
+        const double perObjectNs =
+            nanosecondsPerObject(Clock::now() - start, objectCount, iterations);
+        std::cout << "  TransformComponent: " << perObjectNs << " ns per object\n";
+
+        for (auto kernel : {LVETransformBatch::Kernel::Scalar,
+                            LVETransformBatch::Kernel::Avx2,
+                            LVETransformBatch::Kernel::Avx512}) {
+            const char *name = LVETransformBatch::kernelName(kernel);
+            if (!LVETransformBatch::isSupported(kernel)) {
+                std::cout << "  " << name << " batch: not supported\n";
+                continue;
+            }
+            LVETransformBatch batch{kernel};
+            batch.reserve(objectCount);
+            for (const auto &transform : initial) {
+                batch.add(transform);
+            }
+
+            start = Clock::now();
+            for (uint32_t iteration = 0; iteration < iterations; iteration++) {
+                for (size_t i = 0; i < batch.size(); i++) {
+                    batch.setRotation(i, batch.getRotation(i) + ROTATION_STEP);
+                }
+                batch.computeMatrices();
+                for (size_t i = 0; i < batch.size(); i++) {
+                    checksum += batch.modelMatrix(i)[0][0];
+                    checksum += batch.normalMatrix(i)[0][0];
+                }
+            }
+            const double batchNs =
+                nanosecondsPerObject(Clock::now() - start, objectCount, iterations);
+            std::cout << "  " << name << " batch: " << batchNs << " ns per object ("
+                      << perObjectNs / batchNs << "x), max difference "
+                      << std::setprecision(7) << maxDifference(transforms, batch)
+                      << std::setprecision(2) << "\n";
+        }
+        std::cout << "  Checksum: " << checksum << "\n";
+    }
+}  // namespace lve
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+namespace lve {
+    /**
+     * @brief Measures how long building the model and normal matrices takes per object: One
+     * TransformComponent at a time, as the render systems do, against LVETransformBatch with every
+     * kernel the CPU supports. Every object rotates in every iteration, so nothing is cached.
+     * Prints the results and how far the batch matrices are from the per object ones.
+     */
+    void runTransformBenchmark(uint32_t objectCount, uint32_t iterations);
+}  // namespace lve